@@ -0,0 +1,221 @@
+/* Module defining an allocator that carves blocks and strings out of
+   large pages. */
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include "arena.h"
+
+/* The number of bytes in each page of blocks or strings. Strings
+   longer than a page get a page of their own. */
+enum {PAGE_SIZE = 65536};
+
+/* A type whose alignment suits every block handed out. */
+union Align
+{
+   void *pv;
+   size_t u;
+   double d;
+};
+
+/* Each Page starts with a header that links it to the other pages of
+   its kind. The usable memory follows the header. */
+union Page
+{
+   /* The address of the next Page. */
+   union Page *psNextPage;
+
+   /* Pads the header to the alignment of the blocks that follow. */
+   union Align aAlign;
+};
+
+/* A released block holds the address of the next released block. */
+struct FreeBlock
+{
+   struct FreeBlock *psNextBlock;
+};
+
+/* An Arena tracks its pages of blocks and pages of strings, along
+   with where the next block or string will go. */
+struct Arena
+{
+   /* The size of each block, rounded up to the alignment. */
+   size_t uBlockSize;
+
+   /* The pages that blocks are carved from. */
+   union Page *psBlockPages;
+
+   /* The next never-used block in the first block page, and the end of
+      that page. */
+   char *pcNextBlock;
+   char *pcBlockEnd;
+
+   /* Blocks returned with Arena_release. */
+   struct FreeBlock *psFreeBlocks;
+
+   /* The pages that strings are copied into. */
+   union Page *psStringPages;
+
+   /* Where the next string goes in the first string page, and the end
+      of that page. */
+   char *pcNextString;
+   char *pcStringEnd;
+
+   /* The number of bytes of every page allocated so far. */
+   size_t uPageBytes;
+};
+
+/* Allocates a page of oArena with uSize usable bytes and links it to
+   the front of *ppsPages. Returns the address of its usable memory,
+   or NULL if insufficient memory is available. */
+static char *Arena_newPage(Arena_T oArena, union Page **ppsPages,
+                           size_t uSize)
+{
+   union Page *psPage;
+
+   psPage = (union Page*)malloc(sizeof(union Page) + uSize);
+   if (psPage == NULL) return NULL;
+   oArena->uPageBytes += sizeof(union Page) + uSize;
+
+   psPage->psNextPage = *ppsPages;
+   *ppsPages = psPage;
+   return (char*)(psPage + 1);
+}
+
+/* Frees every page in the list that starts at psPage. */
+static void Arena_freePages(union Page *psPage)
+{
+   union Page *psNextPage;
+
+   for (; psPage != NULL; psPage = psNextPage) {
+      psNextPage = psPage->psNextPage;
+      free(psPage);
+   }
+}
+
+Arena_T Arena_new(size_t uBlockSize) {
+   Arena_T oArena;
+
+   oArena = (Arena_T)malloc(sizeof(struct Arena));
+   if (oArena == NULL) return NULL;
+
+   if (uBlockSize < sizeof(struct FreeBlock))
+      uBlockSize = sizeof(struct FreeBlock);
+   oArena->uBlockSize = (uBlockSize + sizeof(union Align) - 1)
+      / sizeof(union Align) * sizeof(union Align);
+   assert(oArena->uBlockSize <= PAGE_SIZE);
+
+   oArena->psBlockPages = NULL;
+   oArena->pcNextBlock = NULL;
+   oArena->pcBlockEnd = NULL;
+   oArena->psFreeBlocks = NULL;
+   oArena->psStringPages = NULL;
+   oArena->pcNextString = NULL;
+   oArena->pcStringEnd = NULL;
+   oArena->uPageBytes = 0;
+   return oArena;
+}
+
+void Arena_free(Arena_T oArena) {
+   assert(oArena != NULL);
+
+   Arena_freePages(oArena->psBlockPages);
+   Arena_freePages(oArena->psStringPages);
+   free(oArena);
+}
+
+void *Arena_alloc(Arena_T oArena) {
+   struct FreeBlock *psBlock;
+   char *pcPage;
+
+   assert(oArena != NULL);
+
+   if (oArena->psFreeBlocks != NULL) {
+      psBlock = oArena->psFreeBlocks;
+      oArena->psFreeBlocks = psBlock->psNextBlock;
+      return psBlock;
+   }
+
+   if ((size_t)(oArena->pcBlockEnd - oArena->pcNextBlock)
+       < oArena->uBlockSize) {
+      pcPage = Arena_newPage(oArena, &oArena->psBlockPages, PAGE_SIZE);
+      if (pcPage == NULL) return NULL;
+      oArena->pcNextBlock = pcPage;
+      oArena->pcBlockEnd = pcPage + PAGE_SIZE;
+   }
+
+   psBlock = (struct FreeBlock*)oArena->pcNextBlock;
+   oArena->pcNextBlock += oArena->uBlockSize;
+   return psBlock;
+}
+
+int Arena_reserve(Arena_T oArena, size_t uBlocks) {
+   char *pcPage;
+   size_t uSize;
+
+   assert(oArena != NULL);
+
+   if ((size_t)(oArena->pcBlockEnd - oArena->pcNextBlock)
+       / oArena->uBlockSize >= uBlocks)
+      return 1;
+
+   if (uBlocks > ((size_t)-1 - sizeof(union Page)) / oArena->uBlockSize)
+      return 0;
+   uSize = uBlocks * oArena->uBlockSize;
+
+   /* The rest of the current page is abandoned until Arena_free */
+   pcPage = Arena_newPage(oArena, &oArena->psBlockPages, uSize);
+   if (pcPage == NULL) return 0;
+   oArena->pcNextBlock = pcPage;
+   oArena->pcBlockEnd = pcPage + uSize;
+   return 1;
+}
+
+void Arena_release(Arena_T oArena, void *pvBlock) {
+   struct FreeBlock *psBlock;
+
+   assert(oArena != NULL);
+   assert(pvBlock != NULL);
+
+   psBlock = (struct FreeBlock*)pvBlock;
+   psBlock->psNextBlock = oArena->psFreeBlocks;
+   oArena->psFreeBlocks = psBlock;
+}
+
+char *Arena_copyString(Arena_T oArena, const char *pcString,
+                       size_t uLength) {
+   char *pcCopy;
+
+   assert(oArena != NULL);
+   assert(pcString != NULL);
+
+   if ((size_t)(oArena->pcStringEnd - oArena->pcNextString)
+       < uLength + 1) {
+      /* A string too long for a shared page gets its own page, and
+         the current page stays open for the strings that follow */
+      if (uLength + 1 > PAGE_SIZE / 4) {
+         pcCopy = Arena_newPage(oArena, &oArena->psStringPages, uLength + 1);
+         if (pcCopy == NULL) return NULL;
+         memcpy(pcCopy, pcString, uLength);
+         pcCopy[uLength] = '\0';
+         return pcCopy;
+      }
+
+      pcCopy = Arena_newPage(oArena, &oArena->psStringPages, PAGE_SIZE);
+      if (pcCopy == NULL) return NULL;
+      oArena->pcNextString = pcCopy;
+      oArena->pcStringEnd = pcCopy + PAGE_SIZE;
+   }
+
+   pcCopy = oArena->pcNextString;
+   memcpy(pcCopy, pcString, uLength);
+   pcCopy[uLength] = '\0';
+   oArena->pcNextString += uLength + 1;
+   return pcCopy;
+}
+
+size_t Arena_bytes(Arena_T oArena) {
+   assert(oArena != NULL);
+   return sizeof(struct Arena) + oArena->uPageBytes;
+}
@@ -0,0 +1,41 @@
+/* Interface for Arena functions */
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+#include <stddef.h>
+
+/* An Arena_T hands out equal-sized blocks from large pages, recycling
+   released blocks through a free list, and copies strings into large
+   pages with a bump pointer. Freeing the Arena_T releases every page
+   at once. */
+typedef struct Arena *Arena_T;
+
+/* Return a new Arena_T whose blocks are uBlockSize bytes, or NULL if
+   insufficient memory is available. */
+Arena_T Arena_new(size_t uBlockSize);
+
+/* Free oArena, and with it every block and string it handed out. */
+void Arena_free(Arena_T oArena);
+
+/* Return the address of an unused block of oArena, or NULL if
+   insufficient memory is available. */
+void *Arena_alloc(Arena_T oArena);
+
+/* Make sure oArena can hand out uBlocks more never-used blocks
+   without allocating another page. Returns 1 (TRUE) if successful, or
+   0 (FALSE) if insufficient memory is available. */
+int Arena_reserve(Arena_T oArena, size_t uBlocks);
+
+/* Return block pvBlock, which came from Arena_alloc, to oArena so a
+   later Arena_alloc can reuse it. */
+void Arena_release(Arena_T oArena, void *pvBlock);
+
+/* Return a NUL-terminated copy of the first uLength characters of
+   pcString stored in oArena, or NULL if insufficient memory is
+   available. The copy lives until oArena is freed. */
+char *Arena_copyString(Arena_T oArena, const char *pcString,
+                       size_t uLength);
+
+/* Return the number of bytes of memory oArena holds, for itself and
+   for every page it has allocated. */
+size_t Arena_bytes(Arena_T oArena);
+#endif
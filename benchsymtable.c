@@ -0,0 +1,691 @@
+/*--------------------------------------------------------------------*/
+/* benchsymtable.c                                                    */
+/*--------------------------------------------------------------------*/
+
+/* Times each SymTable operation on its own, over several kinds of
+   keys, and reports the mean time per operation along with
+   percentiles of the times of single operations. It is built once
+   with each implementation of symtable.h, so that the same workload
+   runs against each of them and they can be compared with each other
+   and with earlier builds of themselves. The hash tables are also
+   built with the legacy hash policy, and "make benchhash" runs both
+   builds, to compare the policies.
+
+   The mean comes from a loop of operations with no clock reads
+   between them, in which the processor overlaps the cache misses of
+   one operation with the work of the next. A single timed operation
+   cannot overlap them, so its percentiles can exceed the mean; they
+   are for comparing spreads and tails, between builds or
+   implementations, rather than with the mean.
+
+   It also times reading a full table back from a stream written by
+   SymTable_write, against rebuilding it by putting every binding of
+   the table into a new one, as a copy without SymTable_read would. */
+
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include "symtable.h"
+#include "symtableio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*--------------------------------------------------------------------*/
+
+/* The kinds of keys and orders of use measured:
+   sequential keys "0", "1", ... are put and used in order;
+   random keys are random numbers in hex, used in a random order;
+   path keys are long file names that share most of their characters,
+   used in a random order;
+   zipf keys are random keys of which a few are looked up far more
+   often than the rest, rank r in proportion to 1 / (r + 1);
+   colliding keys are strings of the pairs "az" and "b;", whose hashes
+   under the 65599 hash of the assignment specification differ by
+   multiples of 2^16, used in a random order. */
+enum Distribution {SEQUENTIAL, RANDOM, PATHS, ZIPF, COLLIDING,
+                   DISTRIBUTION_COUNT};
+static const char *apcDistributionNames[] = {
+   "sequential", "random", "paths", "zipf", "colliding"
+};
+
+/* The operations measured. READ is SymTable_read of a stream holding
+   the whole table, and REBUILD is putting every binding of the table
+   into a new one; both are reported per binding. */
+enum Operation {PUT, GET_HIT, GET_MISS, REPLACE, REMOVE, MAP, READ,
+                REBUILD};
+static const char *apcOperationNames[] = {
+   "put", "get-hit", "get-miss", "replace", "remove", "map", "read",
+   "rebuild"
+};
+
+/* The number of times the whole table is mapped. */
+enum {MAP_RUNS = 20};
+
+/* The number of times the whole table is read back and rebuilt. At
+   most MAP_RUNS. */
+enum {STREAM_RUNS = 5};
+
+/* The number of empty timings whose median is taken as the cost of
+   reading the clock, and subtracted from the time of each
+   operation. */
+enum {CALIBRATION_RUNS = 1001};
+
+enum {MAX_KEY_LENGTH = 64};
+
+/* The number of pairs in a colliding key. The first pair tells a key
+   from its missing counterpart, and the rest hold the key's number. */
+enum {COLLIDING_PAIRS = 30};
+
+/*--------------------------------------------------------------------*/
+
+/* The keys of the current distribution, in the order they are put,
+   and as many keys that are never put. */
+static char (*aacKeys)[MAX_KEY_LENGTH];
+static char (*aacMissingKeys)[MAX_KEY_LENGTH];
+
+/* The indices of the keys in the order they are looked up, and in
+   the order they are removed. */
+static size_t *auLookups;
+static size_t *auRemovals;
+
+/* The time of each single operation of a run, in nanoseconds. */
+static double *adSamples;
+
+/* The cost of reading the clock, in nanoseconds. */
+static double dClockCost;
+
+/* The number of operations whose results were wrong. */
+static long lFailures;
+
+/*--------------------------------------------------------------------*/
+
+/* Return the next number from the xorshift generator whose state is
+   *pulSeed, a number in [0, 2^32). */
+
+static unsigned long nextRandom(unsigned long *pulSeed)
+{
+   unsigned long ul = *pulSeed;
+   ul ^= (ul << 13) & 0xffffffffUL;
+   ul ^= ul >> 17;
+   ul ^= (ul << 5) & 0xffffffffUL;
+   *pulSeed = ul;
+   return ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the number of nanoseconds on a monotonic clock. */
+
+static double getNanoseconds(void)
+{
+   struct timespec sTime;
+   clock_gettime(CLOCK_MONOTONIC, &sTime);
+   return (double)sTime.tv_sec * 1e9 + (double)sTime.tv_nsec;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Compare the doubles that pvFirst and pvSecond point to, for
+   qsort. */
+
+static int compareDoubles(const void *pvFirst, const void *pvSecond)
+{
+   double dFirst = *(const double*)pvFirst;
+   double dSecond = *(const double*)pvSecond;
+   if (dFirst < dSecond) return -1;
+   if (dFirst > dSecond) return 1;
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the dPercent percentile of adSorted[0] to
+   adSorted[uCount - 1], which are in increasing order. */
+
+static double percentile(const double adSorted[], size_t uCount,
+   double dPercent)
+{
+   size_t uIndex = (size_t)(dPercent / 100.0 * (double)(uCount - 1)
+                            + 0.5);
+   return adSorted[uIndex];
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Set dClockCost to the median time of an empty timing. */
+
+static void calibrateClock(void)
+{
+   double adEmpty[CALIBRATION_RUNS];
+   double dStart;
+   size_t u;
+
+   for (u = 0; u < CALIBRATION_RUNS; u++)
+   {
+      dStart = getNanoseconds();
+      adEmpty[u] = getNanoseconds() - dStart;
+   }
+   qsort(adEmpty, CALIBRATION_RUNS, sizeof(double), compareDoubles);
+   dClockCost = adEmpty[CALIBRATION_RUNS / 2];
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Fill the order auOrder[0] to auOrder[uCount - 1] with a random
+   permutation of 0 to uCount - 1. */
+
+static void shuffle(size_t auOrder[], size_t uCount,
+   unsigned long *pulSeed)
+{
+   size_t uOther;
+   size_t uSwap;
+   size_t u;
+
+   for (u = 0; u < uCount; u++)
+      auOrder[u] = u;
+   for (u = uCount; u > 1; u--)
+   {
+      uOther = (size_t)(nextRandom(pulSeed) % u);
+      uSwap = auOrder[u - 1];
+      auOrder[u - 1] = auOrder[uOther];
+      auOrder[uOther] = uSwap;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Fill auLookups[0] to auLookups[uCount - 1] with key indices from 0
+   to uCount - 1 drawn so that the index of rank r, in the order
+   auRemovals gives, is drawn in proportion to 1 / (r + 1). */
+
+static void drawZipf(size_t uCount, unsigned long *pulSeed)
+{
+   double *adCumulative;
+   double dTotal = 0.0;
+   double dTarget;
+   size_t uLow;
+   size_t uHigh;
+   size_t uMid;
+   size_t u;
+
+   adCumulative = (double*)malloc(uCount * sizeof(double));
+   if (adCumulative == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+   for (u = 0; u < uCount; u++)
+   {
+      dTotal += 1.0 / (double)(u + 1);
+      adCumulative[u] = dTotal;
+   }
+
+   for (u = 0; u < uCount; u++)
+   {
+      dTarget = (double)nextRandom(pulSeed) / 4294967296.0 * dTotal;
+      uLow = 0;
+      uHigh = uCount - 1;
+      while (uLow < uHigh)
+      {
+         uMid = uLow + (uHigh - uLow) / 2;
+         if (adCumulative[uMid] <= dTarget)
+            uLow = uMid + 1;
+         else
+            uHigh = uMid;
+      }
+      auLookups[u] = auRemovals[uLow];
+   }
+   free(adCumulative);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Write the key with number ulNumber of distribution eDistribution to
+   pcKey, and its missing counterpart to pcMissingKey. Random keys
+   are made distinct by their low bits, which hold ulNumber. */
+
+static void makeKey(enum Distribution eDistribution,
+   unsigned long ulNumber, char *pcKey, char *pcMissingKey,
+   unsigned long *pulSeed)
+{
+   unsigned long ulHigh;
+   const char *pcPair;
+   int i;
+
+   switch (eDistribution)
+   {
+      case SEQUENTIAL:
+         sprintf(pcKey, "%lu", ulNumber);
+         sprintf(pcMissingKey, "-%lu", ulNumber);
+         break;
+      case PATHS:
+         sprintf(pcKey, "/usr/src/project/module%02lu/include/sub%03lu/"
+                 "file%06lu.h", ulNumber % 17, ulNumber % 331, ulNumber);
+         sprintf(pcMissingKey, "/usr/src/project/module%02lu/include/"
+                 "sub%03lu/file%06lu.c", ulNumber % 17, ulNumber % 331,
+                 ulNumber);
+         break;
+      case COLLIDING:
+         strcpy(pcKey, "az");
+         strcpy(pcMissingKey, "b;");
+         for (i = 1; i < COLLIDING_PAIRS; i++)
+         {
+            pcPair = ((ulNumber >> (i - 1)) & 1) ? "az" : "b;";
+            strcpy(pcKey + 2 * i, pcPair);
+            strcpy(pcMissingKey + 2 * i, pcPair);
+         }
+         break;
+      default:
+         ulHigh = nextRandom(pulSeed);
+         sprintf(pcKey, "%08lx%06lx", ulHigh, ulNumber);
+         sprintf(pcMissingKey, "%08lx%06lx", ulHigh ^ 0x80000000UL,
+                 ulNumber);
+         break;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Make the uCount keys, missing keys, lookup order and removal order
+   of distribution eDistribution. */
+
+static void makeKeys(enum Distribution eDistribution, size_t uCount)
+{
+   unsigned long ulSeed = 2463534242UL;
+   size_t u;
+
+   for (u = 0; u < uCount; u++)
+      makeKey(eDistribution, (unsigned long)u, aacKeys[u],
+              aacMissingKeys[u], &ulSeed);
+
+   if (eDistribution == SEQUENTIAL)
+   {
+      for (u = 0; u < uCount; u++)
+      {
+         auLookups[u] = u;
+         auRemovals[u] = u;
+      }
+      return;
+   }
+   shuffle(auLookups, uCount, &ulSeed);
+   shuffle(auRemovals, uCount, &ulSeed);
+   if (eDistribution == ZIPF)
+      drawZipf(uCount, &ulSeed);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Perform operation eOperation, other than MAP, on oSymTable for the
+   key numbered uIndex, counting a wrong result in lFailures. */
+
+static void perform(enum Operation eOperation, SymTable_T oSymTable,
+   size_t uIndex)
+{
+   const char *pcKey = aacKeys[uIndex];
+   int iRight = 1;
+
+   switch (eOperation)
+   {
+      case PUT:
+         iRight = SymTable_put(oSymTable, pcKey, pcKey);
+         break;
+      case GET_HIT:
+         iRight = SymTable_get(oSymTable, pcKey) == pcKey;
+         break;
+      case GET_MISS:
+         iRight = SymTable_get(oSymTable, aacMissingKeys[uIndex]) == NULL;
+         break;
+      case REPLACE:
+         iRight = SymTable_replace(oSymTable, pcKey, pcKey) == pcKey;
+         break;
+      case REMOVE:
+         iRight = SymTable_remove(oSymTable, pcKey) == pcKey;
+         break;
+      default:
+         break;
+   }
+   if (! iRight)
+      lFailures++;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the index of the key that the uStep'th eOperation uses. */
+
+static size_t keyOf(enum Operation eOperation, size_t uStep)
+{
+   switch (eOperation)
+   {
+      case PUT:
+         return uStep;
+      case REMOVE:
+         return auRemovals[uStep];
+      default:
+         return auLookups[uStep];
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Count the binding at pvExtra. pcKey and pvValue are unused. */
+
+static void countBinding(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvValue;
+   (*(size_t*)pvExtra)++;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Write the value pvValue, a pointer, to psFile. pcKey and pvExtra are
+   unused. Return 1 (TRUE) if successful, or 0 (FALSE) otherwise. */
+
+static int writeValue(const char *pcKey, void *pvValue, FILE *psFile,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvExtra;
+   return fwrite(&pvValue, sizeof(void*), 1, psFile) == 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Read a value written by writeValue from psFile into *ppvValue.
+   pcKey and pvExtra are unused. Return 1 (TRUE) if successful, or 0
+   (FALSE) otherwise. */
+
+static int readValue(const char *pcKey, void **ppvValue, FILE *psFile,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvExtra;
+   return fread(ppvValue, sizeof(void*), 1, psFile) == 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Put the binding pcKey-pvValue into the SymTable_T at pvExtra,
+   counting a failure in lFailures. */
+
+static void putBinding(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   if (! SymTable_put((SymTable_T)pvExtra, pcKey, pvValue))
+      lFailures++;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Print the mean dMean and the percentiles of adSamples[0] to
+   adSamples[uCount - 1], in nanoseconds, for operation eOperation of
+   distribution eDistribution. */
+
+static void report(enum Distribution eDistribution,
+   enum Operation eOperation, double dMean, size_t uCount)
+{
+   qsort(adSamples, uCount, sizeof(double), compareDoubles);
+   printf("%-10s  %-8s %8.1f %8.1f %8.1f %8.1f %8.1f %10.1f\n",
+          apcDistributionNames[eDistribution],
+          apcOperationNames[eOperation], dMean,
+          percentile(adSamples, uCount, 50.0),
+          percentile(adSamples, uCount, 90.0),
+          percentile(adSamples, uCount, 99.0),
+          percentile(adSamples, uCount, 99.9),
+          adSamples[uCount - 1]);
+   fflush(stdout);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Print the mean and percentiles of a map of oFast and of oTimed,
+   which hold the same uCount bindings of distribution eDistribution,
+   per binding visited. */
+
+static void runMap(enum Distribution eDistribution, SymTable_T oFast,
+   SymTable_T oTimed, size_t uCount)
+{
+   double dStart;
+   double dMean;
+   size_t uBindings;
+   int iRun;
+
+   dStart = getNanoseconds();
+   for (iRun = 0; iRun < MAP_RUNS; iRun++)
+   {
+      uBindings = 0;
+      SymTable_map(oFast, countBinding, &uBindings);
+      if (uBindings != uCount) lFailures++;
+   }
+   dMean = (getNanoseconds() - dStart) / MAP_RUNS / (double)uCount;
+
+   /* Each sample is one binding's share of a whole map */
+   for (iRun = 0; iRun < MAP_RUNS; iRun++)
+   {
+      uBindings = 0;
+      dStart = getNanoseconds();
+      SymTable_map(oTimed, countBinding, &uBindings);
+      adSamples[iRun] = (getNanoseconds() - dStart - dClockCost)
+         / (double)uCount;
+   }
+   report(eDistribution, MAP, dMean, MAP_RUNS);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Print the mean and percentiles, per binding, of reading oSymTable,
+   which holds uCount bindings of distribution eDistribution, back
+   from a stream, and then of rebuilding it with SymTable_put. The
+   stream is a temporary file, which is likely to stay in the page
+   cache, so reading times decoding rather than the disk. */
+
+static void runStream(enum Distribution eDistribution,
+   SymTable_T oSymTable, size_t uCount)
+{
+   SymTable_T oCopy;
+   FILE *psFile;
+   double dStart;
+   double dTotal;
+   int iRun;
+
+   psFile = tmpfile();
+   if (psFile == NULL
+       || ! SymTable_write(oSymTable, psFile, writeValue, NULL))
+   {
+      fprintf(stderr, "Cannot write a temporary file\n");
+      exit(EXIT_FAILURE);
+   }
+
+   dTotal = 0.0;
+   for (iRun = 0; iRun < STREAM_RUNS; iRun++)
+   {
+      rewind(psFile);
+      dStart = getNanoseconds();
+      oCopy = SymTable_read(psFile, readValue, NULL, NULL);
+      adSamples[iRun] = (getNanoseconds() - dStart - dClockCost)
+         / (double)uCount;
+      dTotal += adSamples[iRun];
+      if (oCopy == NULL || SymTable_getLength(oCopy) != uCount)
+         lFailures++;
+      if (oCopy != NULL)
+         SymTable_free(oCopy);
+   }
+   report(eDistribution, READ, dTotal / STREAM_RUNS, STREAM_RUNS);
+   fclose(psFile);
+
+   dTotal = 0.0;
+   for (iRun = 0; iRun < STREAM_RUNS; iRun++)
+   {
+      oCopy = SymTable_new();
+      if (oCopy == NULL)
+      {
+         fprintf(stderr, "Insufficient memory\n");
+         exit(EXIT_FAILURE);
+      }
+      dStart = getNanoseconds();
+      SymTable_map(oSymTable, putBinding, oCopy);
+      adSamples[iRun] = (getNanoseconds() - dStart - dClockCost)
+         / (double)uCount;
+      dTotal += adSamples[iRun];
+      if (SymTable_getLength(oCopy) != uCount)
+         lFailures++;
+      SymTable_free(oCopy);
+   }
+   report(eDistribution, REBUILD, dTotal / STREAM_RUNS, STREAM_RUNS);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Print the mean and percentiles of uCount operations eOperation of
+   distribution eDistribution. The mean comes from running them all
+   in one timing on oFast; the percentiles come from timing each on
+   its own on oTimed, which holds the same bindings. */
+
+static void runOperation(enum Distribution eDistribution,
+   enum Operation eOperation, SymTable_T oFast, SymTable_T oTimed,
+   size_t uCount)
+{
+   double dStart;
+   double dMean;
+   double dSample;
+   size_t u;
+
+   dStart = getNanoseconds();
+   for (u = 0; u < uCount; u++)
+      perform(eOperation, oFast, keyOf(eOperation, u));
+   dMean = (getNanoseconds() - dStart) / (double)uCount;
+
+   for (u = 0; u < uCount; u++)
+   {
+      dStart = getNanoseconds();
+      perform(eOperation, oTimed, keyOf(eOperation, u));
+      dSample = getNanoseconds() - dStart - dClockCost;
+      adSamples[u] = dSample > 0.0 ? dSample : 0.0;
+   }
+   report(eDistribution, eOperation, dMean, uCount);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Measure each operation on uCount keys of distribution
+   eDistribution, in an order that leaves the table full until the
+   removals empty it. */
+
+static void runDistribution(enum Distribution eDistribution,
+   size_t uCount)
+{
+   static const enum Operation aeOrder[] = {
+      PUT, GET_HIT, GET_MISS, REPLACE, MAP, READ, REMOVE
+   };
+   SymTable_T oFast;
+   SymTable_T oTimed;
+   size_t u;
+
+   makeKeys(eDistribution, uCount);
+   oFast = SymTable_new();
+   oTimed = SymTable_new();
+   if (oFast == NULL || oTimed == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+
+   for (u = 0; u < sizeof(aeOrder) / sizeof(aeOrder[0]); u++)
+   {
+      if (aeOrder[u] == MAP)
+         runMap(eDistribution, oFast, oTimed, uCount);
+      else if (aeOrder[u] == READ)
+         runStream(eDistribution, oFast, uCount);
+      else
+         runOperation(eDistribution, aeOrder[u], oFast, oTimed, uCount);
+   }
+
+   if (SymTable_getLength(oFast) != 0 || SymTable_getLength(oTimed) != 0)
+      lFailures++;
+   SymTable_free(oFast);
+   SymTable_free(oTimed);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Run the benchmark with argv[1] bindings, which defaults to 100000,
+   over every distribution or over those named by argv[2] and later
+   arguments. Return 0 if every operation gave the right result, or
+   EXIT_FAILURE otherwise. */
+
+int main(int argc, char *argv[])
+{
+   long lCount = 100000;
+   size_t uCount;
+   int aiSelected[DISTRIBUTION_COUNT];
+   int iDistribution;
+   int i;
+
+   if (argc > 1 && sscanf(argv[1], "%ld", &lCount) != 1)
+      lCount = 0;
+   if (lCount < 1)
+   {
+      fprintf(stderr, "Usage: %s [bindingcount [distribution...]]\n",
+              argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   uCount = (size_t)lCount;
+
+   for (iDistribution = 0; iDistribution < DISTRIBUTION_COUNT;
+        iDistribution++)
+      aiSelected[iDistribution] = argc <= 2;
+   for (i = 2; i < argc; i++)
+   {
+      for (iDistribution = 0; iDistribution < DISTRIBUTION_COUNT;
+           iDistribution++)
+         if (strcmp(argv[i], apcDistributionNames[iDistribution]) == 0)
+            break;
+      if (iDistribution == DISTRIBUTION_COUNT)
+      {
+         fprintf(stderr, "Unknown distribution %s\n", argv[i]);
+         exit(EXIT_FAILURE);
+      }
+      aiSelected[iDistribution] = 1;
+   }
+
+   aacKeys = (char(*)[MAX_KEY_LENGTH])malloc(uCount * MAX_KEY_LENGTH);
+   aacMissingKeys =
+      (char(*)[MAX_KEY_LENGTH])malloc(uCount * MAX_KEY_LENGTH);
+   auLookups = (size_t*)malloc(uCount * sizeof(size_t));
+   auRemovals = (size_t*)malloc(uCount * sizeof(size_t));
+   adSamples = (double*)malloc((uCount > MAP_RUNS ? uCount : MAP_RUNS)
+                               * sizeof(double));
+   if (aacKeys == NULL || aacMissingKeys == NULL || auLookups == NULL
+       || auRemovals == NULL || adSamples == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+
+   calibrateClock();
+   printf("%s: %lu bindings; nanoseconds per operation, less %.1f for "
+          "reading the clock\n", argv[0], (unsigned long)uCount,
+          dClockCost);
+   printf("%-10s  %-8s %8s %8s %8s %8s %8s %10s\n", "keys",
+          "op", "mean", "p50", "p90", "p99", "p99.9", "max");
+   for (iDistribution = 0; iDistribution < DISTRIBUTION_COUNT;
+        iDistribution++)
+      if (aiSelected[iDistribution])
+         runDistribution((enum Distribution)iDistribution, uCount);
+
+   free(aacKeys);
+   free(aacMissingKeys);
+   free(auLookups);
+   free(auRemovals);
+   free(adSamples);
+
+   if (lFailures != 0)
+   {
+      printf("%ld operations gave the wrong result.\n", lFailures);
+      return EXIT_FAILURE;
+   }
+   return 0;
+}
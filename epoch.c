@@ -0,0 +1,155 @@
+/* Module defining epoch-based reclamation of memory that lock-free
+   readers may still be looking at. */
+
+/* For pthread_once and pthread_key_create */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "epoch.h"
+
+#ifndef __GNUC__
+#error "epoch.c needs the GCC __atomic builtins"
+#endif
+
+/* The size of a cache line, which each Slot is padded to so that
+   readers on different threads never write to the same line. */
+enum {CACHE_LINE_SIZE = 64};
+
+/* A Slot records where one thread is in its read sections. Slots are
+   never freed; a thread that exits gives its Slot up for the next new
+   thread to take. */
+struct Slot
+{
+   /* The global epoch when the owning thread's outermost read section
+      began, or 0 if the thread is outside every read section. Written
+      only by the owning thread. */
+   size_t uEpoch;
+
+   /* The number of read sections the owning thread is inside. */
+   int iDepth;
+
+   /* 1 (TRUE) if a thread owns the Slot. Guarded by slotLock. */
+   int iOwned;
+
+   /* The address of the next Slot. Fixed once the Slot is in the
+      list. */
+   struct Slot *psNextSlot;
+
+   /* Keeps neighbouring Slots off each other's cache lines. */
+   char acPadding[CACHE_LINE_SIZE];
+};
+
+/* The global epoch. It starts at 1, since 0 in a Slot means that the
+   Slot's thread is outside every read section. */
+static size_t uGlobalEpoch = 1;
+
+/* The address of the first Slot. New Slots are published at the
+   front, so writers may walk the list without taking slotLock. */
+static struct Slot *psFirstSlot = NULL;
+
+/* Held to add a Slot to the list or to change a Slot's owner. */
+static pthread_mutex_t slotLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* The key under which each thread keeps the address of its Slot. */
+static pthread_key_t slotKey;
+static pthread_once_t slotKeyOnce = PTHREAD_ONCE_INIT;
+static int iSlotKeyCreated = 0;
+
+/* Gives up pvSlot, the Slot of a thread that is exiting. */
+static void Epoch_releaseSlot(void *pvSlot) {
+   pthread_mutex_lock(&slotLock);
+   ((struct Slot*)pvSlot)->iOwned = 0;
+   pthread_mutex_unlock(&slotLock);
+}
+
+/* Creates slotKey. Run once, by whichever thread enters a read
+   section first. */
+static void Epoch_createSlotKey(void) {
+   iSlotKeyCreated =
+      pthread_key_create(&slotKey, Epoch_releaseSlot) == 0;
+}
+
+/* Returns the calling thread's Slot, taking an unowned one or adding
+   a new one on the thread's first call. Returns NULL if insufficient
+   memory is available. */
+static struct Slot *Epoch_slot(void) {
+   struct Slot *psSlot;
+
+   pthread_once(&slotKeyOnce, Epoch_createSlotKey);
+   if (! iSlotKeyCreated) return NULL;
+
+   psSlot = (struct Slot*)pthread_getspecific(slotKey);
+   if (psSlot != NULL) return psSlot;
+
+   pthread_mutex_lock(&slotLock);
+   for (psSlot = psFirstSlot; psSlot != NULL;
+        psSlot = psSlot->psNextSlot) {
+      if (! psSlot->iOwned) break;
+   }
+   if (psSlot == NULL) {
+      psSlot = (struct Slot*)calloc(1, sizeof(struct Slot));
+      if (psSlot != NULL) {
+         psSlot->psNextSlot = psFirstSlot;
+         __atomic_store_n(&psFirstSlot, psSlot, __ATOMIC_RELEASE);
+      }
+   }
+   if (psSlot != NULL) psSlot->iOwned = 1;
+   pthread_mutex_unlock(&slotLock);
+
+   if (psSlot != NULL && pthread_setspecific(slotKey, psSlot) != 0) {
+      Epoch_releaseSlot(psSlot);
+      return NULL;
+   }
+   return psSlot;
+}
+
+int Epoch_enter(void) {
+   struct Slot *psSlot;
+
+   psSlot = Epoch_slot();
+   if (psSlot == NULL) return 0;
+
+   if (psSlot->iDepth++ == 0) {
+      __atomic_store_n(&psSlot->uEpoch,
+                       __atomic_load_n(&uGlobalEpoch, __ATOMIC_ACQUIRE),
+                       __ATOMIC_RELAXED);
+      /* Pairs with the fence in Epoch_oldest: either that writer sees
+         this epoch, or the reads that follow see what it unlinked */
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   }
+   return 1;
+}
+
+void Epoch_exit(void) {
+   struct Slot *psSlot;
+
+   psSlot = (struct Slot*)pthread_getspecific(slotKey);
+   assert(psSlot != NULL);
+   assert(psSlot->iDepth > 0);
+
+   /* The reads of the section come before a writer can see it end */
+   if (--psSlot->iDepth == 0)
+      __atomic_store_n(&psSlot->uEpoch, (size_t)0, __ATOMIC_RELEASE);
+}
+
+size_t Epoch_retire(void) {
+   return __atomic_add_fetch(&uGlobalEpoch, (size_t)1, __ATOMIC_SEQ_CST);
+}
+
+size_t Epoch_oldest(void) {
+   struct Slot *psSlot;
+   size_t uOldest = (size_t)-1;
+   size_t uEpoch;
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   for (psSlot = __atomic_load_n(&psFirstSlot, __ATOMIC_ACQUIRE);
+        psSlot != NULL; psSlot = psSlot->psNextSlot) {
+      uEpoch = __atomic_load_n(&psSlot->uEpoch, __ATOMIC_ACQUIRE);
+      if (uEpoch != 0 && uEpoch < uOldest) uOldest = uEpoch;
+   }
+   return uOldest;
+}
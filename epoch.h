@@ -0,0 +1,31 @@
+/* Interface for Epoch functions */
+#ifndef EPOCH_INCLUDED
+#define EPOCH_INCLUDED
+#include <stddef.h>
+
+/* Epoch-based reclamation, shared by every thread of the process.
+   Readers bracket their reads of a shared structure with Epoch_enter
+   and Epoch_exit, which take no locks and perform no atomic
+   read-modify-write operations. A writer that unlinks memory which
+   readers may still be looking at calls Epoch_retire, and frees the
+   memory once Epoch_oldest is no less than the epoch it returned. */
+
+/* Begin a read section on the calling thread. Read sections nest.
+   Returns 1 (TRUE) if successful, or 0 (FALSE) if this is the calling
+   thread's first read section and insufficient memory is available
+   to track it, in which case the caller must not call Epoch_exit. */
+int Epoch_enter(void);
+
+/* End the read section that the matching Epoch_enter began. */
+void Epoch_exit(void);
+
+/* Advance the global epoch, after the calling thread has unlinked
+   memory that readers may still reach, and return the new epoch.
+   Read sections that begin from now on cannot reach that memory. */
+size_t Epoch_retire(void);
+
+/* Return the epoch of the oldest read section running now, or the
+   largest size_t if none is. Memory unlinked before an Epoch_retire
+   that returned an epoch no greater than this is unreachable. */
+size_t Epoch_oldest(void);
+#endif
@@ -0,0 +1,115 @@
+/* Module defining the hash function shared by the hash table
+   implementations of the symbol table. The fast policy follows the
+   structure of xxHash64, or of xxHash32 where unsigned long has 32
+   bits. */
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include "keyhash.h"
+
+#if KEYHASH_WORD_BITS == 64
+/* Multipliers used by the fast policy. */
+static const unsigned long PRIME_1 = 0x9E3779B185EBCA87UL;
+static const unsigned long PRIME_2 = 0xC2B2AE3D27D4EB4FUL;
+static const unsigned long PRIME_3 = 0x165667B19E3779F9UL;
+static const unsigned long PRIME_4 = 0x85EBCA77C2B2AE63UL;
+static const unsigned long PRIME_5 = 0x27D4EB2F165667C5UL;
+
+/* Rotations after mixing in a word, a half word and a character, and
+   the shifts of the final avalanche. */
+enum {WORD_ROTATION = 31, MERGE_ROTATION = 27, HALF_ROTATION = 23,
+      CHAR_ROTATION = 11};
+enum {AVALANCHE_SHIFT_1 = 33, AVALANCHE_SHIFT_2 = 29,
+      AVALANCHE_SHIFT_3 = 32};
+#else
+/* Multipliers used by the fast policy. */
+static const unsigned long PRIME_1 = 0x9E3779B1UL;
+static const unsigned long PRIME_2 = 0x85EBCA77UL;
+static const unsigned long PRIME_3 = 0xC2B2AE3DUL;
+static const unsigned long PRIME_4 = 0x27D4EB2FUL;
+static const unsigned long PRIME_5 = 0x165667B1UL;
+
+/* Rotations after mixing in a word, a half word and a character, and
+   the shifts of the final avalanche. */
+enum {WORD_ROTATION = 13, MERGE_ROTATION = 17, HALF_ROTATION = 15,
+      CHAR_ROTATION = 11};
+enum {AVALANCHE_SHIFT_1 = 15, AVALANCHE_SHIFT_2 = 13,
+      AVALANCHE_SHIFT_3 = 16};
+#endif
+
+/* Returns u rotated left by iBits bits. */
+static unsigned long KeyHash_rotate(unsigned long u, int iBits)
+{
+   return (u << iBits) | (u >> (KEYHASH_WORD_BITS - iBits));
+}
+
+/* Returns the hash of the uLength characters at pcKey, consuming a
+   word of characters per step. A half word is an int, so a 32-bit
+   word leaves too few characters for one. */
+static size_t KeyHash_fast(const char *pcKey, size_t uLength)
+{
+   const unsigned char *pucKey = (const unsigned char*)pcKey;
+   unsigned long ulHash;
+   unsigned long ulWord;
+   unsigned int uHalf;
+
+   ulHash = PRIME_5 + (unsigned long)uLength;
+
+   for (; uLength >= sizeof(ulWord); uLength -= sizeof(ulWord)) {
+      memcpy(&ulWord, pucKey, sizeof(ulWord));
+      ulWord *= PRIME_2;
+      ulWord = KeyHash_rotate(ulWord, WORD_ROTATION);
+      ulWord *= PRIME_1;
+      ulHash ^= ulWord;
+      ulHash = KeyHash_rotate(ulHash, MERGE_ROTATION) * PRIME_1
+         + PRIME_4;
+      pucKey += sizeof(ulWord);
+   }
+
+   if (uLength >= sizeof(uHalf)) {
+      memcpy(&uHalf, pucKey, sizeof(uHalf));
+      ulHash ^= (unsigned long)uHalf * PRIME_1;
+      ulHash = KeyHash_rotate(ulHash, HALF_ROTATION) * PRIME_2
+         + PRIME_3;
+      pucKey += sizeof(uHalf);
+      uLength -= sizeof(uHalf);
+   }
+
+   for (; uLength > 0; uLength--) {
+      ulHash ^= (unsigned long)*pucKey * PRIME_5;
+      ulHash = KeyHash_rotate(ulHash, CHAR_ROTATION) * PRIME_1;
+      pucKey++;
+   }
+
+   /* Let every input bit affect every output bit */
+   ulHash ^= ulHash >> AVALANCHE_SHIFT_1;
+   ulHash *= PRIME_2;
+   ulHash ^= ulHash >> AVALANCHE_SHIFT_2;
+   ulHash *= PRIME_3;
+   ulHash ^= ulHash >> AVALANCHE_SHIFT_3;
+   return (size_t)ulHash;
+}
+
+/* Returns the hash of the uLength characters at pcKey, computed one
+   character at a time as in the assignment specification. */
+static size_t KeyHash_legacy(const char *pcKey, size_t uLength)
+{
+   const size_t HASH_MULTIPLIER = 65599;
+   size_t u;
+   size_t uHash = 0;
+
+   for (u = 0; u < uLength; u++)
+      uHash = uHash * HASH_MULTIPLIER + (size_t)pcKey[u];
+
+   return uHash;
+}
+
+size_t KeyHash_hash(const char *pcKey, size_t uLength)
+{
+   assert(pcKey != NULL);
+
+   if (KEYHASH_POLICY == KEYHASH_LEGACY)
+      return KeyHash_legacy(pcKey, uLength);
+   return KeyHash_fast(pcKey, uLength);
+}
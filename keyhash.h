@@ -0,0 +1,31 @@
+/* Interface for KeyHash functions */
+#ifndef KEYHASH_INCLUDED
+#define KEYHASH_INCLUDED
+#include <stddef.h>
+#include <limits.h>
+
+/* The number of bits in the words that the fast policy mixes: 64
+   where unsigned long has 64 bits, and 32 where it has 32. The tables
+   that scramble hashes further choose their constants by it too. */
+#if ULONG_MAX > 0xFFFFFFFFUL
+#define KEYHASH_WORD_BITS 64
+#else
+#define KEYHASH_WORD_BITS 32
+#endif
+
+/* Hash policies. KEYHASH_FAST mixes the key a word at a time and
+   spreads it over every bit of the result, so a table may take the
+   low bits as its bucket number. KEYHASH_LEGACY is the byte-at-a-time
+   65599 hash from the assignment specification, kept so that the two
+   can be benchmarked against each other. */
+enum {KEYHASH_FAST, KEYHASH_LEGACY};
+
+/* The policy KeyHash_hash uses. Build with
+   -D KEYHASH_POLICY=KEYHASH_LEGACY to select the legacy hash. */
+#ifndef KEYHASH_POLICY
+#define KEYHASH_POLICY KEYHASH_FAST
+#endif
+
+/* Return the hash of the uLength characters at pcKey. */
+size_t KeyHash_hash(const char *pcKey, size_t uLength);
+#endif
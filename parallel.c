@@ -0,0 +1,158 @@
+/* Module defining the running of a range of work on several threads
+   that share it out in chunks. */
+
+/* For pthread_once and pthread_key_create */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "parallel.h"
+
+/* The work that the threads of one Parallel_run share. */
+struct Work
+{
+   /* The number of indices, and of indices per chunk. */
+   size_t uCount;
+   size_t uChunkSize;
+
+   /* The first index of the next chunk to be taken. Guarded by
+      lock. */
+   size_t uNext;
+   pthread_mutex_t lock;
+
+   /* The caller's function and its extra parameter. */
+   void (*pfRun)(size_t uFirst, size_t uLimit, void *pvExtra);
+   void *pvExtra;
+};
+
+/* A thread that Parallel_run starts. */
+struct Worker
+{
+   /* The work it shares. */
+   struct Work *psWork;
+
+   /* Its number, which Parallel_worker returns. */
+   size_t uIndex;
+
+   /* The thread. */
+   pthread_t thread;
+};
+
+/* The key under which each thread keeps the address of its number
+   while it runs chunks. */
+static pthread_key_t workerKey;
+static pthread_once_t workerKeyOnce = PTHREAD_ONCE_INIT;
+static int iWorkerKeyCreated = 0;
+
+/* Creates workerKey. Run once, by the first thread to need it. */
+static void Parallel_createWorkerKey(void) {
+   iWorkerKeyCreated = pthread_key_create(&workerKey, NULL) == 0;
+}
+
+/* Runs chunks of psWork until none are left. */
+static void Parallel_work(struct Work *psWork) {
+   size_t uFirst;
+   size_t uLimit;
+
+   assert(psWork != NULL);
+
+   for (;;) {
+      pthread_mutex_lock(&psWork->lock);
+      uFirst = psWork->uNext;
+      if (psWork->uCount - uFirst > psWork->uChunkSize)
+         uLimit = uFirst + psWork->uChunkSize;
+      else
+         uLimit = psWork->uCount;
+      psWork->uNext = uLimit;
+      pthread_mutex_unlock(&psWork->lock);
+
+      if (uFirst == uLimit) return;
+      (*psWork->pfRun)(uFirst, uLimit, psWork->pvExtra);
+   }
+}
+
+/* The start routine of a thread that Parallel_run starts, given the
+   address of its Worker. */
+static void *Parallel_start(void *pvWorker) {
+   struct Worker *psWorker = (struct Worker*)pvWorker;
+
+   assert(psWorker != NULL);
+
+   (void)pthread_setspecific(workerKey, &psWorker->uIndex);
+   Parallel_work(psWorker->psWork);
+   return NULL;
+}
+
+void Parallel_run(size_t uCount, size_t uChunkSize,
+                  void (*pfRun)(size_t uFirst, size_t uLimit,
+                                void *pvExtra),
+                  const void *pvExtra, int iThreads) {
+   struct Work sWork;
+   struct Worker *asWorkers = NULL;
+   size_t uStarted = 0;
+   size_t uCallerIndex = 0;
+   void *pvCallerIndex = NULL;
+   size_t u;
+
+   assert(uChunkSize > 0);
+   assert(pfRun != NULL);
+   assert(iThreads > 0);
+
+   sWork.uCount = uCount;
+   sWork.uChunkSize = uChunkSize;
+   sWork.uNext = 0;
+   sWork.pfRun = pfRun;
+   sWork.pvExtra = (void*)pvExtra;
+   if (pthread_mutex_init(&sWork.lock, NULL) != 0) {
+      /* With no lock to share by, the calling thread does it all */
+      if (uCount > 0) (*pfRun)(0, uCount, (void*)pvExtra);
+      return;
+   }
+
+   /* Without numbers for the threads, they cannot run together */
+   pthread_once(&workerKeyOnce, Parallel_createWorkerKey);
+   if (! iWorkerKeyCreated) iThreads = 1;
+
+   /* No more threads than chunks */
+   if ((size_t)iThreads > uCount / uChunkSize + 1)
+      iThreads = (int)(uCount / uChunkSize + 1);
+
+   if (iThreads > 1)
+      asWorkers = (struct Worker*)malloc((size_t)(iThreads - 1)
+                                         * sizeof(struct Worker));
+   if (asWorkers != NULL) {
+      for (u = 0; u < (size_t)iThreads - 1; u++) {
+         asWorkers[uStarted].psWork = &sWork;
+         asWorkers[uStarted].uIndex = uStarted + 1;
+         if (pthread_create(&asWorkers[uStarted].thread, NULL,
+                            Parallel_start, &asWorkers[uStarted]) == 0)
+            uStarted++;
+      }
+   }
+
+   if (iWorkerKeyCreated) {
+      pvCallerIndex = pthread_getspecific(workerKey);
+      (void)pthread_setspecific(workerKey, &uCallerIndex);
+   }
+   Parallel_work(&sWork);
+   if (iWorkerKeyCreated)
+      (void)pthread_setspecific(workerKey, pvCallerIndex);
+
+   for (u = 0; u < uStarted; u++)
+      pthread_join(asWorkers[u].thread, NULL);
+   free(asWorkers);
+   pthread_mutex_destroy(&sWork.lock);
+}
+
+size_t Parallel_worker(void) {
+   size_t *puIndex;
+
+   pthread_once(&workerKeyOnce, Parallel_createWorkerKey);
+   if (! iWorkerKeyCreated) return 0;
+
+   puIndex = (size_t*)pthread_getspecific(workerKey);
+   if (puIndex == NULL) return 0;
+   return *puIndex;
+}
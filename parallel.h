@@ -0,0 +1,23 @@
+/* Interface for Parallel functions */
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+#include <stddef.h>
+
+/* Call (*pfRun)(uFirst, uLimit, pvExtra) for consecutive chunks of
+   uChunkSize indices, the last perhaps shorter, that together cover
+   0 to uCount - 1. Up to iThreads threads, the calling one among
+   them, share the chunks, each taking the next one as it finishes
+   the last, so that chunks of uneven cost still balance. Returns once
+   every chunk is done. If fewer threads can be started, the chunks
+   are shared among those that are, down to only the calling one. */
+void Parallel_run(size_t uCount, size_t uChunkSize,
+                  void (*pfRun)(size_t uFirst, size_t uLimit,
+                                void *pvExtra),
+                  const void *pvExtra, int iThreads);
+
+/* Return, to a pfRun called by Parallel_run with iThreads threads,
+   the number from 0 to iThreads - 1 of the thread it runs on, 0 being
+   the thread that called Parallel_run. Returns 0 outside Parallel_run.
+   */
+size_t Parallel_worker(void);
+#endif
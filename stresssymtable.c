@@ -0,0 +1,322 @@
+/*--------------------------------------------------------------------*/
+/* stresssymtable.c                                                   */
+/*--------------------------------------------------------------------*/
+
+/* Shares one SymTable among 1, 2, 4, ... threads in turn, reports the
+   throughput of each thread count, and checks that no thread sees
+   another thread's operations corrupt a binding or lose an upsert.
+   Only an
+   implementation of symtable.h that is safe to share between threads,
+   such as symtableconc.c, passes. */
+
+/* For pthreads, clock_gettime and sysconf */
+#define _POSIX_C_SOURCE 200112L
+
+#include "symtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*--------------------------------------------------------------------*/
+
+/* The number of bindings that every thread reads and replaces. */
+enum {SHARED_KEY_COUNT = 60000};
+
+/* The number of keys that each thread alone puts and removes. Enough
+   of them come and go that the table resizes while threads use it. */
+enum {PRIVATE_KEY_COUNT = 20000};
+
+/* The number of counters that every thread adds one to with
+   SymTable_upsert. They are few, so that threads often upsert the
+   same one at once. */
+enum {COUNTER_KEY_COUNT = 16};
+
+/* Out of every 100 operations, GET_PERCENT are gets of shared keys,
+   REPLACE_PERCENT are replaces of shared keys, and UPSERT_PERCENT are
+   upserts of counters. The rest put or remove private keys. */
+enum {GET_PERCENT = 90, REPLACE_PERCENT = 4, UPSERT_PERCENT = 1};
+
+enum {MAX_KEY_LENGTH = 32};
+enum {MAX_THREAD_COUNT = 256};
+
+/*--------------------------------------------------------------------*/
+
+/* The table that the threads share, its shared keys, and the values
+   bound to them. Shared key i is always bound to &aiSharedValues[i]. */
+static SymTable_T oSymTable;
+static char aacSharedKeys[SHARED_KEY_COUNT][MAX_KEY_LENGTH];
+static int aiSharedValues[SHARED_KEY_COUNT];
+
+/* The counters' keys, and their counts. Counter i is bound to
+   &alCounts[i], which only SymTable_upsert's update changes. */
+static char aacCounterKeys[COUNTER_KEY_COUNT][MAX_KEY_LENGTH];
+static long alCounts[COUNTER_KEY_COUNT];
+
+/* The state of one thread. */
+struct Worker
+{
+   pthread_t thread;
+
+   /* The thread's number, which names its private keys. */
+   int iIndex;
+
+   /* The number of operations to perform. */
+   long lOperations;
+
+   /* The state of the thread's random number generator. */
+   unsigned long ulSeed;
+
+   /* Whether each of the thread's private keys is in oSymTable. */
+   char acPresent[PRIVATE_KEY_COUNT];
+
+   /* The number of upserts the thread made. */
+   long lUpserts;
+
+   /* The number of operations whose results were wrong. */
+   long lFailures;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Return the next number from the xorshift generator whose state is
+   *pulSeed, a number in [0, 2^32). */
+
+static unsigned long nextRandom(unsigned long *pulSeed)
+{
+   unsigned long ul = *pulSeed;
+   ul ^= (ul << 13) & 0xffffffffUL;
+   ul ^= ul >> 17;
+   ul ^= (ul << 5) & 0xffffffffUL;
+   *pulSeed = ul;
+   return ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Add one to the count that the counter value pvValue points to, and
+   return pvValue. pcKey and pvExtra are unused. */
+
+static void *addOne(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvExtra;
+   (*(long*)pvValue)++;
+   return pvValue;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Perform the operations of the Worker pvWorker on oSymTable,
+   counting the wrong results. Return NULL. */
+
+static void *work(void *pvWorker)
+{
+   struct Worker *psWorker = (struct Worker*)pvWorker;
+   char acKey[MAX_KEY_LENGTH];
+   unsigned long ulRandom;
+   long l;
+   int iPercent;
+   int iKey;
+
+   for (l = 0; l < psWorker->lOperations; l++)
+   {
+      ulRandom = nextRandom(&psWorker->ulSeed);
+      iPercent = (int)(ulRandom % 100);
+      ulRandom /= 100;
+
+      if (iPercent < GET_PERCENT)
+      {
+         iKey = (int)(ulRandom % SHARED_KEY_COUNT);
+         if (SymTable_get(oSymTable, aacSharedKeys[iKey])
+             != &aiSharedValues[iKey])
+            psWorker->lFailures++;
+      }
+      else if (iPercent < GET_PERCENT + REPLACE_PERCENT)
+      {
+         iKey = (int)(ulRandom % SHARED_KEY_COUNT);
+         if (SymTable_replace(oSymTable, aacSharedKeys[iKey],
+                              &aiSharedValues[iKey])
+             != &aiSharedValues[iKey])
+            psWorker->lFailures++;
+      }
+      else if (iPercent < GET_PERCENT + REPLACE_PERCENT + UPSERT_PERCENT)
+      {
+         iKey = (int)(ulRandom % COUNTER_KEY_COUNT);
+         if (! SymTable_upsert(oSymTable, aacCounterKeys[iKey],
+                               &alCounts[iKey], addOne, NULL, NULL))
+            psWorker->lFailures++;
+         psWorker->lUpserts++;
+      }
+      else
+      {
+         iKey = (int)(ulRandom % PRIVATE_KEY_COUNT);
+         sprintf(acKey, "t%d-%d", psWorker->iIndex, iKey);
+         if (psWorker->acPresent[iKey])
+         {
+            if (SymTable_remove(oSymTable, acKey) != psWorker)
+               psWorker->lFailures++;
+         }
+         else if (! SymTable_put(oSymTable, acKey, psWorker))
+            psWorker->lFailures++;
+         psWorker->acPresent[iKey] = (char)! psWorker->acPresent[iKey];
+      }
+   }
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the number of seconds on a monotonic clock. */
+
+static double getSeconds(void)
+{
+   struct timespec sTime;
+   clock_gettime(CLOCK_MONOTONIC, &sTime);
+   return (double)sTime.tv_sec + (double)sTime.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Fill a new oSymTable with the shared keys, run iThreadCount threads
+   of lOperations operations each on it, and print their combined
+   throughput relative to dBaseRate operations per second, or to
+   their own if dBaseRate is 0. Return the throughput, or -1 if an
+   operation went wrong. */
+
+static double runThreads(int iThreadCount, long lOperations,
+   double dBaseRate)
+{
+   struct Worker *psWorkers;
+   double dStart;
+   double dSeconds;
+   double dRate;
+   long lFailures = 0;
+   long lUpserts = 0;
+   long lCounted = 0;
+   size_t uExpected = SHARED_KEY_COUNT;
+   long *plCount;
+   int i;
+   int j;
+
+   oSymTable = SymTable_new();
+   psWorkers = (struct Worker*)calloc((size_t)iThreadCount,
+                                      sizeof(struct Worker));
+   if (oSymTable == NULL || psWorkers == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+   for (i = 0; i < SHARED_KEY_COUNT; i++)
+      SymTable_put(oSymTable, aacSharedKeys[i], &aiSharedValues[i]);
+   for (i = 0; i < COUNTER_KEY_COUNT; i++)
+      alCounts[i] = 0;
+
+   dStart = getSeconds();
+   for (i = 0; i < iThreadCount; i++)
+   {
+      psWorkers[i].iIndex = i;
+      psWorkers[i].lOperations = lOperations;
+      psWorkers[i].ulSeed = 2463534242UL + (unsigned long)i;
+      if (pthread_create(&psWorkers[i].thread, NULL, work,
+                         &psWorkers[i]) != 0)
+      {
+         fprintf(stderr, "Cannot create thread %d\n", i);
+         exit(EXIT_FAILURE);
+      }
+   }
+   for (i = 0; i < iThreadCount; i++)
+      pthread_join(psWorkers[i].thread, NULL);
+   dSeconds = getSeconds() - dStart;
+
+   /* Every private key that a thread left behind is still there, and
+      the counters lost no upserts */
+   for (i = 0; i < iThreadCount; i++)
+   {
+      lFailures += psWorkers[i].lFailures;
+      lUpserts += psWorkers[i].lUpserts;
+      for (j = 0; j < PRIVATE_KEY_COUNT; j++)
+         uExpected += (size_t)psWorkers[i].acPresent[j];
+   }
+   for (i = 0; i < COUNTER_KEY_COUNT; i++)
+   {
+      plCount = (long*)SymTable_get(oSymTable, aacCounterKeys[i]);
+      if (plCount != NULL)
+      {
+         lCounted += *plCount;
+         uExpected++;
+      }
+   }
+   if (SymTable_getLength(oSymTable) != uExpected || lCounted != lUpserts)
+      lFailures++;
+
+   dRate = (double)iThreadCount * (double)lOperations / dSeconds;
+   if (dBaseRate == 0.0)
+      dBaseRate = dRate;
+   printf("%7d %10.3f %12.0f %8.2f\n", iThreadCount, dSeconds, dRate,
+          dRate / dBaseRate);
+   if (lFailures != 0)
+      printf("%ld operations with %d threads failed.\n", lFailures,
+             iThreadCount);
+   fflush(stdout);
+
+   SymTable_free(oSymTable);
+   free(psWorkers);
+   return lFailures == 0 ? dRate : -1.0;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Run the stress test with 1, 2, 4, ... threads up to argv[1], which
+   defaults to the number of processors, each performing argv[2]
+   operations, which defaults to 1000000. Return 0 if every operation
+   gave the right result, or EXIT_FAILURE otherwise. */
+
+int main(int argc, char *argv[])
+{
+   int iMaxThreads;
+   int iThreads;
+   long lOperations = 1000000;
+   double dBaseRate = 0.0;
+   double dRate;
+   int iSuccessful = 1;
+   int i;
+
+   iMaxThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (argc > 3 ||
+       (argc > 1 && sscanf(argv[1], "%d", &iMaxThreads) != 1) ||
+       (argc > 2 && sscanf(argv[2], "%ld", &lOperations) != 1))
+   {
+      fprintf(stderr, "Usage: %s [maxthreads [operations]]\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   if (iMaxThreads < 1 || iMaxThreads > MAX_THREAD_COUNT ||
+       lOperations < 1)
+   {
+      fprintf(stderr, "maxthreads must be from 1 to %d, and operations"
+              " must be positive\n", MAX_THREAD_COUNT);
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = 0; i < SHARED_KEY_COUNT; i++)
+      sprintf(aacSharedKeys[i], "shared%d", i);
+   for (i = 0; i < COUNTER_KEY_COUNT; i++)
+      sprintf(aacCounterKeys[i], "counter%d", i);
+
+   printf("threads    seconds    ops/second  speedup\n");
+   for (iThreads = 1; ; iThreads *= 2)
+   {
+      if (iThreads > iMaxThreads)
+         iThreads = iMaxThreads;
+      dRate = runThreads(iThreads, lOperations, dBaseRate);
+      if (dRate < 0.0)
+         iSuccessful = 0;
+      else if (dBaseRate == 0.0)
+         dBaseRate = dRate;
+      if (iThreads == iMaxThreads)
+         break;
+   }
+   return iSuccessful ? 0 : EXIT_FAILURE;
+}
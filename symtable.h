@@ -11,16 +11,156 @@ typedef struct SymTable *SymTable_T;
    available. */
 SymTable_T SymTable_new(void);
 
+/* Options for SymTable_newWithOptions, combined with bitwise or.
+   SYMTABLE_ARENA takes nodes and key copies from large pages owned by
+   the table instead of calling malloc for each binding, and lets
+   SymTable_free release the pages without visiting every binding.
+   Memory of removed nodes is reused, but memory of removed keys is
+   kept until SymTable_free.
+   SYMTABLE_MOVE_TO_FRONT and SYMTABLE_TRANSPOSE let a list keep its
+   most used bindings near the front, so that skewed lookups scan
+   less of it: each get, contains or replace that finds a binding
+   moves it to the front of the list, or one place toward it,
+   respectively. Move-to-front adapts faster to a change in which keys
+   are hot; transpose lets a one-off lookup disturb the order less. If
+   both are given, move-to-front is used. Such a lookup changes the
+   table, so it makes iterators stale and must not run at the same
+   time as any other call on the table.
+   SYMTABLE_BORROWED_KEYS makes the table keep the key pointers it is
+   given instead of copies, saving an allocation and a copy per
+   binding; the caller must keep every key it puts unchanged for as
+   long as the table exists. Keys that are interned, so that equal
+   keys are the same pointer, then compare with a single pointer
+   compare. Every implementation tries the pointers before the
+   characters, whatever its options. */
+enum {SYMTABLE_ARENA = 0x1, SYMTABLE_MOVE_TO_FRONT = 0x2,
+      SYMTABLE_TRANSPOSE = 0x4, SYMTABLE_BORROWED_KEYS = 0x8};
+
+/* Return a new SymTable_T object configured by iOptions, a bitwise or
+   of SYMTABLE_ options, or NULL if insufficient memory is available.
+   An implementation ignores options that it does not support. */
+SymTable_T SymTable_newWithOptions(int iOptions);
+
+/* Return a new SymTable_T object with room for uCapacity bindings
+   before it needs to resize, or NULL if insufficient memory is
+   available. */
+SymTable_T SymTable_newWithCapacity(size_t uCapacity);
+
+/* Make room in oSymTable for a total of uCapacity bindings, so that
+   putting bindings until there are that many causes no resizing.
+   Returns 1 (TRUE) if successful, or 0 (FALSE) if insufficient memory
+   is available, in which case oSymTable still works. */
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity);
+
+/* Shrink oSymTable's internal storage to fit the bindings it holds
+   now, releasing memory left over from earlier growth or from
+   SymTable_reserve. */
+void SymTable_compact(SymTable_T oSymTable);
+
 /* Free oSymTable */
 void SymTable_free(SymTable_T oSymTable);
 
 /* Return number of bindings in oSymTable */
 size_t SymTable_getLength(SymTable_T oSymTable);
 
-/* Add the binding pcKey-pvValue to oSymTable. Returns 1 (TRUE) 
+/* The number of chain lengths that a SymTableStats counts
+   separately. */
+enum {SYMTABLE_HISTOGRAM_SIZE = 16};
+
+/* A SymTableStats describes how a SymTable_T is laid out and how it
+   has fared, so that a poor hash (long chains at a low load factor)
+   can be told from an undersized table (a high load factor) or from
+   allocation pressure (failed resizes, or many bytes per binding).
+   A bucket is a list of a chained hash table, a slot of an
+   open-addressing one, a leaf of a tree, or the whole of a list. A
+   chain is what a lookup walks to reach a binding: a bucket's
+   bindings, or, in an open-addressing table, the slots probed up to
+   the binding in a slot, an empty slot having a chain of 0. */
+struct SymTableStats
+{
+   /* The number of bindings, and of buckets they are spread over. */
+   size_t uBindings;
+   size_t uBuckets;
+
+   /* The number of bindings per bucket. */
+   double dLoadFactor;
+
+   /* The longest chain, and how many buckets have a chain of each
+      length from 0 to SYMTABLE_HISTOGRAM_SIZE - 1, the last counting
+      longer chains too. */
+   size_t uMaxChain;
+   size_t auChains[SYMTABLE_HISTOGRAM_SIZE];
+
+   /* The number of times the table has resized, and has tried to but
+      found insufficient memory. */
+   size_t uResizes;
+   size_t uFailedResizes;
+
+   /* The number of bytes of memory the table holds for itself, its
+      buckets, its bindings and its keys. */
+   size_t uBytes;
+
+   /* The lookups that found their key and the probes they took, and
+      the lookups that did not and theirs. The searches that begin
+      puts and removes count too, and a probe is a binding compared, a
+      slot examined or a tree node visited. Counting slows every
+      lookup, so it is compiled in only if SYMTABLE_STATS is defined;
+      otherwise these are 0. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
+};
+
+/* Set *psStats to describe oSymTable. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats);
+
+/* Add the binding pcKey-pvValue to oSymTable. Returns 1 (TRUE)
    if successful, or 0 (FALSE) if insufficient memory is available. */
 int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue);
 
+/* Add the bindings apcKeys[i]-apvValues[i], for i from 0 to
+   uCount - 1, to oSymTable as if by SymTable_put, sizing oSymTable
+   once for the whole batch. If aiResults is not NULL, set aiResults[i]
+   to the value SymTable_put would have returned for binding i.
+   Returns the number of bindings added. */
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]);
+
+/* Look up the binding within oSymTable whose key is pcKey, first
+   adding the binding pcKey-pvDefault if there is none, and return the
+   address of the binding's value, so that the caller can read and
+   change the value in place after a single lookup. Set *piInserted,
+   unless piInserted is NULL, to 1 (TRUE) if the binding was added or
+   to 0 (FALSE) if it was there already. Returns NULL, and sets
+   *piInserted to 0, if insufficient memory is available to add it.
+   The address is valid until oSymTable next changes in a way that
+   makes its iterators stale. An implementation that several threads
+   may change at once cannot let a caller store through an address
+   while other threads look the binding up, so it leaves oSymTable
+   unchanged and returns NULL; SymTable_upsert works there instead. */
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted);
+
+/* Look up the binding within oSymTable whose key is pcKey, first
+   adding the binding pcKey-pvDefault if there is none, and then,
+   unless pfUpdate is NULL, replace the binding's value with the one
+   (*pfUpdate) returns given pcKey, the value, and pvExtra. Set
+   *piInserted as SymTable_findOrInsert does. Returns 1 (TRUE) if
+   successful, or 0 (FALSE) if insufficient memory is available to add
+   the binding, in which case (*pfUpdate) is not called. In an
+   implementation that several threads may change at once, (*pfUpdate)
+   runs while no other thread can change the binding, so concurrent
+   upserts of one key lose no updates, and lookups see the value
+   either before or after it; (*pfUpdate) must not call any SymTable
+   function on oSymTable. */
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted);
+
 /* SymTable_replace replaces the pcKey's bound  value with pvValue and 
    returns the old value. Otherwise it leaves oSymTable unchanged and 
    returns NULL.*/
@@ -35,14 +175,104 @@ int SymTable_contains(SymTable_T oSymTable, const char *pcKey);
    pcKey, or NULL if no such binding exists.  */
 void *SymTable_get(SymTable_T oSymTable, const char *pcKey);
 
+/* Set apvValues[i] to the value of the binding within oSymTable whose
+   key is apcKeys[i], or to NULL if no such binding exists, for i from
+   0 to uCount - 1. Returns the number of keys found. */
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]);
+
 /* If oSymTable contains a binding with key pcKey, then 
    SymTable_remove removes that binding from oSymTable and returns the
    binding's value. Otherwise SymTable_remove does not change 
    oSymTable and returns NULL. */
 void *SymTable_remove(SymTable_T oSymTable, const char *pcKey);
 
+/* SymTable_putN, SymTable_getN, SymTable_containsN and
+   SymTable_removeN do as SymTable_put, SymTable_get, SymTable_contains
+   and SymTable_remove do, but with the key given as the uLength
+   characters at pcKey, which need not be followed by '\0'. A key can
+   then be used where it lies within a larger buffer, without copying
+   it out, and is not scanned to find its length. The characters must
+   not include '\0'. SymTable_putN binds a copy of them with '\0'
+   appended, unless oSymTable was created with SYMTABLE_BORROWED_KEYS,
+   in which case it keeps pcKey itself and pcKey[uLength] must be
+   '\0'. */
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue);
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength);
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength);
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength);
+
 /* Calls (*pfApply) for all key-value bindings in oSymTable,
 passes pvExtra as an extra parameter */
 void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra);
+
+/* Calls (*pfApply) for all key-value bindings in oSymTable, passing
+   pvExtra as an extra parameter, as SymTable_map does, but on up to
+   iThreads threads, the calling one among them. The threads take the
+   table in chunks, each taking the next as it finishes the last, so
+   that uneven chunks still balance. Bindings are visited in no
+   particular order, and (*pfApply) may run on several threads at
+   once; SymTable_mapWorker tells it which. (*pfApply) must not change
+   oSymTable. An implementation may use fewer threads, down to only
+   the calling one. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads);
+
+/* Returns, to a pfApply called by SymTable_mapParallel with iThreads
+   threads, the number from 0 to iThreads - 1 of the thread it runs
+   on, so that it can accumulate results in a slot of its own without
+   locking and the caller can combine the slots afterwards. Returns 0
+   elsewhere. */
+size_t SymTable_mapWorker(void);
+
+/* A SymTableIter is a position among the bindings of a SymTable_T.
+   Callers declare one, usually as a local variable, and pass its
+   address to the SymTable_iter functions, so iterating allocates
+   nothing and calls no callback. Its fields belong to the
+   implementation. */
+struct SymTableIter
+{
+   SymTable_T oSymTable;
+   const void *pvPosition;
+   size_t uIndex;
+   size_t uOuterIndex;
+   size_t uVersion;
+   const char *pcKey;
+   void *pvValue;
+   int iStale;
+};
+
+/* Set *psIter to the position before the first binding of
+   oSymTable. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter);
+
+/* Advance *psIter to the next binding of its SymTable_T. Returns 1
+   (TRUE) if there is one, or 0 (FALSE) if every binding has been
+   visited or the iterator is stale. Bindings are visited in the same
+   order as by SymTable_map. An iterator is stale, and stays so, once
+   its SymTable_T gains or loses a binding, is resized or compacted, or
+   reorders its bindings, after SymTable_iterBegin; replacing values
+   in a table that does not reorder leaves it usable. An
+   implementation that several threads may change at once may limit
+   this to changes to the part of the table the iterator is in. */
+int SymTable_iterNext(struct SymTableIter *psIter);
+
+/* Return the key of the binding that *psIter is at, which is valid
+   for as long as the binding is. */
+const char *SymTable_iterKey(const struct SymTableIter *psIter);
+
+/* Return the value that the binding *psIter is at had when
+   SymTable_iterNext reached it. */
+void *SymTable_iterValue(const struct SymTableIter *psIter);
+
+/* Return 1 (TRUE) if SymTable_iterNext stopped *psIter because its
+   SymTable_T changed, or 0 (FALSE) otherwise. */
+int SymTable_iterStale(const struct SymTableIter *psIter);
 #endif
   
\ No newline at end of file
@@ -0,0 +1,1043 @@
+/* Module defining a number of symbol table functions using a hash
+   table that several threads may use at once. The buckets are split
+   among stripes, each guarded by its own reader/writer lock, so
+   lookups of different keys run in parallel and a put or remove
+   blocks only the lookups that share its stripe. */
+
+/* For pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "symtable.h"
+#include "keyhash.h"
+#include "parallel.h"
+
+/* The number of buckets in a new SymTable. Bucket counts are powers
+   of two, so a bucket number is the low bits of the full hash. */
+enum {INITIAL_BUCKET_COUNT = 512};
+
+/* The number of stripes. A power of two no larger than
+   INITIAL_BUCKET_COUNT, so that every stripe owns the same number of
+   buckets at any size. */
+enum {STRIPE_COUNT = 64};
+
+/* Keys shorter than this many characters are stored inline in their
+   node instead of in a separate allocation. */
+enum {SHORT_KEY_SIZE = 24};
+
+/* The size of a cache line, which each stripe's lock and count are
+   kept apart by. */
+enum {CACHE_LINE_SIZE = 64};
+
+/* Each key-value binding is stored in a BucketNode. BucketNodes
+   are placed in buckets to form lists. */
+struct BucketNode
+{
+   /* The binding's key. */
+   const char *pcKey;
+
+   /* The binding's value. */
+   const void *pvValue;
+
+   /* The full hash of the binding's key, before it is reduced to a
+      bucket number. */
+   size_t uHash;
+
+   /* The number of characters in the binding's key, so that keys of
+      other lengths are passed over without being read. */
+   size_t uLength;
+
+   /* The address of the next BucketNode. */
+   struct BucketNode *psNextNode;
+
+   /* Storage for the key, if it is shorter than SHORT_KEY_SIZE, so
+      that comparing it touches no memory outside the node. */
+   char acShortKey[SHORT_KEY_SIZE];
+};
+
+/* A Stripe guards every bucket whose number is its own index modulo
+   STRIPE_COUNT. Bucket counts are multiples of STRIPE_COUNT, so that
+   is the low bits of the full hash whatever the table size, and a
+   resize never moves a binding from one stripe to another. */
+struct Stripe
+{
+   /* Held for reading to look at the stripe's buckets, and for
+      writing to change them. */
+   pthread_rwlock_t lock;
+
+   /* The index, within the SymTable's hashTables, of the hash table
+      that holds this stripe's buckets. */
+   int iTable;
+
+   /* The number of bindings in this stripe's buckets. */
+   size_t nodeCount;
+
+   /* Changed whenever a binding is added to or removed from this
+      stripe's buckets or they are moved, so that iterators can tell
+      that they are stale. */
+   size_t uVersion;
+
+   /* Lookups in this stripe's buckets that found their key and the
+      nodes they compared, and lookups that did not and theirs,
+      counted only if SYMTABLE_STATS is defined. Lookups sharing the
+      read lock add to these at once, so every update is atomic. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
+
+   /* Keeps the locks of neighbouring stripes off each other's cache
+      lines. */
+   char acPadding[CACHE_LINE_SIZE];
+};
+
+/* A SymTable tracks a hash table containing lists of key-value
+   bindings. A resize builds a second hash table and moves the
+   stripes into it one at a time, so the SymTable keeps two. */
+struct SymTable
+{
+   /* The addresses of the first elements of up to two arrays of
+      BucketNodes, each element of which is a Bucket. Each stripe's
+      buckets are in the hash table its iTable names; the other hash
+      table is NULL except during a resize. */
+   struct BucketNode **hashTables[2];
+
+   /* The number of buckets in each of hashTables. */
+   size_t hashTableSizes[2];
+
+   /* The index, within hashTables, of the hash table that holds
+      every stripe when no resize is in progress. */
+   int iTable;
+
+   /* Held by the one thread that may resize the SymTable. Guards
+      iTable, and the writes to hashTables and hashTableSizes. */
+   pthread_mutex_t resizeLock;
+
+   /* 1 (TRUE) if BucketNodes point to their callers' keys instead of
+      to copies, or 0 (FALSE) otherwise. Never changes. */
+   int iBorrowedKeys;
+
+   /* The resizes since the SymTable was created, and those that found
+      insufficient memory. Guarded by resizeLock. */
+   size_t uResizes;
+   size_t uFailedResizes;
+
+   /* The stripes that the buckets are split among. */
+   struct Stripe stripes[STRIPE_COUNT];
+};
+
+/* Counts, for SymTable_getStats, a lookup in the buckets of psStripe
+   that compared uProbes nodes and found its key if iFound is 1
+   (TRUE). Compiles to nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_add(pu, u) __atomic_fetch_add(pu, u, __ATOMIC_RELAXED)
+#define SymTable_countLookup(psStripe, iFound, uProbes)               \
+   ((void)((iFound) ? (SymTable_add(&(psStripe)->uHits, 1),           \
+                       SymTable_add(&(psStripe)->uHitProbes, uProbes)) \
+                    : (SymTable_add(&(psStripe)->uMisses, 1),         \
+                       SymTable_add(&(psStripe)->uMissProbes, uProbes))))
+#else
+#define SymTable_countLookup(psStripe, iFound, uProbes)               \
+   ((void)(psStripe), (void)(iFound), (void)(uProbes))
+#endif
+
+/* Calculates and returns the full hash of the uLength characters at
+   pcKey. Mask it with the number of buckets minus one to get a bucket
+   number. */
+static size_t SymTable_hash(const char *pcKey, size_t uLength)
+{
+   assert(pcKey != NULL);
+
+   return KeyHash_hash(pcKey, uLength);
+}
+
+/* Returns the bucket count that follows uSize, or uSize itself if the
+   table cannot grow any further. */
+static size_t SymTable_nextSize(size_t uSize)
+{
+   if (uSize > (size_t)-1 / sizeof(struct BucketNode*) / 2)
+      return uSize;
+   return 2 * uSize;
+}
+
+/* Returns the smallest bucket count that holds uCapacity bindings
+   without expanding, or 0 if no bucket array can be that large. */
+static size_t SymTable_sizeFor(size_t uCapacity)
+{
+   size_t uSize = INITIAL_BUCKET_COUNT;
+
+   while (uSize <= uCapacity) {
+      if (SymTable_nextSize(uSize) == uSize) return 0;
+      uSize = SymTable_nextSize(uSize);
+   }
+   return uSize;
+}
+
+/* Returns a new SymTable_T object configured by iOptions and with
+   uBucketCount buckets, or NULL if insufficient memory is
+   available. */
+static SymTable_T SymTable_create(int iOptions, size_t uBucketCount) {
+   SymTable_T oSymTable;
+   int iStripe;
+
+   oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
+   if (oSymTable == NULL) return NULL;
+
+   oSymTable->hashTables[0] = calloc(uBucketCount,
+                                     sizeof(struct BucketNode*));
+   if (oSymTable->hashTables[0] == NULL) {
+      free(oSymTable);
+      return NULL;
+   }
+   oSymTable->hashTableSizes[0] = uBucketCount;
+   oSymTable->hashTables[1] = NULL;
+   oSymTable->hashTableSizes[1] = 0;
+   oSymTable->iTable = 0;
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
+   oSymTable->uResizes = 0;
+   oSymTable->uFailedResizes = 0;
+
+   if (pthread_mutex_init(&oSymTable->resizeLock, NULL) != 0) {
+      free(oSymTable->hashTables[0]);
+      free(oSymTable);
+      return NULL;
+   }
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++) {
+      if (pthread_rwlock_init(&oSymTable->stripes[iStripe].lock,
+                              NULL) != 0) {
+         while (iStripe > 0)
+            pthread_rwlock_destroy(&oSymTable->stripes[--iStripe].lock);
+         pthread_mutex_destroy(&oSymTable->resizeLock);
+         free(oSymTable->hashTables[0]);
+         free(oSymTable);
+         return NULL;
+      }
+      oSymTable->stripes[iStripe].iTable = 0;
+      oSymTable->stripes[iStripe].nodeCount = 0;
+      oSymTable->stripes[iStripe].uVersion = 0;
+      oSymTable->stripes[iStripe].uHits = 0;
+      oSymTable->stripes[iStripe].uHitProbes = 0;
+      oSymTable->stripes[iStripe].uMisses = 0;
+      oSymTable->stripes[iStripe].uMissProbes = 0;
+   }
+   return oSymTable;
+}
+
+SymTable_T SymTable_new(void) {
+   return SymTable_create(0, INITIAL_BUCKET_COUNT);
+}
+
+/* The Arena of SYMTABLE_ARENA is not safe to share between threads,
+   so this implementation supports only SYMTABLE_BORROWED_KEYS. */
+SymTable_T SymTable_newWithOptions(int iOptions) {
+   return SymTable_create(iOptions, INITIAL_BUCKET_COUNT);
+}
+
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   size_t uSize;
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return NULL;
+   return SymTable_create(0, uSize);
+}
+
+/* Returns a new BucketNode holding a copy of the uLength characters
+   at pcKey followed by '\0', or pcKey itself if oSymTable borrows
+   keys, or NULL if insufficient memory is available. Short keys are
+   copied into the node itself. The caller fills in the node's other
+   fields but uLength. */
+static struct BucketNode *SymTable_newNode(SymTable_T oSymTable,
+                                           const char *pcKey,
+                                           size_t uLength) {
+   struct BucketNode *psNewNode;
+   char *pcTempKey;
+
+   psNewNode = (struct BucketNode*)malloc(sizeof(struct BucketNode));
+   if (psNewNode == NULL)
+      return NULL;
+   psNewNode->uLength = uLength;
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      psNewNode->pcKey = pcKey;
+      return psNewNode;
+   }
+
+   if (uLength < SHORT_KEY_SIZE) {
+      memcpy(psNewNode->acShortKey, pcKey, uLength);
+      psNewNode->acShortKey[uLength] = '\0';
+      psNewNode->pcKey = psNewNode->acShortKey;
+      return psNewNode;
+   }
+
+   pcTempKey = malloc(uLength + 1);
+   if (pcTempKey == NULL) {
+      free(psNewNode);
+      return NULL;
+   }
+   memcpy(pcTempKey, pcKey, uLength);
+   pcTempKey[uLength] = '\0';
+
+   psNewNode->pcKey = pcTempKey;
+   return psNewNode;
+}
+
+/* Frees psNode, which came from SymTable_newNode on oSymTable, along
+   with its key. */
+static void SymTable_freeNode(SymTable_T oSymTable,
+                              struct BucketNode *psNode) {
+   if (psNode->pcKey != psNode->acShortKey && !oSymTable->iBorrowedKeys)
+      free((char*)psNode->pcKey);
+   free(psNode);
+}
+
+/* Returns the Stripe of oSymTable that guards the binding whose key
+   has full hash uHash. */
+static struct Stripe *SymTable_stripe(SymTable_T oSymTable, size_t uHash) {
+   return &oSymTable->stripes[uHash & (STRIPE_COUNT - 1)];
+}
+
+/* Returns the address of the bucket of oSymTable that holds, or
+   would hold, the binding whose key has full hash uHash. The caller
+   holds the lock of psStripe, the binding's Stripe. */
+static struct BucketNode **SymTable_bucket(SymTable_T oSymTable,
+                                           struct Stripe *psStripe,
+                                           size_t uHash) {
+   int iTable = psStripe->iTable;
+
+   return &oSymTable->hashTables[iTable]
+      [uHash & (oSymTable->hashTableSizes[iTable] - 1)];
+}
+
+/* Returns the address of the link in bucket, a bucket of psStripe,
+   that points to the BucketNode whose key is the uLength characters
+   at pcKey and whose full hash is uHash, or NULL if bucket holds no
+   such BucketNode. The characters are compared only once the hashes
+   and lengths match. */
+static struct BucketNode **SymTable_findLink(struct Stripe *psStripe,
+                                             struct BucketNode **bucket,
+                                             const char *pcKey,
+                                             size_t uLength,
+                                             size_t uHash) {
+   struct BucketNode **link;
+   size_t uProbes = 0;
+
+   for (link = bucket; *link != NULL; link = &(*link)->psNextNode) {
+      uProbes++;
+      if ((*link)->uHash == uHash && (*link)->uLength == uLength &&
+          ((*link)->pcKey == pcKey ||
+           memcmp((*link)->pcKey, pcKey, uLength) == 0)) {
+         SymTable_countLookup(psStripe, 1, uProbes);
+         return link;
+      }
+   }
+   SymTable_countLookup(psStripe, 0, uProbes);
+   return NULL;
+}
+
+/* Resizes oSymTable's hash table to newSize buckets, which may be
+   more or fewer than it has now but no fewer than STRIPE_COUNT. The
+   stripes move into the new hash table one at a time, each under its
+   own write lock, so no lookup waits for more than one stripe's
+   worth of moving. The caller holds resizeLock. Returns 1 (TRUE) if
+   successful, or 0 (FALSE) if newSize is the current size or if
+   insufficient memory is available, in which case oSymTable is left
+   unchanged. */
+static int SymTable_resize(SymTable_T oSymTable, size_t newSize) {
+   struct BucketNode **oldTable;
+   struct BucketNode **table;
+   struct BucketNode *psCurrentNode;
+   struct BucketNode *psNextNode;
+   struct Stripe *psStripe;
+   size_t oldSize;
+   size_t hash;
+   size_t hashNew;
+   int iOld = oSymTable->iTable;
+   int iNew = 1 - iOld;
+   int iStripe;
+
+   oldTable = oSymTable->hashTables[iOld];
+   oldSize = oSymTable->hashTableSizes[iOld];
+   if (newSize == oldSize) return 0;
+
+   table = calloc(newSize, sizeof(struct BucketNode*));
+   if (table == NULL) {
+      oSymTable->uFailedResizes++;
+      return 0;
+   }
+
+   /* No Stripe looks at the new hash table before taking the lock
+      that the move below releases, so these stores are seen first */
+   oSymTable->hashTables[iNew] = table;
+   oSymTable->hashTableSizes[iNew] = newSize;
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++) {
+      psStripe = &oSymTable->stripes[iStripe];
+      pthread_rwlock_wrlock(&psStripe->lock);
+      for (hash = (size_t)iStripe; hash < oldSize; hash += STRIPE_COUNT) {
+         for (psCurrentNode = oldTable[hash]; psCurrentNode != NULL;
+              psCurrentNode = psNextNode) {
+            psNextNode = psCurrentNode->psNextNode;
+
+            hashNew = psCurrentNode->uHash & (newSize - 1);
+
+            psCurrentNode->psNextNode = table[hashNew];
+            table[hashNew] = psCurrentNode;
+         }
+      }
+      psStripe->iTable = iNew;
+      psStripe->uVersion++;
+      pthread_rwlock_unlock(&psStripe->lock);
+   }
+
+   /* Every Stripe has left the old hash table, and any thread that
+      takes a Stripe's lock from now on sees that */
+   free(oldTable);
+   oSymTable->hashTables[iOld] = NULL;
+   oSymTable->hashTableSizes[iOld] = 0;
+   oSymTable->iTable = iNew;
+   oSymTable->uResizes++;
+   return 1;
+}
+
+/* Doubles oSymTable's hash table if it still has uSize buckets, the
+   size that a put found too small. Returns at once if another thread
+   is resizing, since that thread grows the hash table anyway. */
+static void SymTable_expand(SymTable_T oSymTable, size_t uSize) {
+   if (pthread_mutex_trylock(&oSymTable->resizeLock) != 0) return;
+
+   if (oSymTable->hashTableSizes[oSymTable->iTable] == uSize)
+      (void)SymTable_resize(oSymTable, SymTable_nextSize(uSize));
+
+   pthread_mutex_unlock(&oSymTable->resizeLock);
+}
+
+/* Frees every BucketNode in the uSize buckets of table, the hash table
+   of oSymTable, along with the nodes' keys. */
+static void SymTable_freeBuckets(SymTable_T oSymTable,
+                                 struct BucketNode **table, size_t uSize) {
+   struct BucketNode *psCurrentNode;
+   struct BucketNode *psNextNode;
+   size_t hash;
+
+   for(hash = 0; hash < uSize; hash++) {
+      for (psCurrentNode = table[hash];
+           psCurrentNode != NULL;
+           psCurrentNode = psNextNode) {
+         psNextNode = psCurrentNode->psNextNode;
+         SymTable_freeNode(oSymTable, psCurrentNode);
+      }
+   }
+}
+
+/* No other thread may be using oSymTable. */
+void SymTable_free(SymTable_T oSymTable) {
+   int iStripe;
+
+   assert(oSymTable != NULL);
+
+   SymTable_freeBuckets(oSymTable,
+                        oSymTable->hashTables[oSymTable->iTable],
+                        oSymTable->hashTableSizes[oSymTable->iTable]);
+   free(oSymTable->hashTables[oSymTable->iTable]);
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++)
+      pthread_rwlock_destroy(&oSymTable->stripes[iStripe].lock);
+   pthread_mutex_destroy(&oSymTable->resizeLock);
+   free(oSymTable);
+}
+
+/* While other threads put and remove bindings, the result is the
+   number of bindings at some moment during the call. */
+size_t SymTable_getLength(SymTable_T oSymTable) {
+   struct Stripe *psStripe;
+   size_t uLength = 0;
+   int iStripe;
+
+   assert(oSymTable != NULL);
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++) {
+      psStripe = &oSymTable->stripes[iStripe];
+      pthread_rwlock_rdlock(&psStripe->lock);
+      uLength += psStripe->nodeCount;
+      pthread_rwlock_unlock(&psStripe->lock);
+   }
+   return uLength;
+}
+
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   size_t uSize;
+   int iSuccessful = 1;
+
+   assert(oSymTable != NULL);
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return 0;
+
+   pthread_mutex_lock(&oSymTable->resizeLock);
+   if (uSize > oSymTable->hashTableSizes[oSymTable->iTable])
+      iSuccessful = SymTable_resize(oSymTable, uSize);
+   pthread_mutex_unlock(&oSymTable->resizeLock);
+   return iSuccessful;
+}
+
+void SymTable_compact(SymTable_T oSymTable) {
+   size_t uSize;
+
+   assert(oSymTable != NULL);
+
+   pthread_mutex_lock(&oSymTable->resizeLock);
+   uSize = SymTable_sizeFor(2 * SymTable_getLength(oSymTable));
+   if (uSize != 0 && uSize < oSymTable->hashTableSizes[oSymTable->iTable])
+      (void)SymTable_resize(oSymTable, uSize);
+   pthread_mutex_unlock(&oSymTable->resizeLock);
+}
+
+/* Adds one chain of uLength bindings to the histogram of *psStats. */
+static void SymTable_countChain(struct SymTableStats *psStats,
+                                size_t uLength) {
+   if (uLength > psStats->uMaxChain)
+      psStats->uMaxChain = uLength;
+   if (uLength >= SYMTABLE_HISTOGRAM_SIZE)
+      uLength = SYMTABLE_HISTOGRAM_SIZE - 1;
+   psStats->auChains[uLength]++;
+}
+
+/* Holds resizeLock throughout, so that every stripe is in the same
+   hash table, and looks at one stripe at a time under its read lock.
+   While other threads put and remove bindings, the result mixes
+   moments during the call, as SymTable_getLength does. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct BucketNode **table;
+   struct BucketNode *psNode;
+   struct Stripe *psStripe;
+   size_t uSize;
+   size_t uLength;
+   size_t hash;
+   int iStripe;
+
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+
+   pthread_mutex_lock(&oSymTable->resizeLock);
+   table = oSymTable->hashTables[oSymTable->iTable];
+   uSize = oSymTable->hashTableSizes[oSymTable->iTable];
+   psStats->uBuckets = uSize;
+   psStats->uBytes = sizeof(struct SymTable)
+      + uSize * sizeof(struct BucketNode*);
+   psStats->uResizes = oSymTable->uResizes;
+   psStats->uFailedResizes = oSymTable->uFailedResizes;
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++) {
+      psStripe = &oSymTable->stripes[iStripe];
+      pthread_rwlock_rdlock(&psStripe->lock);
+      psStats->uBindings += psStripe->nodeCount;
+      for (hash = (size_t)iStripe; hash < uSize; hash += STRIPE_COUNT) {
+         uLength = 0;
+         for (psNode = table[hash]; psNode != NULL;
+              psNode = psNode->psNextNode) {
+            uLength++;
+            psStats->uBytes += sizeof(struct BucketNode);
+            if (psNode->pcKey != psNode->acShortKey &&
+                !oSymTable->iBorrowedKeys)
+               psStats->uBytes += psNode->uLength + 1;
+         }
+         SymTable_countChain(psStats, uLength);
+      }
+      psStats->uHits += __atomic_load_n(&psStripe->uHits,
+                                        __ATOMIC_RELAXED);
+      psStats->uHitProbes += __atomic_load_n(&psStripe->uHitProbes,
+                                             __ATOMIC_RELAXED);
+      psStats->uMisses += __atomic_load_n(&psStripe->uMisses,
+                                          __ATOMIC_RELAXED);
+      psStats->uMissProbes += __atomic_load_n(&psStripe->uMissProbes,
+                                              __ATOMIC_RELAXED);
+      pthread_rwlock_unlock(&psStripe->lock);
+   }
+   pthread_mutex_unlock(&oSymTable->resizeLock);
+
+   psStats->dLoadFactor = (double)psStats->uBindings / (double)uSize;
+}
+
+int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+/* Looks up the binding of oSymTable whose key is the uLength
+   characters at pcKey under its stripe's write lock, adding the
+   binding of those characters to pvValue if there is none, and then,
+   unless pfUpdate is NULL, replaces the binding's value with what
+   (*pfUpdate) returns given pcKey, the value and pvExtra, still under
+   the lock. Returns 1 (TRUE) if successful, or 0 (FALSE) if
+   insufficient memory is available to add the binding, and sets
+   *piInserted to 1 (TRUE) if the binding was added or to 0 (FALSE)
+   otherwise. */
+static int SymTable_findOrAdd(SymTable_T oSymTable, const char *pcKey,
+                              size_t uLength, const void *pvValue,
+                              void *(*pfUpdate)(const char *pcKey,
+                                                void *pvValue,
+                                                void *pvExtra),
+                              const void *pvExtra, int *piInserted) {
+   struct BucketNode *psNewNode;
+   struct BucketNode **bucket;
+   struct BucketNode **link;
+   struct Stripe *psStripe;
+   size_t uHash;
+   size_t uSize;
+   int iGrow;
+
+   *piInserted = 0;
+   uHash = SymTable_hash(pcKey, uLength);
+   psStripe = SymTable_stripe(oSymTable, uHash);
+
+   pthread_rwlock_wrlock(&psStripe->lock);
+   bucket = SymTable_bucket(oSymTable, psStripe, uHash);
+   link = SymTable_findLink(psStripe, bucket, pcKey, uLength, uHash);
+   if (link != NULL) {
+      if (pfUpdate != NULL)
+         (*link)->pvValue = (*pfUpdate)(pcKey, (void*)(*link)->pvValue,
+                                        (void*)pvExtra);
+      pthread_rwlock_unlock(&psStripe->lock);
+      return 1;
+   }
+
+   /* Allocate data to new node, make sure there is enough space */
+   psNewNode = SymTable_newNode(oSymTable, pcKey, uLength);
+   if (psNewNode == NULL) {
+      pthread_rwlock_unlock(&psStripe->lock);
+      return 0;
+   }
+
+   psNewNode->pvValue = pvValue;
+   if (pfUpdate != NULL)
+      psNewNode->pvValue = (*pfUpdate)(pcKey, (void*)pvValue,
+                                       (void*)pvExtra);
+   psNewNode->uHash = uHash;
+
+   /* insert the new binding into the symbol table */
+   psNewNode->psNextNode = *bucket;
+   *bucket = psNewNode;
+   psStripe->nodeCount++;
+   psStripe->uVersion++;
+
+   /* Keys spread evenly over the stripes, so a stripe holding more
+      bindings than buckets stands for the whole table */
+   uSize = oSymTable->hashTableSizes[psStripe->iTable];
+   iGrow = psStripe->nodeCount >= uSize / STRIPE_COUNT;
+   pthread_rwlock_unlock(&psStripe->lock);
+
+   /* The resize takes every stripe's lock in turn, so it must come
+      after this one is released. It relinks nodes but never moves
+      them. */
+   if (iGrow)
+      SymTable_expand(oSymTable, uSize);
+
+   *piInserted = 1;
+   return 1;
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)SymTable_findOrAdd(oSymTable, pcKey, uLength, pvValue, NULL,
+                            NULL, &iInserted);
+   return iInserted;
+}
+
+/* Another thread could look the binding up while the caller stores
+   through the address, so no address is handed out. */
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)oSymTable;
+   (void)pcKey;
+   (void)pvDefault;
+   if (piInserted != NULL) *piInserted = 0;
+   return NULL;
+}
+
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   int iInserted;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   iSuccessful = SymTable_findOrAdd(oSymTable, pcKey, strlen(pcKey),
+                                    pvDefault, pfUpdate, pvExtra,
+                                    &iInserted);
+   if (piInserted != NULL) *piInserted = iInserted;
+   return iSuccessful;
+}
+
+/* The bindings are put one at a time, each taking its own stripe's
+   lock, so that other threads are not held up for the whole batch. */
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   /* Grow once for the whole batch if there is memory for it */
+   if (uCount <= (size_t)-1 - SymTable_getLength(oSymTable))
+      (void)SymTable_reserve(oSymTable,
+                             SymTable_getLength(oSymTable) + uCount);
+
+   for (u = 0; u < uCount; u++) {
+      iSuccessful = SymTable_put(oSymTable, apcKeys[u], apvValues[u]);
+      if (aiResults != NULL) aiResults[u] = iSuccessful;
+      if (iSuccessful) uAdded++;
+   }
+   return uAdded;
+}
+
+void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   struct BucketNode **link;
+   struct Stripe *psStripe;
+   const void *tempValue = NULL;
+   size_t uHash;
+   size_t uLength;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uLength = strlen(pcKey);
+   uHash = SymTable_hash(pcKey, uLength);
+   psStripe = SymTable_stripe(oSymTable, uHash);
+
+   pthread_rwlock_wrlock(&psStripe->lock);
+   link = SymTable_findLink(psStripe,
+                            SymTable_bucket(oSymTable, psStripe, uHash),
+                            pcKey, uLength, uHash);
+   if (link != NULL) {
+      tempValue = (*link)->pvValue;
+      (*link)->pvValue = pvValue;
+   }
+   pthread_rwlock_unlock(&psStripe->lock);
+   return (void *) tempValue;
+}
+
+/* Looks up the binding of oSymTable whose key is the uLength
+   characters at pcKey under its stripe's read lock. Returns 1 (TRUE)
+   and sets *ppvValue to the binding's value if there is such a
+   binding, and returns 0 (FALSE) otherwise. */
+static int SymTable_lookup(SymTable_T oSymTable, const char *pcKey,
+                           size_t uLength, void **ppvValue) {
+   struct BucketNode **link;
+   struct Stripe *psStripe;
+   size_t uHash;
+
+   uHash = SymTable_hash(pcKey, uLength);
+   psStripe = SymTable_stripe(oSymTable, uHash);
+
+   pthread_rwlock_rdlock(&psStripe->lock);
+   link = SymTable_findLink(psStripe,
+                            SymTable_bucket(oSymTable, psStripe, uHash),
+                            pcKey, uLength, uHash);
+   if (link != NULL) *ppvValue = (void*)(*link)->pvValue;
+   pthread_rwlock_unlock(&psStripe->lock);
+   return link != NULL;
+}
+
+int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_containsN(oSymTable, pcKey, strlen(pcKey));
+}
+
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   void *pvValue;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_lookup(oSymTable, pcKey, uLength, &pvValue);
+}
+
+void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
+   void *pvValue = NULL;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)SymTable_lookup(oSymTable, pcKey, uLength, &pvValue);
+   return pvValue;
+}
+
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   size_t u;
+   size_t uFound = 0;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (u = 0; u < uCount; u++) {
+      assert(apcKeys[u] != NULL);
+      apvValues[u] = NULL;
+      if (SymTable_lookup(oSymTable, apcKeys[u], strlen(apcKeys[u]),
+                          &apvValues[u]))
+         uFound++;
+   }
+   return uFound;
+}
+
+void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct BucketNode *psNode = NULL;
+   struct BucketNode **link;
+   struct Stripe *psStripe;
+   const void *tempValue = NULL;
+   size_t uHash;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uHash = SymTable_hash(pcKey, uLength);
+   psStripe = SymTable_stripe(oSymTable, uHash);
+
+   pthread_rwlock_wrlock(&psStripe->lock);
+   link = SymTable_findLink(psStripe,
+                            SymTable_bucket(oSymTable, psStripe, uHash),
+                            pcKey, uLength, uHash);
+   if (link != NULL) {
+      psNode = *link;
+      *link = psNode->psNextNode;
+      tempValue = psNode->pvValue;
+      psStripe->nodeCount--;
+      psStripe->uVersion++;
+   }
+   pthread_rwlock_unlock(&psStripe->lock);
+
+   /* Free outside the lock; no other thread can reach psNode now */
+   if (psNode != NULL) SymTable_freeNode(oSymTable, psNode);
+   return (void *) tempValue;
+}
+
+/* Visits one stripe at a time under its read lock, so pfApply must
+   not put, replace or remove bindings of oSymTable. Bindings that
+   other threads put or remove meanwhile may or may not be visited. */
+void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra) {
+   struct BucketNode **table;
+   struct BucketNode *tempNode_current;
+   struct Stripe *psStripe;
+   size_t uSize;
+   size_t hash;
+   int iStripe;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+
+   for (iStripe = 0; iStripe < STRIPE_COUNT; iStripe++) {
+      psStripe = &oSymTable->stripes[iStripe];
+      pthread_rwlock_rdlock(&psStripe->lock);
+      table = oSymTable->hashTables[psStripe->iTable];
+      uSize = oSymTable->hashTableSizes[psStripe->iTable];
+      for (hash = (size_t)iStripe; hash < uSize; hash += STRIPE_COUNT) {
+         for (tempNode_current = table[hash];
+              tempNode_current != NULL;
+              tempNode_current = tempNode_current->psNextNode) {
+            (*pfApply)(tempNode_current->pcKey, (void*)tempNode_current->pvValue, (void*)pvExtra);
+         }
+      }
+      pthread_rwlock_unlock(&psStripe->lock);
+   }
+}
+
+/* What each thread of SymTable_mapParallel needs. */
+struct MapWork
+{
+   SymTable_T oSymTable;
+   void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra);
+   void *pvExtra;
+};
+
+/* Applies the MapWork at pvWork to the buckets of stripes uFirst to
+   uLimit - 1, holding each stripe's lock for reading in turn. */
+static void SymTable_mapChunk(size_t uFirst, size_t uLimit,
+                              void *pvWork) {
+   struct MapWork *psWork = (struct MapWork*)pvWork;
+   struct BucketNode **table;
+   struct BucketNode *tempNode_current;
+   struct Stripe *psStripe;
+   size_t uSize;
+   size_t hash;
+   size_t uStripe;
+
+   for (uStripe = uFirst; uStripe < uLimit; uStripe++) {
+      psStripe = &psWork->oSymTable->stripes[uStripe];
+      pthread_rwlock_rdlock(&psStripe->lock);
+      table = psWork->oSymTable->hashTables[psStripe->iTable];
+      uSize = psWork->oSymTable->hashTableSizes[psStripe->iTable];
+      for (hash = uStripe; hash < uSize; hash += STRIPE_COUNT) {
+         for (tempNode_current = table[hash];
+              tempNode_current != NULL;
+              tempNode_current = tempNode_current->psNextNode) {
+            (*psWork->pfApply)(tempNode_current->pcKey,
+                               (void*)tempNode_current->pvValue,
+                               psWork->pvExtra);
+         }
+      }
+      pthread_rwlock_unlock(&psStripe->lock);
+   }
+}
+
+/* The threads take the table a stripe at a time, so no more than
+   STRIPE_COUNT of them share it. Like SymTable_map, it sees each
+   stripe as it is when its turn comes. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   struct MapWork sWork;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+   assert(iThreads > 0);
+
+   sWork.oSymTable = oSymTable;
+   sWork.pfApply = pfApply;
+   sWork.pvExtra = (void*)pvExtra;
+   Parallel_run(STRIPE_COUNT, 1, SymTable_mapChunk, &sWork, iThreads);
+}
+
+size_t SymTable_mapWorker(void) {
+   return Parallel_worker();
+}
+
+/* An iterator holds no lock between calls, so each call takes one;
+   SymTable_map, which takes one per stripe, is cheaper for visiting
+   every binding. uOuterIndex is the stripe
+   it is in, uIndex the next of that stripe's buckets to look in, and
+   pvPosition the BucketNode it is at, or NULL if it has yet to enter
+   the stripe. uVersion is the stripe's version when it entered, so
+   the iterator goes stale only if the stripe it is in changes; other
+   threads may change the rest of the SymTable freely, and bindings
+   put into stripes it has not reached may or may not be visited, as
+   with SymTable_map. A key from SymTable_iterKey is freed if another
+   thread removes its binding. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = NULL;
+   psIter->uIndex = 0;
+   psIter->uOuterIndex = 0;
+   psIter->uVersion = 0;
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   SymTable_T oSymTable;
+   struct BucketNode **table;
+   const struct BucketNode *psNode;
+   struct Stripe *psStripe;
+   size_t uSize;
+
+   assert(psIter != NULL);
+
+   if (psIter->iStale) return 0;
+
+   oSymTable = psIter->oSymTable;
+   while (psIter->uOuterIndex < STRIPE_COUNT) {
+      psStripe = &oSymTable->stripes[psIter->uOuterIndex];
+      pthread_rwlock_rdlock(&psStripe->lock);
+
+      if (psIter->pvPosition == NULL)
+         psIter->uVersion = psStripe->uVersion;
+      else if (psIter->uVersion != psStripe->uVersion) {
+         pthread_rwlock_unlock(&psStripe->lock);
+         psIter->iStale = 1;
+         return 0;
+      }
+
+      table = oSymTable->hashTables[psStripe->iTable];
+      uSize = oSymTable->hashTableSizes[psStripe->iTable];
+      psNode = NULL;
+      if (psIter->pvPosition != NULL)
+         psNode = ((const struct BucketNode*)psIter->pvPosition)
+            ->psNextNode;
+      while (psNode == NULL && psIter->uIndex < uSize) {
+         psNode = table[psIter->uIndex];
+         psIter->uIndex += STRIPE_COUNT;
+      }
+
+      if (psNode != NULL) {
+         psIter->pvPosition = psNode;
+         psIter->pcKey = psNode->pcKey;
+         psIter->pvValue = (void*)psNode->pvValue;
+         pthread_rwlock_unlock(&psStripe->lock);
+         return 1;
+      }
+      pthread_rwlock_unlock(&psStripe->lock);
+
+      psIter->uOuterIndex++;
+      psIter->uIndex = psIter->uOuterIndex;
+      psIter->pvPosition = NULL;
+   }
+   return 0;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
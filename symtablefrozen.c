@@ -0,0 +1,761 @@
+/* Module defining read-only symbol tables placed by a minimal perfect
+   hash, built by hashing keys into buckets and searching each bucket
+   for a displacement that sends all of its keys to free positions, as
+   in CHD (compress, hash, displace). Where keyhash.h mixes 64-bit
+   words, hashes are reduced by multiplying and shifting instead of
+   dividing, which needs fewer than 2^32 bindings, as SymTable_freeze
+   checks. */
+
+/* For mmap */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "symtablefrozen.h"
+#include "keyhash.h"
+
+/* The average number of keys per bucket. Larger buckets mean fewer
+   displacements to store but a longer search to place them. */
+enum {BUCKET_LOAD = 4};
+
+/* The number of seeds SymTable_freeze tries before giving up. Only
+   keys whose full hashes collide defeat every seed. */
+enum {MAX_SEEDS = 16};
+
+/* SymTable_freeze tries up to this many displacements per binding
+   for one bucket before trying another seed. Placing the last binding
+   takes about as many tries as there are bindings. */
+enum {TRIES_PER_BINDING = 64};
+
+/* The most bindings SymTable_freeze can place. SymTableFrozen_reduce
+   scales 32 bits of a hash, so it reaches only 2^32 positions. */
+static const size_t MAX_BINDINGS = (size_t)0xFFFFFFFFUL;
+
+/* Spreads successive seeds and displacements over every bit of a
+   size_t. */
+#if KEYHASH_WORD_BITS == 64
+static const size_t SEED_STEP = (size_t)0x9E3779B97F4A7C15UL;
+#else
+static const size_t SEED_STEP = (size_t)0x9E3779B9UL;
+#endif
+
+/* Identifies a file written by SymTableFrozen_write, and the version
+   of its layout. */
+static const char FILE_MAGIC[8] = "SYMFRZ1";
+
+/* SymTableFrozen_write writes to the file name with this appended,
+   then renames the result. */
+static const char TEMP_SUFFIX[] = ".tmp";
+
+/* A file written by SymTableFrozen_write starts with a FileHeader.
+   The displacements follow, padded to a multiple of sizeof(size_t),
+   then the entries, then the keys. Every part is located by size
+   alone, so the file works wherever it is mapped. */
+struct FileHeader
+{
+   /* FILE_MAGIC. */
+   char acMagic[8];
+
+   /* The writer's sizeof(size_t) and KEYHASH_POLICY, which the reader
+      must share. */
+   size_t uWordSize;
+   size_t uHashPolicy;
+
+   /* The fields of the SymTableFrozen that was written. */
+   size_t uLength;
+   size_t uBucketCount;
+   size_t uSeed;
+   size_t uEntrySize;
+
+   /* The number of characters in the keys, NULs included. */
+   size_t uKeysSize;
+};
+
+/* A SymTableFrozen holds its keys end to end in one block, and an
+   entry for each binding at the position that the key's bucket and
+   its bucket's displacement give. An entry is the size_t offset of
+   the binding's key within the block, followed by the binding's
+   payload: its value if the SymTableFrozen was made by
+   SymTable_freeze, or the bytes written for its value if it was
+   mapped from a file. One more entry after the last holds only the
+   size of the block, so that every key's length is the next entry's
+   offset less its own, less one for the NUL. */
+struct SymTableFrozen
+{
+   /* The number of bindings. */
+   size_t uLength;
+
+   /* The number of buckets. */
+   size_t uBucketCount;
+
+   /* The seed mixed into every key's hash. */
+   size_t uSeed;
+
+   /* The displacement of each bucket. */
+   unsigned int *auDisplacement;
+
+   /* The entries, uEntrySize bytes apart. */
+   char *pcEntries;
+
+   /* The number of bytes in an entry, a multiple of sizeof(size_t). */
+   size_t uEntrySize;
+
+   /* Every key, each followed by its NUL. */
+   char *pcKeys;
+
+   /* The number of characters in pcKeys, NULs included. Entries read
+      from a file are checked against it before their keys are. */
+   size_t uKeysSize;
+
+   /* The mapping of the file that the SymTableFrozen was opened from,
+      which holds all of the above arrays, or NULL if it was made by
+      SymTable_freeze. */
+   void *pvMapping;
+
+   /* The number of bytes in pvMapping. */
+   size_t uMappingSize;
+};
+
+/* Where the hashes of one key send it. */
+struct Place
+{
+   /* The key's bucket. */
+   size_t uBucket;
+
+   /* The hash that, combined with the displacement of the key's
+      bucket, gives the key's position. */
+   size_t uHash;
+};
+
+/* The bindings that SymTable_map hands to SymTable_freeze. */
+struct Collector
+{
+   const char **apcKeys;
+   void **apvValues;
+   size_t uCount;
+};
+
+#if KEYHASH_WORD_BITS == 64
+/* Returns u with every bit mixed into every other, one to one. */
+static size_t SymTableFrozen_mix(size_t u)
+{
+   u ^= u >> 30;
+   u *= (size_t)0xBF58476D1CE4E5B9UL;
+   u ^= u >> 27;
+   u *= (size_t)0x94D049BB133111EBUL;
+   u ^= u >> 31;
+   return u;
+}
+
+/* Returns the high 32 bits of u scaled down to a number in
+   [0, uRange). */
+static size_t SymTableFrozen_reduce(size_t u, size_t uRange)
+{
+   return ((u >> 32) * uRange) >> 32;
+}
+#else
+/* Returns u with every bit mixed into every other, one to one. */
+static size_t SymTableFrozen_mix(size_t u)
+{
+   u ^= u >> 16;
+   u *= (size_t)0x85EBCA6BUL;
+   u ^= u >> 13;
+   u *= (size_t)0xC2B2AE35UL;
+   u ^= u >> 16;
+   return u;
+}
+
+/* Returns u reduced to a number in [0, uRange). Scaling would need a
+   product wider than the words here, so this divides instead. */
+static size_t SymTableFrozen_reduce(size_t u, size_t uRange)
+{
+   return u % uRange;
+}
+#endif
+
+/* Sets *psPlace to where a key whose full hash is uHash goes in a
+   table of uBucketCount buckets, using seed uSeed. */
+static void SymTableFrozen_place(size_t uHash, size_t uSeed,
+                                 size_t uBucketCount,
+                                 struct Place *psPlace)
+{
+   size_t u;
+
+   u = SymTableFrozen_mix(uHash + uSeed);
+   psPlace->uBucket = SymTableFrozen_reduce(u, uBucketCount);
+   psPlace->uHash = u;
+}
+
+/* Returns the position of a key placed at *psPlace, in a table of
+   uLength bindings, given uDisplacementHash, the spread-out
+   displacement of its bucket. The displaced hash is mixed again
+   because the reduction looks only at some of its bits, which the
+   displacement alone would change the same way for every key. */
+static size_t SymTableFrozen_position(const struct Place *psPlace,
+                                      size_t uDisplacementHash,
+                                      size_t uLength)
+{
+   return SymTableFrozen_reduce(
+      SymTableFrozen_mix(psPlace->uHash ^ uDisplacementHash), uLength);
+}
+
+/* Returns displacement uDisplacement spread over every bit of a
+   size_t. */
+static size_t SymTableFrozen_displace(unsigned int uDisplacement)
+{
+   return (size_t)uDisplacement * SEED_STEP;
+}
+
+/* Returns the address of entry uPosition of oFrozen. */
+static char *SymTableFrozen_entry(SymTableFrozen_T oFrozen,
+                                  size_t uPosition)
+{
+   return oFrozen->pcEntries + uPosition * oFrozen->uEntrySize;
+}
+
+/* Returns the offset of the key of entry uPosition of oFrozen. */
+static size_t SymTableFrozen_keyOffset(SymTableFrozen_T oFrozen,
+                                       size_t uPosition)
+{
+   return *(size_t*)SymTableFrozen_entry(oFrozen, uPosition);
+}
+
+/* Returns the key of the binding at uPosition of oFrozen, and sets
+   *puKeyLength to its length, or returns NULL if the offsets of the
+   entry and the next do not bound a key within oFrozen's keys, as in
+   a damaged file. */
+static const char *SymTableFrozen_key(SymTableFrozen_T oFrozen,
+                                      size_t uPosition,
+                                      size_t *puKeyLength)
+{
+   size_t uKeyOffset;
+   size_t uNextOffset;
+
+   uKeyOffset = SymTableFrozen_keyOffset(oFrozen, uPosition);
+   uNextOffset = SymTableFrozen_keyOffset(oFrozen, uPosition + 1);
+   if (uKeyOffset >= uNextOffset || uNextOffset > oFrozen->uKeysSize)
+      return NULL;
+   *puKeyLength = uNextOffset - uKeyOffset - 1;
+   return oFrozen->pcKeys + uKeyOffset;
+}
+
+/* Returns the value of the binding at uPosition of oFrozen: the value
+   stored in its payload, or for a mapped file the payload's
+   address. */
+static void *SymTableFrozen_value(SymTableFrozen_T oFrozen,
+                                  size_t uPosition)
+{
+   char *pcPayload;
+
+   pcPayload = SymTableFrozen_entry(oFrozen, uPosition) + sizeof(size_t);
+   if (oFrozen->pvMapping != NULL) return pcPayload;
+   return *(void**)pcPayload;
+}
+
+/* Records binding pcKey-pvValue in the Collector pvCollector. */
+static void SymTableFrozen_collect(const char *pcKey, void *pvValue,
+                                   void *pvCollector)
+{
+   struct Collector *psCollector = (struct Collector*)pvCollector;
+
+   psCollector->apcKeys[psCollector->uCount] = pcKey;
+   psCollector->apvValues[psCollector->uCount] = pvValue;
+   psCollector->uCount++;
+}
+
+/* Places uLength keys, whose full hashes are auHash, into oFrozen's
+   positions using seed uSeed, setting oFrozen's displacements and
+   setting auKeyAt[p] to the index of the key at position p. Buckets
+   are placed largest first, while most positions are still free.
+   aPlaces, auBucketStart, auBucketKeys, auOrder and auPositions are
+   scratch arrays of uLength, uBucketCount + 1, uLength, uBucketCount
+   and uLength + 1 elements. Returns 1 (TRUE) if successful, or 0
+   (FALSE) if some bucket fits under no displacement. */
+static int SymTableFrozen_assign(SymTableFrozen_T oFrozen,
+                                 const size_t auHash[], size_t uSeed,
+                                 size_t auKeyAt[],
+                                 struct Place aPlaces[],
+                                 size_t auBucketStart[],
+                                 size_t auBucketKeys[],
+                                 size_t auOrder[],
+                                 size_t auPositions[])
+{
+   size_t uLength = oFrozen->uLength;
+   size_t uBucketCount = oFrozen->uBucketCount;
+   size_t uMaxTries;
+   size_t uDisplacementHash;
+   size_t uBucket;
+   size_t uSize;
+   size_t uMaxSize = 0;
+   size_t u;
+   size_t i;
+   size_t j;
+   unsigned int uDisplacement;
+   int iFits;
+
+   uMaxTries = (size_t)TRIES_PER_BINDING * uLength;
+   if (uMaxTries > (unsigned int)-1) uMaxTries = (unsigned int)-1;
+
+   /* Sort the keys by bucket */
+   for (u = 0; u <= uBucketCount; u++)
+      auBucketStart[u] = 0;
+   for (i = 0; i < uLength; i++) {
+      SymTableFrozen_place(auHash[i], uSeed, uBucketCount, &aPlaces[i]);
+      auBucketStart[aPlaces[i].uBucket + 1]++;
+   }
+   for (u = 0; u < uBucketCount; u++) {
+      if (auBucketStart[u + 1] > uMaxSize)
+         uMaxSize = auBucketStart[u + 1];
+      auBucketStart[u + 1] += auBucketStart[u];
+   }
+   for (i = 0; i < uLength; i++)
+      auBucketKeys[auBucketStart[aPlaces[i].uBucket]++] = i;
+   for (u = uBucketCount; u > 0; u--)
+      auBucketStart[u] = auBucketStart[u - 1];
+   auBucketStart[0] = 0;
+
+   /* Sort the buckets by size, largest first, counting the buckets of
+      each size in auPositions */
+   for (u = 0; u <= uMaxSize; u++)
+      auPositions[u] = 0;
+   for (u = 0; u < uBucketCount; u++)
+      auPositions[uMaxSize - (auBucketStart[u + 1] - auBucketStart[u])]++;
+   for (u = 1; u <= uMaxSize; u++)
+      auPositions[u] += auPositions[u - 1];
+   for (u = uBucketCount; u > 0; u--) {
+      uSize = auBucketStart[u] - auBucketStart[u - 1];
+      auOrder[--auPositions[uMaxSize - uSize]] = u - 1;
+   }
+
+   for (u = 0; u < uLength; u++)
+      auKeyAt[u] = uLength;
+
+   for (u = 0; u < uBucketCount; u++) {
+      uBucket = auOrder[u];
+      uSize = auBucketStart[uBucket + 1] - auBucketStart[uBucket];
+      oFrozen->auDisplacement[uBucket] = 0;
+      if (uSize == 0) continue;
+
+      iFits = 0;
+      for (uDisplacement = 0; uDisplacement < uMaxTries;
+           uDisplacement++) {
+         iFits = 1;
+         uDisplacementHash = SymTableFrozen_displace(uDisplacement);
+         for (i = 0; i < uSize && iFits; i++) {
+            auPositions[i] = SymTableFrozen_position(
+               &aPlaces[auBucketKeys[auBucketStart[uBucket] + i]],
+               uDisplacementHash, uLength);
+            if (auKeyAt[auPositions[i]] != uLength) iFits = 0;
+            for (j = 0; j < i && iFits; j++) {
+               if (auPositions[j] == auPositions[i]) iFits = 0;
+            }
+         }
+         if (iFits) break;
+      }
+      if (! iFits) return 0;
+
+      oFrozen->auDisplacement[uBucket] = uDisplacement;
+      for (i = 0; i < uSize; i++)
+         auKeyAt[auPositions[i]] = auBucketKeys[auBucketStart[uBucket] + i];
+   }
+   return 1;
+}
+
+/* Frees whatever parts of oFrozen have been allocated or mapped, and
+   oFrozen. */
+static void SymTableFrozen_release(SymTableFrozen_T oFrozen)
+{
+   if (oFrozen->pvMapping != NULL)
+      munmap(oFrozen->pvMapping, oFrozen->uMappingSize);
+   else {
+      free(oFrozen->auDisplacement);
+      free(oFrozen->pcEntries);
+      free(oFrozen->pcKeys);
+   }
+   free(oFrozen);
+}
+
+SymTableFrozen_T SymTable_freeze(SymTable_T oSymTable)
+{
+   SymTableFrozen_T oFrozen;
+   struct Collector sCollector;
+   size_t *auHash;
+   size_t *auKeyAt;
+   struct Place *aPlaces;
+   size_t *auBucketStart;
+   size_t *auBucketKeys;
+   size_t *auOrder;
+   size_t *auPositions;
+   size_t uLength;
+   size_t uKeysSize = 0;
+   size_t uKeyLength;
+   size_t u;
+   char *pcEntry;
+   int iSeed;
+   int iPlaced = 0;
+
+   assert(oSymTable != NULL);
+
+   if (SymTable_getLength(oSymTable) > MAX_BINDINGS) return NULL;
+
+   oFrozen = (SymTableFrozen_T)calloc(1, sizeof(struct SymTableFrozen));
+   if (oFrozen == NULL) return NULL;
+
+   /* Every array gets at least one element, so that an empty table
+      needs no special cases */
+   uLength = SymTable_getLength(oSymTable);
+   oFrozen->uLength = uLength;
+   oFrozen->uBucketCount = uLength / BUCKET_LOAD + 1;
+
+   oFrozen->auDisplacement = (unsigned int*)malloc(
+      oFrozen->uBucketCount * sizeof(unsigned int));
+   oFrozen->uEntrySize = sizeof(size_t) + sizeof(void*);
+   oFrozen->pcEntries = (char*)malloc((uLength + 1) * oFrozen->uEntrySize);
+   sCollector.apcKeys = (const char**)malloc((uLength + 1)
+                                             * sizeof(const char*));
+   sCollector.apvValues = (void**)malloc((uLength + 1) * sizeof(void*));
+   sCollector.uCount = 0;
+   auHash = (size_t*)malloc((uLength + 1) * sizeof(size_t));
+   auKeyAt = (size_t*)malloc((uLength + 1) * sizeof(size_t));
+   aPlaces = (struct Place*)malloc((uLength + 1) * sizeof(struct Place));
+   auBucketStart = (size_t*)malloc((oFrozen->uBucketCount + 1)
+                                   * sizeof(size_t));
+   auBucketKeys = (size_t*)malloc((uLength + 1) * sizeof(size_t));
+   auOrder = (size_t*)malloc(oFrozen->uBucketCount * sizeof(size_t));
+   auPositions = (size_t*)malloc((uLength + 1) * sizeof(size_t));
+
+   if (oFrozen->auDisplacement != NULL && oFrozen->pcEntries != NULL
+       && sCollector.apcKeys != NULL
+       && sCollector.apvValues != NULL && auHash != NULL
+       && auKeyAt != NULL && aPlaces != NULL && auBucketStart != NULL
+       && auBucketKeys != NULL && auOrder != NULL
+       && auPositions != NULL) {
+      SymTable_map(oSymTable, SymTableFrozen_collect, &sCollector);
+      assert(sCollector.uCount == uLength);
+
+      for (u = 0; u < uLength; u++) {
+         uKeyLength = strlen(sCollector.apcKeys[u]);
+         auHash[u] = KeyHash_hash(sCollector.apcKeys[u], uKeyLength);
+         uKeysSize += uKeyLength + 1;
+      }
+
+      for (iSeed = 0; iSeed < MAX_SEEDS && ! iPlaced; iSeed++) {
+         oFrozen->uSeed = (size_t)iSeed * SEED_STEP;
+         iPlaced = SymTableFrozen_assign(oFrozen, auHash, oFrozen->uSeed,
+                                         auKeyAt, aPlaces, auBucketStart,
+                                         auBucketKeys, auOrder,
+                                         auPositions);
+      }
+
+      if (iPlaced) {
+         oFrozen->pcKeys = (char*)malloc(uKeysSize + 1);
+         oFrozen->uKeysSize = uKeysSize;
+      }
+   }
+
+   if (oFrozen->pcKeys != NULL) {
+      /* Lay the keys and values out in position order */
+      uKeysSize = 0;
+      for (u = 0; u <= uLength; u++) {
+         pcEntry = SymTableFrozen_entry(oFrozen, u);
+         *(size_t*)pcEntry = uKeysSize;
+         *(void**)(pcEntry + sizeof(size_t)) = NULL;
+         if (u == uLength) break;
+
+         uKeyLength = strlen(sCollector.apcKeys[auKeyAt[u]]);
+         memcpy(oFrozen->pcKeys + uKeysSize,
+                sCollector.apcKeys[auKeyAt[u]], uKeyLength + 1);
+         *(void**)(pcEntry + sizeof(size_t)) =
+            sCollector.apvValues[auKeyAt[u]];
+         uKeysSize += uKeyLength + 1;
+      }
+   }
+
+   free(sCollector.apcKeys);
+   free(sCollector.apvValues);
+   free(auHash);
+   free(auKeyAt);
+   free(aPlaces);
+   free(auBucketStart);
+   free(auBucketKeys);
+   free(auOrder);
+   free(auPositions);
+
+   if (oFrozen->pcKeys == NULL) {
+      SymTableFrozen_release(oFrozen);
+      return NULL;
+   }
+   return oFrozen;
+}
+
+void SymTableFrozen_free(SymTableFrozen_T oFrozen)
+{
+   assert(oFrozen != NULL);
+
+   SymTableFrozen_release(oFrozen);
+}
+
+size_t SymTableFrozen_getLength(SymTableFrozen_T oFrozen)
+{
+   assert(oFrozen != NULL);
+
+   return oFrozen->uLength;
+}
+
+/* Returns the position of the binding of oFrozen whose key is pcKey,
+   or oFrozen's length if no such binding exists. */
+static size_t SymTableFrozen_find(SymTableFrozen_T oFrozen,
+                                  const char *pcKey)
+{
+   struct Place sPlace;
+   const char *pcFoundKey;
+   size_t uKeyLength;
+   size_t uFoundLength;
+   size_t uPosition;
+
+   if (oFrozen->uLength == 0) return 0;
+
+   uKeyLength = strlen(pcKey);
+   SymTableFrozen_place(KeyHash_hash(pcKey, uKeyLength), oFrozen->uSeed,
+                        oFrozen->uBucketCount, &sPlace);
+   uPosition = SymTableFrozen_position(
+      &sPlace,
+      SymTableFrozen_displace(oFrozen->auDisplacement[sPlace.uBucket]),
+      oFrozen->uLength);
+
+   /* The one key that could match */
+   pcFoundKey = SymTableFrozen_key(oFrozen, uPosition, &uFoundLength);
+   if (pcFoundKey != NULL && uFoundLength == uKeyLength &&
+       memcmp(pcFoundKey, pcKey, uKeyLength) == 0)
+      return uPosition;
+   return oFrozen->uLength;
+}
+
+int SymTableFrozen_contains(SymTableFrozen_T oFrozen, const char *pcKey)
+{
+   assert(oFrozen != NULL);
+   assert(pcKey != NULL);
+
+   return SymTableFrozen_find(oFrozen, pcKey) != oFrozen->uLength;
+}
+
+void *SymTableFrozen_get(SymTableFrozen_T oFrozen, const char *pcKey)
+{
+   size_t uPosition;
+
+   assert(oFrozen != NULL);
+   assert(pcKey != NULL);
+
+   uPosition = SymTableFrozen_find(oFrozen, pcKey);
+   if (uPosition == oFrozen->uLength) return NULL;
+   return SymTableFrozen_value(oFrozen, uPosition);
+}
+
+void SymTableFrozen_map(SymTableFrozen_T oFrozen, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra)
+{
+   const char *pcKey;
+   size_t uKeyLength;
+   size_t uPosition;
+
+   assert(oFrozen != NULL);
+   assert(pfApply != NULL);
+
+   /* A damaged entry is passed over */
+   for (uPosition = 0; uPosition < oFrozen->uLength; uPosition++) {
+      pcKey = SymTableFrozen_key(oFrozen, uPosition, &uKeyLength);
+      if (pcKey != NULL)
+         (*pfApply)(pcKey, SymTableFrozen_value(oFrozen, uPosition),
+                    (void*)pvExtra);
+   }
+}
+
+/* Returns uSize rounded up to a multiple of sizeof(size_t). */
+static size_t SymTableFrozen_align(size_t uSize)
+{
+   return (uSize + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+}
+
+int SymTableFrozen_write(SymTableFrozen_T oFrozen, const char *pcFileName,
+                         size_t uPayloadSize,
+                         void (*pfEncode)(const char *pcKey, void *pvValue,
+                                          void *pvPayload, void *pvExtra),
+                         const void *pvExtra)
+{
+   struct FileHeader sHeader;
+   FILE *psFile;
+   char *pcTempName;
+   char *pcEntry;
+   const char *pcKey;
+   size_t uDisplacementSize;
+   size_t uKeyLength;
+   size_t uPosition;
+   size_t u;
+   int iSuccessful;
+
+   assert(oFrozen != NULL);
+   assert(pcFileName != NULL);
+   assert(pfEncode != NULL || uPayloadSize == 0);
+
+   memset(&sHeader, 0, sizeof(sHeader));
+   memcpy(sHeader.acMagic, FILE_MAGIC, sizeof(FILE_MAGIC));
+   sHeader.uWordSize = sizeof(size_t);
+   sHeader.uHashPolicy = KEYHASH_POLICY;
+   sHeader.uLength = oFrozen->uLength;
+   sHeader.uBucketCount = oFrozen->uBucketCount;
+   sHeader.uSeed = oFrozen->uSeed;
+   sHeader.uEntrySize = sizeof(size_t) + SymTableFrozen_align(uPayloadSize);
+   sHeader.uKeysSize = oFrozen->uKeysSize;
+   uDisplacementSize = oFrozen->uBucketCount * sizeof(unsigned int);
+
+   /* Write a new file and rename it over the old one, so that
+      mappings of the old one, in this process or others, stay
+      whole */
+   pcEntry = (char*)malloc(sHeader.uEntrySize);
+   pcTempName = (char*)malloc(strlen(pcFileName) + sizeof(TEMP_SUFFIX));
+   psFile = NULL;
+   if (pcEntry != NULL && pcTempName != NULL) {
+      strcpy(pcTempName, pcFileName);
+      strcat(pcTempName, TEMP_SUFFIX);
+      psFile = fopen(pcTempName, "wb");
+   }
+   if (psFile == NULL) {
+      free(pcEntry);
+      free(pcTempName);
+      return 0;
+   }
+
+   iSuccessful = fwrite(&sHeader, sizeof(sHeader), 1, psFile) == 1 &&
+      fwrite(oFrozen->auDisplacement, sizeof(unsigned int),
+             oFrozen->uBucketCount, psFile) == oFrozen->uBucketCount;
+   for (u = uDisplacementSize;
+        iSuccessful && u < SymTableFrozen_align(uDisplacementSize); u++)
+      iSuccessful = putc(0, psFile) != EOF;
+
+   /* Entries in position order, each with its value's payload */
+   for (uPosition = 0; iSuccessful && uPosition <= oFrozen->uLength;
+        uPosition++) {
+      memset(pcEntry, 0, sHeader.uEntrySize);
+      *(size_t*)pcEntry = SymTableFrozen_keyOffset(oFrozen, uPosition);
+      if (uPosition < oFrozen->uLength) {
+         /* Refuse to copy a damaged entry */
+         pcKey = SymTableFrozen_key(oFrozen, uPosition, &uKeyLength);
+         if (pcKey == NULL) {
+            iSuccessful = 0;
+            break;
+         }
+         if (uPayloadSize > 0)
+            (*pfEncode)(pcKey, SymTableFrozen_value(oFrozen, uPosition),
+                        pcEntry + sizeof(size_t), (void*)pvExtra);
+      }
+      iSuccessful = fwrite(pcEntry, sHeader.uEntrySize, 1, psFile) == 1;
+   }
+
+   if (iSuccessful)
+      iSuccessful = fwrite(oFrozen->pcKeys, 1, sHeader.uKeysSize, psFile)
+         == sHeader.uKeysSize;
+   if (fclose(psFile) != 0) iSuccessful = 0;
+   if (iSuccessful) iSuccessful = rename(pcTempName, pcFileName) == 0;
+   if (! iSuccessful) remove(pcTempName);
+
+   free(pcEntry);
+   free(pcTempName);
+   return iSuccessful;
+}
+
+/* Returns 1 (TRUE) if the uSize bytes at psHeader look like a file
+   written by SymTableFrozen_write on a machine like this one, or 0
+   (FALSE) otherwise. Checks the header, the file's size, and the
+   offsets that bound the keys, but not every entry, so that opening
+   touches only the first and last pages. Each entry is checked when it
+   is used instead. */
+static int SymTableFrozen_isValid(const struct FileHeader *psHeader,
+                                  size_t uSize)
+{
+   size_t uDisplacementSize;
+   size_t uEntriesSize;
+   const char *pcEntries;
+   const char *pcKeys;
+
+   if (memcmp(psHeader->acMagic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+       psHeader->uWordSize != sizeof(size_t) ||
+       psHeader->uHashPolicy != KEYHASH_POLICY ||
+       psHeader->uBucketCount == 0 ||
+       psHeader->uEntrySize < sizeof(size_t) ||
+       psHeader->uEntrySize % sizeof(size_t) != 0)
+      return 0;
+
+   /* The parts must add up to the file, without overflowing */
+   uSize -= sizeof(struct FileHeader);
+   if (psHeader->uBucketCount > uSize / sizeof(unsigned int)) return 0;
+   uDisplacementSize = SymTableFrozen_align(psHeader->uBucketCount
+                                            * sizeof(unsigned int));
+   if (uDisplacementSize > uSize) return 0;
+   uSize -= uDisplacementSize;
+   if (psHeader->uLength >= uSize / psHeader->uEntrySize) return 0;
+   uEntriesSize = (psHeader->uLength + 1) * psHeader->uEntrySize;
+   if (uSize - uEntriesSize != psHeader->uKeysSize) return 0;
+
+   pcEntries = (const char*)(psHeader + 1) + uDisplacementSize;
+   pcKeys = pcEntries + uEntriesSize;
+   return *(const size_t*)pcEntries == 0 &&
+      *(const size_t*)(pcEntries + psHeader->uLength
+                       * psHeader->uEntrySize) == psHeader->uKeysSize &&
+      (psHeader->uKeysSize == 0 || pcKeys[psHeader->uKeysSize - 1] == '\0');
+}
+
+SymTableFrozen_T SymTableFrozen_open(const char *pcFileName)
+{
+   SymTableFrozen_T oFrozen;
+   const struct FileHeader *psHeader;
+   struct stat sStat;
+   void *pvMapping;
+   size_t uSize;
+   int iFd;
+
+   assert(pcFileName != NULL);
+
+   iFd = open(pcFileName, O_RDONLY);
+   if (iFd < 0) return NULL;
+   if (fstat(iFd, &sStat) != 0 ||
+       sStat.st_size < (off_t)sizeof(struct FileHeader) ||
+       (off_t)(size_t)sStat.st_size != sStat.st_size) {
+      close(iFd);
+      return NULL;
+   }
+   uSize = (size_t)sStat.st_size;
+
+   /* The mapping outlives the descriptor */
+   pvMapping = mmap(NULL, uSize, PROT_READ, MAP_SHARED, iFd, 0);
+   close(iFd);
+   if (pvMapping == MAP_FAILED) return NULL;
+
+   psHeader = (const struct FileHeader*)pvMapping;
+   oFrozen = NULL;
+   if (SymTableFrozen_isValid(psHeader, uSize))
+      oFrozen = (SymTableFrozen_T)calloc(1, sizeof(struct SymTableFrozen));
+   if (oFrozen == NULL) {
+      munmap(pvMapping, uSize);
+      return NULL;
+   }
+
+   oFrozen->uLength = psHeader->uLength;
+   oFrozen->uBucketCount = psHeader->uBucketCount;
+   oFrozen->uSeed = psHeader->uSeed;
+   oFrozen->uEntrySize = psHeader->uEntrySize;
+   oFrozen->auDisplacement = (unsigned int*)(psHeader + 1);
+   oFrozen->pcEntries = (char*)oFrozen->auDisplacement
+      + SymTableFrozen_align(psHeader->uBucketCount * sizeof(unsigned int));
+   oFrozen->pcKeys = oFrozen->pcEntries
+      + (psHeader->uLength + 1) * psHeader->uEntrySize;
+   oFrozen->uKeysSize = psHeader->uKeysSize;
+   oFrozen->pvMapping = pvMapping;
+   oFrozen->uMappingSize = uSize;
+   return oFrozen;
+}
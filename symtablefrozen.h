@@ -0,0 +1,70 @@
+/* Interface for frozen Symbol Table functions */
+#ifndef SYMFROZEN_INCLUDED
+#define SYMFROZEN_INCLUDED
+#include <stddef.h>
+#include "symtable.h"
+
+/* A SymTableFrozen_T is a read-only copy of the bindings of a
+   SymTable_T. Its keys sit in one block of characters and its values
+   in one array, placed by a minimal perfect hash, so a lookup makes
+   one probe and at most one key comparison. Nothing changes it after
+   it is made, so any number of threads may use it at once. */
+typedef struct SymTableFrozen *SymTableFrozen_T;
+
+/* Return a new SymTableFrozen_T holding copies of the keys of
+   oSymTable bound to the same values, or NULL if insufficient memory
+   is available or oSymTable holds 2^32 or more bindings. oSymTable is
+   unchanged and may be freed or changed afterwards without affecting
+   the result. */
+SymTableFrozen_T SymTable_freeze(SymTable_T oSymTable);
+
+/* Write oFrozen to the file named pcFileName, in a form that
+   SymTableFrozen_open maps back into memory without reading or
+   rebuilding it. Each value is stored as a payload of uPayloadSize
+   bytes, which (*pfEncode) fills in given the binding's key, its
+   value, the payload's address, and pvExtra; the payload starts out
+   zeroed and is aligned like a size_t. pfEncode may be NULL if
+   uPayloadSize is 0. Returns 1 (TRUE) if successful, or 0 (FALSE) if
+   the file cannot be written, oFrozen was opened from a damaged file,
+   or insufficient memory is available. The file is written under a
+   temporary name and then renamed, so a file of the same name is
+   replaced whole or not at all, and tables already mapped from it
+   keep working. */
+int SymTableFrozen_write(SymTableFrozen_T oFrozen, const char *pcFileName,
+                         size_t uPayloadSize,
+                         void (*pfEncode)(const char *pcKey, void *pvValue,
+                                          void *pvPayload, void *pvExtra),
+                         const void *pvExtra);
+
+/* Return a new SymTableFrozen_T mapped read-only from the file named
+   pcFileName, which SymTableFrozen_write wrote on a machine with the
+   same word size and KEYHASH_POLICY. Its values are the addresses of
+   the payloads in the mapping, so lookups copy nothing and touch only
+   the pages they need, and processes that open the same file share
+   its pages. Returns NULL if the file cannot be mapped, is not such a
+   file, or insufficient memory is available. Opening checks the
+   file's layout but not each of its entries, so that it touches only
+   the first and last pages. Lookups and SymTableFrozen_map check each
+   entry they use instead, treating one whose key lies outside the file
+   as absent, so a damaged file cannot make them read past the
+   mapping. */
+SymTableFrozen_T SymTableFrozen_open(const char *pcFileName);
+
+/* Free oFrozen, unmapping its file if it came from one */
+void SymTableFrozen_free(SymTableFrozen_T oFrozen);
+
+/* Return number of bindings in oFrozen */
+size_t SymTableFrozen_getLength(SymTableFrozen_T oFrozen);
+
+/* SymTableFrozen_contains returns 1 (TRUE) if oFrozen contains a
+   binding whose key is pcKey, and 0 (FALSE) otherwise. */
+int SymTableFrozen_contains(SymTableFrozen_T oFrozen, const char *pcKey);
+
+/* Returns the value of the binding within oFrozen whose key is
+   pcKey, or NULL if no such binding exists. */
+void *SymTableFrozen_get(SymTableFrozen_T oFrozen, const char *pcKey);
+
+/* Calls (*pfApply) for all key-value bindings in oFrozen,
+passes pvExtra as an extra parameter */
+void SymTableFrozen_map(SymTableFrozen_T oFrozen, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra);
+#endif
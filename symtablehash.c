@@ -7,10 +7,41 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "symtable.h"
+#include "arena.h"
+#include "keyhash.h"
+#include "parallel.h"
 
-/* All possible bucket numbers */
-static const size_t buckets[] = 
-{509, 1021, 2039, 4093, 8191, 16381, 32749, 65521};
+/* The number of buckets in a new SymTable. Bucket counts are powers
+   of two, so a bucket number is the low bits of the full hash. */
+enum {INITIAL_BUCKET_COUNT = 512};
+
+/* The number of old buckets that each operation moves into the new
+   hash table while a resize is in progress. Growth doubles the
+   bucket count, so any step of 1 or more finishes the move before
+   the next expansion is due. */
+enum {MIGRATE_STEP = 4};
+
+/* SymTable_remove shrinks the hash table once fewer than one binding
+   per SHRINK_DIVISOR buckets remains. The table is sized for a load of
+   one half afterwards, well clear of both the growth and the shrink
+   thresholds, so alternating puts and removes cannot make it resize
+   back and forth. */
+enum {SHRINK_DIVISOR = 8};
+
+/* The number of keys that SymTable_putMany and SymTable_getMany hash
+   ahead of using them, so that the loads of their buckets overlap. */
+enum {BATCH_SIZE = 32};
+
+/* Hints that the memory at address pv will be read soon. */
+#ifdef __GNUC__
+#define SymTable_prefetch(pv) __builtin_prefetch(pv)
+#else
+#define SymTable_prefetch(pv) ((void)(pv))
+#endif
+
+/* Keys shorter than this many characters are stored inline in their
+   node instead of in a separate allocation. */
+enum {SHORT_KEY_SIZE = 24};
 
 /* Each key-value binding is stored in a BucketNode. BucketNodes
    are placed in buckets to form lists. */
@@ -22,8 +53,20 @@ struct BucketNode
    /* The binding's value. */
    const void *pvValue;
 
+   /* The full hash of the binding's key, before it is reduced to a
+      bucket number. */
+   size_t uHash;
+
+   /* The number of characters in the binding's key, so that keys of
+      other lengths are passed over without being read. */
+   size_t uLength;
+
    /* The address of the next BucketNode. */
    struct BucketNode *psNextNode;
+
+   /* Storage for the key, if it is shorter than SHORT_KEY_SIZE, so
+      that comparing it touches no memory outside the node. */
+   char acShortKey[SHORT_KEY_SIZE];
 };
 
 /* A SymTable tracks a hash table containing lists of key-value
@@ -40,94 +83,380 @@ struct SymTable
 
    /* The number of buckets in the hash table. */
    size_t hashTableSize;
+
+   /* The hash table being drained into hashTable while a resize is
+      in progress, or NULL if no resize is in progress. */
+   struct BucketNode **oldTable;
+
+   /* The number of buckets in oldTable. */
+   size_t oldTableSize;
+
+   /* Buckets of oldTable below this index have already been moved
+      into hashTable. */
+   size_t migrateIndex;
+
+   /* SymTable_remove does not shrink the hash table below this many
+      buckets, so that room set aside by SymTable_reserve stays. */
+   size_t minTableSize;
+
+   /* The Arena that BucketNodes and keys come from, or NULL if they
+      come from malloc. */
+   Arena_T oArena;
+
+   /* 1 (TRUE) if BucketNodes point to their callers' keys instead of
+      to copies, or 0 (FALSE) otherwise. */
+   int iBorrowedKeys;
+
+   /* Changed whenever a binding is added or removed or a resize
+      starts, so that iterators can tell that they are stale. */
+   size_t uVersion;
+
+   /* The resizes started since the SymTable was created, and those
+      that found insufficient memory. */
+   size_t uResizes;
+   size_t uFailedResizes;
+
+   /* Lookups that found their key and the nodes they compared, and
+      lookups that did not and theirs, counted only if SYMTABLE_STATS
+      is defined. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
 };
 
-/* Calculates and returns the proper hash of string pcKey given a
-   certain number of buckets (uBucketCount). */
-static size_t SymTable_hash(const char *pcKey, size_t uBucketCount)
-{
-   const size_t HASH_MULTIPLIER = 65599;
-   size_t u;
-   size_t uHash = 0;
+/* Counts, for SymTable_getStats, a lookup in oSymTable that compared
+   uProbes nodes and found its key if iFound is 1 (TRUE). Compiles to
+   nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)((iFound) ? ((oSymTable)->uHits++,                          \
+                       (oSymTable)->uHitProbes += (uProbes))          \
+                    : ((oSymTable)->uMisses++,                        \
+                       (oSymTable)->uMissProbes += (uProbes))))
+#else
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)(oSymTable), (void)(iFound), (void)(uProbes))
+#endif
 
+/* Calculates and returns the full hash of the uLength characters at
+   pcKey. Mask it with the number of buckets minus one to get a bucket
+   number. */
+static size_t SymTable_hash(const char *pcKey, size_t uLength)
+{
    assert(pcKey != NULL);
 
-   for (u = 0; pcKey[u] != '\0'; u++)
-      uHash = uHash * HASH_MULTIPLIER + (size_t)pcKey[u];
+   return KeyHash_hash(pcKey, uLength);
+}
 
-   return uHash % uBucketCount;
+/* Returns the bucket count that follows uSize, or uSize itself if the
+   table cannot grow any further. */
+static size_t SymTable_nextSize(size_t uSize)
+{
+   if (uSize > (size_t)-1 / sizeof(struct BucketNode*) / 2)
+      return uSize;
+   return 2 * uSize;
 }
 
-SymTable_T SymTable_new(void) {
+/* Returns the smallest bucket count that holds uCapacity bindings
+   without expanding, or 0 if no bucket array can be that large. */
+static size_t SymTable_sizeFor(size_t uCapacity)
+{
+   size_t uSize = INITIAL_BUCKET_COUNT;
+
+   while (uSize <= uCapacity) {
+      if (SymTable_nextSize(uSize) == uSize) return 0;
+      uSize = SymTable_nextSize(uSize);
+   }
+   return uSize;
+}
+
+/* Returns a new SymTable_T object configured by iOptions and with
+   uBucketCount buckets, or NULL if insufficient memory is
+   available. */
+static SymTable_T SymTable_create(int iOptions, size_t uBucketCount) {
    SymTable_T oSymTable;
 
    oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
    if (oSymTable == NULL) return NULL;
 
-   oSymTable->hashTable = calloc(buckets[0],sizeof(struct BucketNode*));
-   if (oSymTable->hashTable == NULL) return NULL;
+   oSymTable->oArena = NULL;
+   if (iOptions & SYMTABLE_ARENA) {
+      oSymTable->oArena = Arena_new(sizeof(struct BucketNode));
+      if (oSymTable->oArena == NULL) {
+         free(oSymTable);
+         return NULL;
+      }
+   }
 
+   oSymTable->hashTable = calloc(uBucketCount,
+                                 sizeof(struct BucketNode*));
+   if (oSymTable->hashTable == NULL) {
+      if (oSymTable->oArena != NULL) Arena_free(oSymTable->oArena);
+      free(oSymTable);
+      return NULL;
+   }
+
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
    oSymTable->nodeCount = 0;
-   oSymTable->hashTableSize = buckets[0];
+   oSymTable->hashTableSize = uBucketCount;
+   oSymTable->oldTable = NULL;
+   oSymTable->oldTableSize = 0;
+   oSymTable->migrateIndex = 0;
+   oSymTable->minTableSize = uBucketCount;
+   oSymTable->uVersion = 0;
+   oSymTable->uResizes = 0;
+   oSymTable->uFailedResizes = 0;
+   oSymTable->uHits = 0;
+   oSymTable->uHitProbes = 0;
+   oSymTable->uMisses = 0;
+   oSymTable->uMissProbes = 0;
    return oSymTable;
 }
 
-/* Resizes oSymTable's hash table to be newSize, copying all 
-   bindings into the new hash table. */
-static void SymTable_expand(SymTable_T oSymTable, size_t newSize) {
+SymTable_T SymTable_new(void) {
+   return SymTable_create(0, INITIAL_BUCKET_COUNT);
+}
+
+SymTable_T SymTable_newWithOptions(int iOptions) {
+   return SymTable_create(iOptions, INITIAL_BUCKET_COUNT);
+}
+
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   size_t uSize;
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return NULL;
+   return SymTable_create(0, uSize);
+}
+
+/* Returns a new BucketNode holding a copy of the uLength characters
+   at pcKey followed by '\0', or pcKey itself if oSymTable borrows
+   keys, or NULL if insufficient memory is available. Short keys are
+   copied into the node itself; longer ones into oSymTable's Arena if
+   it has one. The caller fills in the node's other fields but
+   uLength. */
+static struct BucketNode *SymTable_newNode(SymTable_T oSymTable,
+                                           const char *pcKey,
+                                           size_t uLength) {
+   struct BucketNode *psNewNode;
+   char *pcTempKey;
+
+   if (oSymTable->oArena != NULL)
+      psNewNode = (struct BucketNode*)Arena_alloc(oSymTable->oArena);
+   else
+      psNewNode = (struct BucketNode*)malloc(sizeof(struct BucketNode));
+   if (psNewNode == NULL) 
+      return NULL;
+   psNewNode->uLength = uLength;
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      psNewNode->pcKey = pcKey;
+      return psNewNode;
+   }
+
+   if (uLength < SHORT_KEY_SIZE) {
+      memcpy(psNewNode->acShortKey, pcKey, uLength);
+      psNewNode->acShortKey[uLength] = '\0';
+      psNewNode->pcKey = psNewNode->acShortKey;
+      return psNewNode;
+   }
+
+   if (oSymTable->oArena != NULL)
+      pcTempKey = Arena_copyString(oSymTable->oArena, pcKey, uLength);
+   else {
+      pcTempKey = malloc(uLength + 1);
+      if (pcTempKey != NULL) {
+         memcpy(pcTempKey, pcKey, uLength);
+         pcTempKey[uLength] = '\0';
+      }
+   }
+   if (pcTempKey == NULL) {
+      if (oSymTable->oArena != NULL)
+         Arena_release(oSymTable->oArena, psNewNode);
+      else
+         free(psNewNode);
+      return NULL;
+   }
+
+   psNewNode->pcKey = pcTempKey;
+   return psNewNode;
+}
+
+/* Frees psNode, which came from SymTable_newNode on oSymTable, along
+   with its key. */
+static void SymTable_freeNode(SymTable_T oSymTable,
+                              struct BucketNode *psNode) {
+   if (oSymTable->oArena != NULL) {
+      Arena_release(oSymTable->oArena, psNode);
+      return;
+   }
+   if (psNode->pcKey != psNode->acShortKey && !oSymTable->iBorrowedKeys)
+      free((char*)psNode->pcKey);
+   free(psNode);
+}
+
+/* Moves up to uSteps buckets of oSymTable's old hash table into its
+   current hash table, and frees the old hash table once it has been
+   drained. Does nothing if no resize is in progress. */
+static void SymTable_migrate(SymTable_T oSymTable, size_t uSteps) {
    struct BucketNode *psCurrentNode;
    struct BucketNode *psNextNode;
-   struct BucketNode **table;
-   size_t hash;
    size_t hashNew;
 
-   table = calloc(newSize,sizeof(struct BucketNode*));
-   if (table == NULL) return;
+   while (oSymTable->oldTable != NULL && uSteps > 0) {
+      psCurrentNode = oSymTable->oldTable[oSymTable->migrateIndex];
+      while(psCurrentNode != NULL) {
+         psNextNode = psCurrentNode->psNextNode;
 
-   /* Iterate through oSymTable and move all bindings into table */
-   for(hash = 0; hash < oSymTable->hashTableSize; hash++) {
-      if(oSymTable->hashTable[hash] != NULL) {
-         psCurrentNode = oSymTable->hashTable[hash];
-         while(psCurrentNode != NULL) {
-            psNextNode = psCurrentNode->psNextNode;
+         hashNew = psCurrentNode->uHash & (oSymTable->hashTableSize - 1);
 
-            hashNew = SymTable_hash(psCurrentNode->pcKey, newSize);
-            
-            psCurrentNode->psNextNode = table[hashNew];
-            table[hashNew] = psCurrentNode;
+         psCurrentNode->psNextNode = oSymTable->hashTable[hashNew];
+         oSymTable->hashTable[hashNew] = psCurrentNode;
 
-            psCurrentNode = psNextNode;
-         }
+         psCurrentNode = psNextNode;
+      }
+      oSymTable->migrateIndex++;
+      uSteps--;
+
+      if (oSymTable->migrateIndex == oSymTable->oldTableSize) {
+         free(oSymTable->oldTable);
+         oSymTable->oldTable = NULL;
+         oSymTable->oldTableSize = 0;
+         oSymTable->migrateIndex = 0;
       }
    }
-   
-   /* Insert newly created hash table into oSymTable and free the old
-      hash table */
-   oSymTable->hashTableSize = newSize;
-   free(oSymTable->hashTable);
+}
+
+/* Starts resizing oSymTable's hash table to newSize buckets, which
+   may be more or fewer than it has now. The bindings are moved over
+   incrementally by SymTable_migrate. Returns 1 (TRUE) if successful,
+   or 0 (FALSE) if newSize is the current size or if insufficient
+   memory is available, in which case oSymTable is left unchanged. */
+static int SymTable_resize(SymTable_T oSymTable, size_t newSize) {
+   struct BucketNode **table;
+
+   /* Finish any earlier resize before starting another one */
+   SymTable_migrate(oSymTable, (size_t)-1);
+
+   if (newSize == oSymTable->hashTableSize) return 0;
+
+   table = calloc(newSize,sizeof(struct BucketNode*));
+   if (table == NULL) {
+      oSymTable->uFailedResizes++;
+      return 0;
+   }
+   oSymTable->uVersion++;
+   oSymTable->uResizes++;
+
+   /* An empty table has nothing to move */
+   if (oSymTable->nodeCount == 0) {
+      free(oSymTable->hashTable);
+      oSymTable->hashTable = table;
+      oSymTable->hashTableSize = newSize;
+      return 1;
+   }
+
+   oSymTable->oldTable = oSymTable->hashTable;
+   oSymTable->oldTableSize = oSymTable->hashTableSize;
+   oSymTable->migrateIndex = 0;
    oSymTable->hashTable = table;
+   oSymTable->hashTableSize = newSize;
+   return 1;
 }
 
-void SymTable_free(SymTable_T oSymTable) {
+/* Returns the address of the bucket of oSymTable that holds, or
+   would hold, the binding whose key has full hash uHash. While a
+   resize is in progress this is the old bucket until that bucket is
+   moved. */
+static struct BucketNode **SymTable_bucket(SymTable_T oSymTable,
+                                           size_t uHash) {
+   size_t hash;
+
+   if (oSymTable->oldTable != NULL) {
+      hash = uHash & (oSymTable->oldTableSize - 1);
+      if (hash >= oSymTable->migrateIndex)
+         return &oSymTable->oldTable[hash];
+   }
+
+   hash = uHash & (oSymTable->hashTableSize - 1);
+   return &oSymTable->hashTable[hash];
+}
+
+/* Returns 1 (TRUE) if the key of psNode is the uLength characters at
+   pcKey, whose full hash is uHash, or 0 (FALSE) otherwise. The
+   characters are compared only once the hashes and lengths match. */
+static int SymTable_matches(const struct BucketNode *psNode,
+                            const char *pcKey, size_t uLength,
+                            size_t uHash) {
+   return psNode->uHash == uHash && psNode->uLength == uLength &&
+          (psNode->pcKey == pcKey ||
+           memcmp(psNode->pcKey, pcKey, uLength) == 0);
+}
+
+/* Returns the address of the link in bucket, a bucket of oSymTable,
+   that points to the BucketNode whose key is the uLength characters
+   at pcKey and whose full hash is uHash, or NULL if bucket holds no
+   such BucketNode. */
+static struct BucketNode **SymTable_findLink(SymTable_T oSymTable,
+                                             struct BucketNode **bucket,
+                                             const char *pcKey,
+                                             size_t uLength,
+                                             size_t uHash) {
+   struct BucketNode **link;
+   size_t uProbes = 0;
+
+   for (link = bucket; *link != NULL; link = &(*link)->psNextNode) {
+      uProbes++;
+      if (SymTable_matches(*link, pcKey, uLength, uHash)) {
+         SymTable_countLookup(oSymTable, 1, uProbes);
+         return link;
+      }
+   }
+   SymTable_countLookup(oSymTable, 0, uProbes);
+   return NULL;
+}
+
+/* Frees every BucketNode in the buckets of table, a hash table of
+   oSymTable, from index uFirst up to uSize, along with the nodes'
+   keys. */
+static void SymTable_freeBuckets(SymTable_T oSymTable,
+                                 struct BucketNode **table,
+                                 size_t uFirst, size_t uSize) {
    struct BucketNode *psCurrentNode;
    struct BucketNode *psNextNode;
    size_t hash;
 
-   assert(oSymTable != NULL);
-
-   for(hash = 0; hash < oSymTable->hashTableSize; hash++) {
-      if (oSymTable->hashTable[hash] != NULL) {
-         for (psCurrentNode = oSymTable->hashTable[hash];
+   for(hash = uFirst; hash < uSize; hash++) {
+      if (table[hash] != NULL) {
+         for (psCurrentNode = table[hash];
          psCurrentNode != NULL;
          psCurrentNode = psNextNode) 
             {
             psNextNode = psCurrentNode->psNextNode;
-            free((char*)(psCurrentNode->pcKey));
-            free(psCurrentNode);
+            SymTable_freeNode(oSymTable, psCurrentNode);
             psCurrentNode = NULL;
          }
       }
    }
+}
+
+void SymTable_free(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+
+   /* An Arena releases all nodes and keys at once */
+   if (oSymTable->oArena != NULL)
+      Arena_free(oSymTable->oArena);
+   else {
+      if (oSymTable->oldTable != NULL)
+         SymTable_freeBuckets(oSymTable, oSymTable->oldTable,
+                              oSymTable->migrateIndex,
+                              oSymTable->oldTableSize);
+      SymTable_freeBuckets(oSymTable, oSymTable->hashTable, 0,
+                           oSymTable->hashTableSize);
+   }
+   free(oSymTable->oldTable);
    free(oSymTable->hashTable);
    free(oSymTable);
 }
@@ -137,153 +466,453 @@ size_t SymTable_getLength(SymTable_T oSymTable) {
    return oSymTable->nodeCount;
 }
 
-int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
-   struct BucketNode *psNewNode;
-   char *pcTempKey;
+/* Makes room in oSymTable for a total of uCapacity bindings, in the
+   hash table and in the Arena if there is one. Returns 1 (TRUE) if
+   successful, or 0 (FALSE) if insufficient memory is available. */
+static int SymTable_grow(SymTable_T oSymTable, size_t uCapacity) {
+   size_t uSize;
+
+   if (oSymTable->oArena != NULL && uCapacity > oSymTable->nodeCount) {
+      if (!Arena_reserve(oSymTable->oArena,
+                         uCapacity - oSymTable->nodeCount))
+         return 0;
+   }
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return 0;
+   if (uSize <= oSymTable->hashTableSize) return 1;
+   return SymTable_resize(oSymTable, uSize);
+}
+
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   size_t uSize;
+
+   assert(oSymTable != NULL);
+
+   if (!SymTable_grow(oSymTable, uCapacity)) return 0;
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize > oSymTable->minTableSize)
+      oSymTable->minTableSize = uSize;
+   return 1;
+}
+
+void SymTable_compact(SymTable_T oSymTable) {
+   size_t uSize;
+
+   assert(oSymTable != NULL);
+
+   oSymTable->minTableSize = INITIAL_BUCKET_COUNT;
+
+   uSize = SymTable_sizeFor(2 * oSymTable->nodeCount);
+   if (uSize != 0 && uSize < oSymTable->hashTableSize)
+      (void)SymTable_resize(oSymTable, uSize);
+
+   /* Release the old hash table now rather than over later calls */
+   SymTable_migrate(oSymTable, (size_t)-1);
+}
+
+/* Adds one chain of uLength bindings to the histogram of *psStats. */
+static void SymTable_countChain(struct SymTableStats *psStats,
+                                size_t uLength) {
+   if (uLength > psStats->uMaxChain)
+      psStats->uMaxChain = uLength;
+   if (uLength >= SYMTABLE_HISTOGRAM_SIZE)
+      uLength = SYMTABLE_HISTOGRAM_SIZE - 1;
+   psStats->auChains[uLength]++;
+}
+
+/* Any resize in progress is finished first, so that every bucket is
+   in the current hash table. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct BucketNode *psNode;
+   size_t uLength;
    size_t hash;
-   long unsigned int i;
 
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   SymTable_migrate(oSymTable, (size_t)-1);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+   psStats->uBindings = oSymTable->nodeCount;
+   psStats->uBuckets = oSymTable->hashTableSize;
+   psStats->dLoadFactor = (double)oSymTable->nodeCount
+      / (double)oSymTable->hashTableSize;
+   psStats->uBytes = sizeof(struct SymTable)
+      + oSymTable->hashTableSize * sizeof(struct BucketNode*);
+   if (oSymTable->oArena != NULL)
+      psStats->uBytes += Arena_bytes(oSymTable->oArena);
+
+   for (hash = 0; hash < oSymTable->hashTableSize; hash++) {
+      uLength = 0;
+      for (psNode = oSymTable->hashTable[hash]; psNode != NULL;
+           psNode = psNode->psNextNode) {
+         uLength++;
+         if (oSymTable->oArena == NULL) {
+            psStats->uBytes += sizeof(struct BucketNode);
+            if (psNode->pcKey != psNode->acShortKey &&
+                !oSymTable->iBorrowedKeys)
+               psStats->uBytes += psNode->uLength + 1;
+         }
+      }
+      SymTable_countChain(psStats, uLength);
+   }
+
+   psStats->uResizes = oSymTable->uResizes;
+   psStats->uFailedResizes = oSymTable->uFailedResizes;
+   psStats->uHits = oSymTable->uHits;
+   psStats->uHitProbes = oSymTable->uHitProbes;
+   psStats->uMisses = oSymTable->uMisses;
+   psStats->uMissProbes = oSymTable->uMissProbes;
+}
+
+int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   hash = SymTable_hash(pcKey, oSymTable->hashTableSize);
-  
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+/* Adds the binding of the uLength characters at pcKey, whose full
+   hash is uHash, to pvValue to oSymTable, at the front of bucket,
+   where the key belongs but is not. Returns the new BucketNode, or
+   NULL if insufficient memory is available. */
+static struct BucketNode *SymTable_insert(SymTable_T oSymTable,
+                                          struct BucketNode **bucket,
+                                          const char *pcKey,
+                                          size_t uLength, size_t uHash,
+                                          const void *pvValue) {
+   struct BucketNode *psNewNode;
+
    /* Allocate data to new node, make sure there is enough space */
-   psNewNode = (struct BucketNode*)malloc(sizeof(struct BucketNode));
+   psNewNode = SymTable_newNode(oSymTable, pcKey, uLength);
    if (psNewNode == NULL) 
-      return 0;
+      return NULL;
 
-   if (SymTable_contains(oSymTable, pcKey)) { 
-      free(psNewNode); 
-      return 0;
-   }
-   pcTempKey = malloc(strlen(pcKey) + 1);
-   if (pcTempKey == NULL) {
-      free(psNewNode);
+   psNewNode->pvValue = pvValue;
+   psNewNode->uHash = uHash;
+
+   /* insert the new binding into the symbol table */
+   psNewNode->psNextNode = *bucket;
+   *bucket = psNewNode;
+   oSymTable->nodeCount++;
+   oSymTable->uVersion++;
+
+   /* Growth outpaces any resize still in progress only after a
+      shrink, and then SymTable_resize finishes that first. Resizing
+      moves nodes between buckets but never moves a node itself. */
+   if (oSymTable->nodeCount >= oSymTable->hashTableSize)
+      (void)SymTable_resize(oSymTable,
+                            SymTable_nextSize(oSymTable->hashTableSize));
+
+   return psNewNode;
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
+   struct BucketNode **bucket;
+   size_t uHash;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   SymTable_migrate(oSymTable, MIGRATE_STEP);
+
+   uHash = SymTable_hash(pcKey, uLength);
+   bucket = SymTable_bucket(oSymTable, uHash);
+   if (SymTable_findLink(oSymTable, bucket, pcKey, uLength, uHash) != NULL)
       return 0;
+
+   return SymTable_insert(oSymTable, bucket, pcKey, uLength, uHash,
+                          pvValue) != NULL;
+}
+
+/* Hashes the key and walks its bucket once, and adds the binding to
+   the bucket the walk ended in. */
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   struct BucketNode **bucket;
+   struct BucketNode **link;
+   struct BucketNode *psNode;
+   size_t uHash;
+   size_t uLength;
+   int iInserted = 0;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   SymTable_migrate(oSymTable, MIGRATE_STEP);
+
+   uLength = strlen(pcKey);
+   uHash = SymTable_hash(pcKey, uLength);
+   bucket = SymTable_bucket(oSymTable, uHash);
+   link = SymTable_findLink(oSymTable, bucket, pcKey, uLength, uHash);
+   if (link != NULL)
+      psNode = *link;
+   else {
+      psNode = SymTable_insert(oSymTable, bucket, pcKey, uLength, uHash,
+                               pvDefault);
+      iInserted = psNode != NULL;
    }
 
-   strcpy(pcTempKey, pcKey);
+   if (piInserted != NULL) *piInserted = iInserted;
+   if (psNode == NULL) return NULL;
+   return (void**)&psNode->pvValue;
+}
+
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   void **ppvValue;
 
-   psNewNode->pcKey = pcTempKey;
-   psNewNode->pvValue = pvValue;
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
 
-   /* insert the new binding into the symbol table */
-   psNewNode->psNextNode = oSymTable->hashTable[hash];
-   oSymTable->hashTable[hash] = psNewNode;
-   oSymTable->nodeCount++;
+   ppvValue = SymTable_findOrInsert(oSymTable, pcKey, pvDefault,
+                                    piInserted);
+   if (ppvValue == NULL) return 0;
+   if (pfUpdate != NULL)
+      *ppvValue = (*pfUpdate)(pcKey, *ppvValue, (void*)pvExtra);
+   return 1;
+}
 
-   if (oSymTable->nodeCount == oSymTable->hashTableSize) {
-      for (i = 0; i < (sizeof(buckets)/sizeof(buckets[0]) - 1); i++) {
-         if (oSymTable->nodeCount == buckets[i])
-         SymTable_expand(oSymTable, buckets[i + 1]);
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t auHash[BATCH_SIZE];
+   size_t auLength[BATCH_SIZE];
+   struct BucketNode **apsBucket[BATCH_SIZE];
+   struct BucketNode *psNewNode;
+   size_t uStart;
+   size_t uBatch;
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   /* Decide on growth once for the whole batch. Without the memory
+      for that, put the bindings one at a time, growing as they go. */
+   if (uCount > (size_t)-1 - oSymTable->nodeCount ||
+       !SymTable_grow(oSymTable, oSymTable->nodeCount + uCount)) {
+      for (u = 0; u < uCount; u++) {
+         iSuccessful = SymTable_put(oSymTable, apcKeys[u], apvValues[u]);
+         if (aiResults != NULL) aiResults[u] = iSuccessful;
+         if (iSuccessful) uAdded++;
       }
+      return uAdded;
    }
+   SymTable_migrate(oSymTable, (size_t)-1);
 
-   return 1;
+   for (uStart = 0; uStart < uCount; uStart += uBatch) {
+      uBatch = uCount - uStart;
+      if (uBatch > BATCH_SIZE) uBatch = BATCH_SIZE;
+
+      /* Hash the whole group first, so that its bucket loads are in
+         flight together */
+      for (u = 0; u < uBatch; u++) {
+         assert(apcKeys[uStart + u] != NULL);
+         auLength[u] = strlen(apcKeys[uStart + u]);
+         auHash[u] = SymTable_hash(apcKeys[uStart + u], auLength[u]);
+         apsBucket[u] = &oSymTable->hashTable[auHash[u]
+                                              & (oSymTable->hashTableSize - 1)];
+         SymTable_prefetch(apsBucket[u]);
+      }
+
+      for (u = 0; u < uBatch; u++) {
+         iSuccessful = 0;
+         if (SymTable_findLink(oSymTable, apsBucket[u], apcKeys[uStart + u],
+                               auLength[u], auHash[u]) == NULL) {
+            psNewNode = SymTable_newNode(oSymTable, apcKeys[uStart + u],
+                                         auLength[u]);
+            if (psNewNode != NULL) {
+               psNewNode->pvValue = apvValues[uStart + u];
+               psNewNode->uHash = auHash[u];
+               psNewNode->psNextNode = *apsBucket[u];
+               *apsBucket[u] = psNewNode;
+               oSymTable->nodeCount++;
+               oSymTable->uVersion++;
+               iSuccessful = 1;
+            }
+         }
+         if (aiResults != NULL) aiResults[uStart + u] = iSuccessful;
+         if (iSuccessful) uAdded++;
+      }
+   }
+   return uAdded;
+}
+
+/* Returns the BucketNode of oSymTable whose key is the uLength
+   characters at pcKey, or NULL if no such BucketNode exists, moving
+   some of any resize in progress along first. */
+static struct BucketNode *SymTable_lookup(SymTable_T oSymTable,
+                                          const char *pcKey,
+                                          size_t uLength) {
+   struct BucketNode **link;
+   size_t uHash;
+
+   SymTable_migrate(oSymTable, MIGRATE_STEP);
+
+   uHash = SymTable_hash(pcKey, uLength);
+   link = SymTable_findLink(oSymTable, SymTable_bucket(oSymTable, uHash),
+                            pcKey, uLength, uHash);
+   return link == NULL ? NULL : *link;
 }
 
 void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
    struct BucketNode *tempNode;
    const void *tempValue;
-   size_t hash;
 
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   hash = SymTable_hash(pcKey, oSymTable->hashTableSize);
-   
-   tempNode = oSymTable->hashTable[hash];
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) {
-         tempValue = tempNode->pvValue;
-         tempNode->pvValue = pvValue;
-         return (void *) tempValue;
-      }
-      tempNode = tempNode->psNextNode;
-   }
-   return NULL; 
+   tempNode = SymTable_lookup(oSymTable, pcKey, strlen(pcKey));
+   if (tempNode == NULL) return NULL;
+
+   tempValue = tempNode->pvValue;
+   tempNode->pvValue = pvValue;
+   return (void *) tempValue;
 }
 
 int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
-   struct BucketNode *tempNode;
-   size_t hash;
-
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   hash = SymTable_hash(pcKey, oSymTable->hashTableSize);
+   return SymTable_lookup(oSymTable, pcKey, strlen(pcKey)) != NULL;
+}
 
-   tempNode = oSymTable->hashTable[hash];
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) {
-         return 1;
-      }
-      tempNode = tempNode->psNextNode;
-   }
-   
-   return 0;
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_lookup(oSymTable, pcKey, uLength) != NULL;
 }
 
 void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
    struct BucketNode *tempNode;
-   size_t hash;
 
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   hash = SymTable_hash(pcKey, oSymTable->hashTableSize);
+   tempNode = SymTable_lookup(oSymTable, pcKey, uLength);
+   if (tempNode == NULL) return NULL;
+   return (void*) tempNode->pvValue;
+}
+
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   size_t auHash[BATCH_SIZE];
+   size_t auLength[BATCH_SIZE];
+   struct BucketNode *apsNode[BATCH_SIZE];
+   struct BucketNode **bucket;
+   struct BucketNode *tempNode;
+   size_t uStart;
+   size_t uBatch;
+   size_t u;
+   size_t uFound = 0;
+   size_t uProbes;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (uStart = 0; uStart < uCount; uStart += uBatch) {
+      uBatch = uCount - uStart;
+      if (uBatch > BATCH_SIZE) uBatch = BATCH_SIZE;
+
+      SymTable_migrate(oSymTable, MIGRATE_STEP);
 
-   tempNode = oSymTable->hashTable[hash];
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) return (void*) tempNode->pvValue;
-      tempNode = tempNode->psNextNode;
+      /* Start loading every bucket of the group ... */
+      for (u = 0; u < uBatch; u++) {
+         assert(apcKeys[uStart + u] != NULL);
+         auLength[u] = strlen(apcKeys[uStart + u]);
+         auHash[u] = SymTable_hash(apcKeys[uStart + u], auLength[u]);
+         SymTable_prefetch(SymTable_bucket(oSymTable, auHash[u]));
+      }
+
+      /* ... then every first node ... */
+      for (u = 0; u < uBatch; u++) {
+         bucket = SymTable_bucket(oSymTable, auHash[u]);
+         apsNode[u] = *bucket;
+         if (apsNode[u] != NULL) SymTable_prefetch(apsNode[u]);
+      }
+
+      /* ... and only then walk the chains */
+      for (u = 0; u < uBatch; u++) {
+         apvValues[uStart + u] = NULL;
+         uProbes = 0;
+         for (tempNode = apsNode[u]; tempNode != NULL;
+              tempNode = tempNode->psNextNode) {
+            uProbes++;
+            if (SymTable_matches(tempNode, apcKeys[uStart + u],
+                                 auLength[u], auHash[u])) {
+               apvValues[uStart + u] = (void*)tempNode->pvValue;
+               uFound++;
+               break;
+            }
+         }
+         SymTable_countLookup(oSymTable, tempNode != NULL, uProbes);
+      }
    }
-   return NULL;
+   return uFound;
 }
 
 void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
-   struct BucketNode *tempNode_current;
-   struct BucketNode *tempNode_next;
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct BucketNode *psNode;
+   struct BucketNode **link;
    const void *tempValue;
-   size_t hash;
+   size_t uHash;
+   size_t uSize;
 
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   if (SymTable_contains(oSymTable, pcKey) != 1) return NULL;
+   SymTable_migrate(oSymTable, MIGRATE_STEP);
 
-   hash = SymTable_hash(pcKey, oSymTable->hashTableSize);
+   uHash = SymTable_hash(pcKey, uLength);
+   link = SymTable_findLink(oSymTable, SymTable_bucket(oSymTable, uHash),
+                            pcKey, uLength, uHash);
+   if (link == NULL) return NULL;
 
-   tempNode_current = oSymTable->hashTable[hash];
-   tempNode_next = tempNode_current->psNextNode;
-   if (strcmp(tempNode_current->pcKey, pcKey) == 0) {
-      oSymTable->hashTable[hash] = tempNode_next;
-      tempValue = tempNode_current->pvValue;
-      free((char*)tempNode_current->pcKey);
-      free(tempNode_current);
-      tempNode_current = NULL;
-      oSymTable->nodeCount--;
-      return (void *) tempValue;
-   }
-    
-
-
-   while (tempNode_next != NULL) {
-      if(strcmp(tempNode_next->pcKey, pcKey) == 0) {
-         tempValue = tempNode_next->pvValue;
-         tempNode_current->psNextNode = (struct BucketNode *) tempNode_next->psNextNode;
-         free((char*)tempNode_next->pcKey);
-         free(tempNode_next);
-         tempNode_next = NULL;
-         oSymTable->nodeCount--;
-         return (void *) tempValue;
-      }
-      tempNode_current = tempNode_next;
-      tempNode_next = tempNode_current->psNextNode;
+   psNode = *link;
+   *link = psNode->psNextNode;
+   tempValue = psNode->pvValue;
+   SymTable_freeNode(oSymTable, psNode);
+   oSymTable->nodeCount--;
+   oSymTable->uVersion++;
+
+   if (oSymTable->oldTable == NULL &&
+       oSymTable->hashTableSize > oSymTable->minTableSize &&
+       oSymTable->nodeCount < oSymTable->hashTableSize / SHRINK_DIVISOR) {
+      uSize = SymTable_sizeFor(2 * oSymTable->nodeCount);
+      if (uSize < oSymTable->minTableSize)
+         uSize = oSymTable->minTableSize;
+      (void)SymTable_resize(oSymTable, uSize);
    }
 
-   return NULL;
+   return (void *) tempValue;
 }
 
 void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra) {
@@ -293,6 +922,18 @@ void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void
    assert(oSymTable != NULL);
    assert(pfApply != NULL);
 
+   /* Buckets of the old hash table that have not been moved yet */
+   if (oSymTable->oldTable != NULL) {
+      for (hash = oSymTable->migrateIndex;
+           hash < oSymTable->oldTableSize; hash++) {
+         for (tempNode_current = oSymTable->oldTable[hash];
+              tempNode_current != NULL;
+              tempNode_current = tempNode_current->psNextNode) {
+            (*pfApply)(tempNode_current->pcKey, (void*)tempNode_current->pvValue, (void*)pvExtra);
+         }
+      }
+   }
+
    for (hash = 0; hash < oSymTable->hashTableSize; hash++) {
       for (tempNode_current = oSymTable->hashTable[hash]; 
          tempNode_current != NULL; 
@@ -301,4 +942,117 @@ void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void
          }
       }
    
-}
\ No newline at end of file
+}
+
+/* The number of buckets that a thread of SymTable_mapParallel takes
+   at a time. */
+enum {MAP_CHUNK_SIZE = 1024};
+
+/* What each thread of SymTable_mapParallel needs. */
+struct MapWork
+{
+   SymTable_T oSymTable;
+   void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra);
+   void *pvExtra;
+};
+
+/* Applies the MapWork at pvWork to buckets uFirst to uLimit - 1. */
+static void SymTable_mapChunk(size_t uFirst, size_t uLimit,
+                              void *pvWork) {
+   struct MapWork *psWork = (struct MapWork*)pvWork;
+   struct BucketNode *tempNode_current;
+   size_t hash;
+
+   for (hash = uFirst; hash < uLimit; hash++) {
+      for (tempNode_current = psWork->oSymTable->hashTable[hash];
+           tempNode_current != NULL;
+           tempNode_current = tempNode_current->psNextNode) {
+         (*psWork->pfApply)(tempNode_current->pcKey,
+                            (void*)tempNode_current->pvValue,
+                            psWork->pvExtra);
+      }
+   }
+}
+
+/* Finishes any resize in progress first, so that every binding is in
+   the one hash table. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   struct MapWork sWork;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+   assert(iThreads > 0);
+
+   SymTable_migrate(oSymTable, (size_t)-1);
+
+   sWork.oSymTable = oSymTable;
+   sWork.pfApply = pfApply;
+   sWork.pvExtra = (void*)pvExtra;
+   Parallel_run(oSymTable->hashTableSize, MAP_CHUNK_SIZE,
+                SymTable_mapChunk, &sWork, iThreads);
+}
+
+size_t SymTable_mapWorker(void) {
+   return Parallel_worker();
+}
+
+/* Begins by finishing any resize in progress, since lookups move
+   bindings while one is. uIndex is the next bucket to look in, and
+   pvPosition the BucketNode the iterator is at. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   SymTable_migrate(oSymTable, (size_t)-1);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = NULL;
+   psIter->uIndex = 0;
+   psIter->uVersion = oSymTable->uVersion;
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   SymTable_T oSymTable;
+   const struct BucketNode *psNode = NULL;
+
+   assert(psIter != NULL);
+
+   oSymTable = psIter->oSymTable;
+   if (psIter->uVersion != oSymTable->uVersion)
+      psIter->iStale = 1;
+   if (psIter->iStale) return 0;
+
+   if (psIter->pvPosition != NULL)
+      psNode = ((const struct BucketNode*)psIter->pvPosition)->psNextNode;
+   while (psNode == NULL && psIter->uIndex < oSymTable->hashTableSize)
+      psNode = oSymTable->hashTable[psIter->uIndex++];
+
+   psIter->pvPosition = psNode;
+   if (psNode == NULL) return 0;
+   psIter->pcKey = psNode->pcKey;
+   psIter->pvValue = (void*)psNode->pvValue;
+   return 1;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
@@ -0,0 +1,299 @@
+/* Module defining the writing of symbol tables to streams and their
+   reading back, built on the SymTable interface alone so that it works
+   with every implementation. */
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include "symtableio.h"
+
+/* Identifies a stream written by SymTable_write, and the version of
+   its layout. */
+static const char STREAM_MAGIC[8] = "SYMSTR1";
+
+/* SymTable_read adds bindings in chunks of up to this many. */
+enum {CHUNK_BINDINGS = 256};
+
+/* SymTable_read sizes a new table for at most this many bindings
+   before reading any, so that a damaged or hostile count cannot make
+   it allocate more than the stream could fill. Tables of more
+   bindings grow as they are added. */
+enum {MAX_PRESIZE_BINDINGS = 1048576};
+
+/* The initial room for the keys of a chunk. A chunk ends early when
+   its keys fill it; a single longer key gets room of its own. */
+enum {CHUNK_KEYS_SIZE = 16384};
+
+/* A stream is STREAM_MAGIC, then the number of bindings, then each
+   binding's key length, key characters without the NUL, and encoded
+   value. Counts and lengths are written seven bits to a byte, least
+   significant first, with the top bit set on every byte but the
+   last. */
+
+/* What SymTable_writeBinding needs besides the binding. */
+struct WriteState
+{
+   /* The stream written to. */
+   FILE *psFile;
+
+   /* The caller's encoder and its extra parameter. */
+   int (*pfEncode)(const char *pcKey, void *pvValue, FILE *psFile,
+                   void *pvExtra);
+   void *pvExtra;
+
+   /* 1 (TRUE) until a write fails, after which the remaining bindings
+      are skipped. */
+   int iSuccessful;
+};
+
+/* A chunk of bindings read by SymTable_read and not yet added. */
+struct Chunk
+{
+   /* The number of bindings in the chunk. */
+   size_t uCount;
+
+   /* The bindings, whose keys point into pcKeys. */
+   const char *apcKeys[CHUNK_BINDINGS];
+   const void *apvValues[CHUNK_BINDINGS];
+   int aiResults[CHUNK_BINDINGS];
+
+   /* The keys of the chunk, end to end, with their NULs. */
+   char *pcKeys;
+   size_t uKeysUsed;
+   size_t uKeysSize;
+};
+
+/* Writes uLength to psFile seven bits to a byte. Returns 1 (TRUE) if
+   successful, or 0 (FALSE) if the write fails. */
+static int SymTable_writeLength(FILE *psFile, size_t uLength) {
+   unsigned char acBytes[(sizeof(size_t) * CHAR_BIT + 6) / 7];
+   size_t uCount = 0;
+
+   assert(psFile != NULL);
+
+   do {
+      acBytes[uCount] = (unsigned char)(uLength & 0x7F);
+      uLength >>= 7;
+      if (uLength != 0) acBytes[uCount] |= 0x80;
+      uCount++;
+   } while (uLength != 0);
+
+   return fwrite(acBytes, 1, uCount, psFile) == uCount;
+}
+
+/* Reads a length written by SymTable_writeLength from psFile into
+   *puLength. Returns 1 (TRUE) if successful, or 0 (FALSE) if the
+   stream ends early or the length does not fit in a size_t. */
+static int SymTable_readLength(FILE *psFile, size_t *puLength) {
+   size_t uLength = 0;
+   size_t uShift = 0;
+   size_t uBits;
+   int iByte;
+
+   assert(psFile != NULL);
+   assert(puLength != NULL);
+
+   do {
+      iByte = getc(psFile);
+      if (iByte == EOF || uShift >= sizeof(size_t) * CHAR_BIT)
+         return 0;
+      uBits = (size_t)(iByte & 0x7F);
+      if (((uBits << uShift) >> uShift) != uBits) return 0;
+      uLength |= uBits << uShift;
+      uShift += 7;
+   } while (iByte & 0x80);
+
+   *puLength = uLength;
+   return 1;
+}
+
+/* Writes the binding pcKey-pvValue to the stream of the WriteState
+   that pvState points to, unless an earlier write has failed. */
+static void SymTable_writeBinding(const char *pcKey, void *pvValue,
+                                  void *pvState) {
+   struct WriteState *psState = (struct WriteState*)pvState;
+   size_t uLength;
+
+   assert(pcKey != NULL);
+   assert(psState != NULL);
+
+   if (! psState->iSuccessful) return;
+
+   uLength = strlen(pcKey);
+   psState->iSuccessful =
+      SymTable_writeLength(psState->psFile, uLength)
+      && fwrite(pcKey, 1, uLength, psState->psFile) == uLength
+      && (psState->pfEncode == NULL
+          || (*psState->pfEncode)(pcKey, pvValue, psState->psFile,
+                                  psState->pvExtra));
+}
+
+int SymTable_write(SymTable_T oSymTable, FILE *psFile,
+                   int (*pfEncode)(const char *pcKey, void *pvValue,
+                                   FILE *psFile, void *pvExtra),
+                   const void *pvExtra) {
+   struct WriteState sState;
+
+   assert(oSymTable != NULL);
+   assert(psFile != NULL);
+
+   if (fwrite(STREAM_MAGIC, 1, sizeof(STREAM_MAGIC), psFile)
+       != sizeof(STREAM_MAGIC)
+       || ! SymTable_writeLength(psFile, SymTable_getLength(oSymTable)))
+      return 0;
+
+   sState.psFile = psFile;
+   sState.pfEncode = pfEncode;
+   sState.pvExtra = (void*)pvExtra;
+   sState.iSuccessful = 1;
+   SymTable_map(oSymTable, SymTable_writeBinding, &sState);
+   return sState.iSuccessful;
+}
+
+/* Adds the bindings of psChunk to oSymTable and empties psChunk.
+   Returns 1 (TRUE) if successful, or 0 (FALSE) if a binding could not
+   be added, either for lack of memory or because its key was already
+   present; then, if pfFree is not NULL, it is called with pvExtra for
+   each binding not added. */
+static int SymTable_addChunk(SymTable_T oSymTable, struct Chunk *psChunk,
+                             void (*pfFree)(const char *pcKey,
+                                            void *pvValue,
+                                            void *pvExtra),
+                             const void *pvExtra) {
+   size_t uCount;
+   size_t uAdded;
+   size_t u;
+
+   assert(oSymTable != NULL);
+   assert(psChunk != NULL);
+
+   uCount = psChunk->uCount;
+   psChunk->uCount = 0;
+   psChunk->uKeysUsed = 0;
+   if (uCount == 0) return 1;
+
+   uAdded = SymTable_putMany(oSymTable, psChunk->apcKeys,
+                             psChunk->apvValues, uCount,
+                             psChunk->aiResults);
+   if (uAdded != uCount && pfFree != NULL) {
+      for (u = 0; u < uCount; u++)
+         if (! psChunk->aiResults[u])
+            (*pfFree)(psChunk->apcKeys[u], (void*)psChunk->apvValues[u],
+                      (void*)pvExtra);
+   }
+   return uAdded == uCount;
+}
+
+/* Makes room in psChunk for a key of uLength characters and its NUL,
+   first adding psChunk's bindings to oSymTable if the room is taken.
+   Returns the address at which to read the key, or NULL if a binding
+   could not be added or insufficient memory is available. */
+static char *SymTable_chunkRoom(SymTable_T oSymTable,
+                                struct Chunk *psChunk, size_t uLength,
+                                void (*pfFree)(const char *pcKey,
+                                               void *pvValue,
+                                               void *pvExtra),
+                                const void *pvExtra) {
+   char *pcNewKeys;
+
+   assert(oSymTable != NULL);
+   assert(psChunk != NULL);
+
+   if (psChunk->uCount == CHUNK_BINDINGS
+       || uLength >= psChunk->uKeysSize - psChunk->uKeysUsed) {
+      if (! SymTable_addChunk(oSymTable, psChunk, pfFree, pvExtra))
+         return NULL;
+   }
+
+   /* The chunk is empty if the key still does not fit, so no key
+      points into the old block */
+   if (uLength >= psChunk->uKeysSize) {
+      if (uLength == (size_t)-1) return NULL;
+      pcNewKeys = (char*)realloc(psChunk->pcKeys, uLength + 1);
+      if (pcNewKeys == NULL) return NULL;
+      psChunk->pcKeys = pcNewKeys;
+      psChunk->uKeysSize = uLength + 1;
+   }
+
+   return psChunk->pcKeys + psChunk->uKeysUsed;
+}
+
+SymTable_T SymTable_read(FILE *psFile,
+                         int (*pfDecode)(const char *pcKey,
+                                         void **ppvValue,
+                                         FILE *psFile, void *pvExtra),
+                         void (*pfFree)(const char *pcKey, void *pvValue,
+                                        void *pvExtra),
+                         const void *pvExtra) {
+   SymTable_T oSymTable;
+   struct Chunk sChunk;
+   char acMagic[sizeof(STREAM_MAGIC)];
+   char *pcKey;
+   void *pvValue;
+   size_t uCount;
+   size_t uLength;
+   size_t u;
+   int iSuccessful;
+
+   assert(psFile != NULL);
+
+   if (fread(acMagic, 1, sizeof(acMagic), psFile) != sizeof(acMagic)
+       || memcmp(acMagic, STREAM_MAGIC, sizeof(acMagic)) != 0
+       || ! SymTable_readLength(psFile, &uCount))
+      return NULL;
+
+   /* Size the table once, so that adding causes no resizing up to
+      MAX_PRESIZE_BINDINGS bindings */
+   oSymTable = SymTable_newWithCapacity(
+      uCount < MAX_PRESIZE_BINDINGS ? uCount : MAX_PRESIZE_BINDINGS);
+   if (oSymTable == NULL) return NULL;
+
+   sChunk.uCount = 0;
+   sChunk.uKeysUsed = 0;
+   sChunk.uKeysSize = CHUNK_KEYS_SIZE;
+   sChunk.pcKeys = (char*)malloc(sChunk.uKeysSize);
+   iSuccessful = sChunk.pcKeys != NULL;
+
+   for (u = 0; iSuccessful && u < uCount; u++) {
+      iSuccessful = SymTable_readLength(psFile, &uLength);
+      if (! iSuccessful) break;
+      pcKey = SymTable_chunkRoom(oSymTable, &sChunk, uLength, pfFree,
+                                 pvExtra);
+      iSuccessful = pcKey != NULL
+         && fread(pcKey, 1, uLength, psFile) == uLength
+         && memchr(pcKey, '\0', uLength) == NULL;
+      if (! iSuccessful) break;
+      pcKey[uLength] = '\0';
+
+      pvValue = NULL;
+      if (pfDecode != NULL)
+         iSuccessful = (*pfDecode)(pcKey, &pvValue, psFile,
+                                   (void*)pvExtra);
+      if (! iSuccessful) break;
+
+      sChunk.apcKeys[sChunk.uCount] = pcKey;
+      sChunk.apvValues[sChunk.uCount] = pvValue;
+      sChunk.uCount++;
+      sChunk.uKeysUsed += uLength + 1;
+   }
+   if (iSuccessful)
+      iSuccessful = SymTable_addChunk(oSymTable, &sChunk, pfFree,
+                                      pvExtra);
+
+   if (! iSuccessful) {
+      /* Values decoded but not yet added are in the chunk */
+      if (pfFree != NULL) {
+         for (u = 0; u < sChunk.uCount; u++)
+            (*pfFree)(sChunk.apcKeys[u], (void*)sChunk.apvValues[u],
+                      (void*)pvExtra);
+         SymTable_map(oSymTable, pfFree, pvExtra);
+      }
+      SymTable_free(oSymTable);
+      oSymTable = NULL;
+   }
+   free(sChunk.pcKeys);
+   return oSymTable;
+}
@@ -0,0 +1,46 @@
+/* Interface for streaming SymTable functions */
+#ifndef SYMIO_INCLUDED
+#define SYMIO_INCLUDED
+#include <stdio.h>
+#include "symtable.h"
+
+/* A stream written by SymTable_write holds a count of bindings
+   followed by each binding's key and then its value. Nothing in it
+   depends on the writer's word size or hash, so a table can be
+   checkpointed to a file or passed through a pipe and read back by
+   another process. Values are written and read by callbacks, since
+   only the caller knows what they point to. */
+
+/* Write the bindings of oSymTable to psFile, at its current position.
+   (*pfEncode) writes each value to psFile given the binding's key,
+   its value, psFile, and pvExtra, and returns 1 (TRUE) if successful
+   or 0 (FALSE) otherwise. pfEncode may be NULL, in which case no
+   values are written. oSymTable must not change while it is written.
+   Returns 1 (TRUE) if successful, or 0 (FALSE) if a write fails. The
+   caller flushes or closes psFile. */
+int SymTable_write(SymTable_T oSymTable, FILE *psFile,
+                   int (*pfEncode)(const char *pcKey, void *pvValue,
+                                   FILE *psFile, void *pvExtra),
+                   const void *pvExtra);
+
+/* Return a new SymTable_T holding the bindings that SymTable_write
+   wrote to psFile, read from psFile's current position. The table is
+   sized for all of them, up to about a million, before the first is
+   added, and grows as usual beyond that. The bindings are read and
+   added in chunks, so memory use beyond the table itself stays small.
+   (*pfDecode) reads each value from psFile given the binding's key,
+   the address at which to store the value, psFile, and pvExtra, and
+   returns 1 (TRUE) if successful or 0 (FALSE) otherwise. pfDecode may
+   be NULL, in which case every value is NULL. Returns NULL if the
+   stream ends early or is not such a stream, (*pfDecode) fails, or
+   insufficient memory is available; if pfFree is not NULL, it is then
+   called for every value decoded so far, given its key, the value and
+   pvExtra. On success psFile is left just past the last binding. */
+SymTable_T SymTable_read(FILE *psFile,
+                         int (*pfDecode)(const char *pcKey,
+                                         void **ppvValue,
+                                         FILE *psFile, void *pvExtra),
+                         void (*pfFree)(const char *pcKey, void *pvValue,
+                                        void *pvExtra),
+                         const void *pvExtra);
+#endif
@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "symtable.h"
+#include "arena.h"
+
+/* Keys shorter than this many characters are stored inline in their
+   node instead of in a separate allocation. */
+enum {SHORT_KEY_SIZE = 24};
 
 /* Each key-value binding is stored in a SymTableNode. SymTableNodes
    are placed in sequence to form lists. */
@@ -18,8 +23,16 @@ struct SymTableNode
    /* The binding's value. */
    const void *pvValue;
 
+   /* The number of characters in the binding's key, so that keys of
+      other lengths are passed over without being read. */
+   size_t uLength;
+
    /* The address of the next SymTableNode. */
    struct SymTableNode *psNextNode;
+
+   /* Storage for the key, if it is shorter than SHORT_KEY_SIZE, so
+      that comparing it touches no memory outside the node. */
+   char acShortKey[SHORT_KEY_SIZE];
 };
 
 /* ADD COMMENT HERE */
@@ -30,31 +43,247 @@ struct SymTable
 
    /* Number of elements in SymTable */
    size_t nodeCount;
+
+   /* Changed whenever a binding is added, removed or moved, so that
+      iterators can tell that they are stale. */
+   size_t uVersion;
+
+   /* The Arena that SymTableNodes and keys come from, or NULL if they
+      come from malloc. */
+   Arena_T oArena;
+
+   /* SYMTABLE_MOVE_TO_FRONT or SYMTABLE_TRANSPOSE if lookups reorder
+      the list, or 0 if they leave it alone. */
+   int iReorder;
+
+   /* 1 (TRUE) if SymTableNodes point to their callers' keys instead
+      of to copies, or 0 (FALSE) otherwise. */
+   int iBorrowedKeys;
+
+   /* Lookups that found their key and the nodes they compared, and
+      lookups that did not and theirs, counted only if SYMTABLE_STATS
+      is defined. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
 };
 
+/* Counts, for SymTable_getStats, a lookup in oSymTable that compared
+   uProbes nodes and found its key if iFound is 1 (TRUE). Compiles to
+   nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)((iFound) ? ((oSymTable)->uHits++,                          \
+                       (oSymTable)->uHitProbes += (uProbes))          \
+                    : ((oSymTable)->uMisses++,                        \
+                       (oSymTable)->uMissProbes += (uProbes))))
+#else
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)(oSymTable), (void)(iFound), (void)(uProbes))
+#endif
+
+/* Returns 1 (TRUE) if the key of psNode is the uLength characters at
+   pcKey, or 0 (FALSE) otherwise. The characters are compared only
+   once the lengths match. */
+static int SymTable_matches(const struct SymTableNode *psNode,
+                            const char *pcKey, size_t uLength) {
+   return psNode->uLength == uLength &&
+          (psNode->pcKey == pcKey ||
+           memcmp(psNode->pcKey, pcKey, uLength) == 0);
+}
+
+/* Returns the address of the link in oSymTable that points to the
+   SymTableNode whose key is the uLength characters at pcKey, or NULL
+   if no such SymTableNode exists. */
+static struct SymTableNode **SymTable_findLink(SymTable_T oSymTable,
+                                             const char *pcKey,
+                                             size_t uLength) {
+   struct SymTableNode **link;
+   size_t uProbes = 0;
+
+   for (link = &oSymTable->psFirstNode; *link != NULL;
+        link = &(*link)->psNextNode) {
+      uProbes++;
+      if (SymTable_matches(*link, pcKey, uLength)) {
+         SymTable_countLookup(oSymTable, 1, uProbes);
+         return link;
+      }
+   }
+   SymTable_countLookup(oSymTable, 0, uProbes);
+   return NULL;
+}
+
+/* Returns the SymTableNode in oSymTable whose key is the uLength
+   characters at pcKey, or NULL if no such SymTableNode exists. If
+   oSymTable reorders on lookup, first moves the SymTableNode to the
+   front of the list or one place toward it. */
+static struct SymTableNode *SymTable_findNode(SymTable_T oSymTable,
+                                              const char *pcKey,
+                                              size_t uLength) {
+   struct SymTableNode **link;
+   struct SymTableNode **prevLink = NULL;
+   struct SymTableNode *psNode;
+   size_t uProbes = 0;
+
+   for (link = &oSymTable->psFirstNode; *link != NULL;
+        prevLink = link, link = &(*link)->psNextNode) {
+      uProbes++;
+      if (SymTable_matches(*link, pcKey, uLength))
+         break;
+   }
+   psNode = *link;
+   SymTable_countLookup(oSymTable, psNode != NULL, uProbes);
+   if (psNode == NULL || prevLink == NULL || oSymTable->iReorder == 0)
+      return psNode;
+
+   /* Unlink the node, then link it in again at the front, or in front
+      of the node that preceded it */
+   *link = psNode->psNextNode;
+   if (oSymTable->iReorder == SYMTABLE_MOVE_TO_FRONT) {
+      psNode->psNextNode = oSymTable->psFirstNode;
+      oSymTable->psFirstNode = psNode;
+   }
+   else {
+      psNode->psNextNode = *prevLink;
+      *prevLink = psNode;
+   }
+   oSymTable->uVersion++;
+   return psNode;
+}
+
 SymTable_T SymTable_new(void) {
+   return SymTable_newWithOptions(0);
+}
+
+SymTable_T SymTable_newWithOptions(int iOptions) {
    SymTable_T oSymTable;
 
    oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
    if (oSymTable == NULL) return NULL;
 
+   oSymTable->oArena = NULL;
+   if (iOptions & SYMTABLE_ARENA) {
+      oSymTable->oArena = Arena_new(sizeof(struct SymTableNode));
+      if (oSymTable->oArena == NULL) {
+         free(oSymTable);
+         return NULL;
+      }
+   }
+
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
+
+   oSymTable->iReorder = 0;
+   if (iOptions & SYMTABLE_MOVE_TO_FRONT)
+      oSymTable->iReorder = SYMTABLE_MOVE_TO_FRONT;
+   else if (iOptions & SYMTABLE_TRANSPOSE)
+      oSymTable->iReorder = SYMTABLE_TRANSPOSE;
+
    oSymTable->psFirstNode = NULL;
    oSymTable->nodeCount = 0;
+   oSymTable->uVersion = 0;
+   oSymTable->uHits = 0;
+   oSymTable->uHitProbes = 0;
+   oSymTable->uMisses = 0;
+   oSymTable->uMissProbes = 0;
    return oSymTable;
 }
 
+/* A list needs no room set aside for its bindings, so uCapacity is
+   accepted only for portability with the hash table implementations. */
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   (void)uCapacity;
+   return SymTable_newWithOptions(0);
+}
+
+/* Returns a new SymTableNode holding a copy of the uLength characters
+   at pcKey followed by '\0', or pcKey itself if oSymTable borrows
+   keys, or NULL if insufficient memory is available. Short keys are
+   copied into the node itself; longer ones into oSymTable's Arena if
+   it has one. The caller fills in the node's other fields but
+   uLength. */
+static struct SymTableNode *SymTable_newNode(SymTable_T oSymTable,
+                                             const char *pcKey,
+                                             size_t uLength) {
+   struct SymTableNode *psNewNode;
+   char *pcTempKey;
+
+   if (oSymTable->oArena != NULL)
+      psNewNode = (struct SymTableNode*)Arena_alloc(oSymTable->oArena);
+   else
+      psNewNode = (struct SymTableNode*)malloc(sizeof(struct SymTableNode));
+   if (psNewNode == NULL) 
+      return NULL;
+   psNewNode->uLength = uLength;
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      psNewNode->pcKey = pcKey;
+      return psNewNode;
+   }
+
+   if (uLength < SHORT_KEY_SIZE) {
+      memcpy(psNewNode->acShortKey, pcKey, uLength);
+      psNewNode->acShortKey[uLength] = '\0';
+      psNewNode->pcKey = psNewNode->acShortKey;
+      return psNewNode;
+   }
+
+   if (oSymTable->oArena != NULL)
+      pcTempKey = Arena_copyString(oSymTable->oArena, pcKey, uLength);
+   else {
+      pcTempKey = malloc(uLength + 1);
+      if (pcTempKey != NULL) {
+         memcpy(pcTempKey, pcKey, uLength);
+         pcTempKey[uLength] = '\0';
+      }
+   }
+   if (pcTempKey == NULL) {
+      if (oSymTable->oArena != NULL)
+         Arena_release(oSymTable->oArena, psNewNode);
+      else
+         free(psNewNode);
+      return NULL;
+   }
+
+   psNewNode->pcKey = pcTempKey;
+   return psNewNode;
+}
+
+/* Frees psNode, which came from SymTable_newNode on oSymTable, along
+   with its key. */
+static void SymTable_freeNode(SymTable_T oSymTable,
+                              struct SymTableNode *psNode) {
+   if (oSymTable->oArena != NULL) {
+      Arena_release(oSymTable->oArena, psNode);
+      return;
+   }
+   if (psNode->pcKey != psNode->acShortKey && !oSymTable->iBorrowedKeys)
+      free((char*)psNode->pcKey);
+   free(psNode);
+}
+
 void SymTable_free(SymTable_T oSymTable) {
    struct SymTableNode *psCurrentNode;
    struct SymTableNode *psNextNode;
 
    assert(oSymTable != NULL);
 
+   /* An Arena releases all nodes and keys at once */
+   if (oSymTable->oArena != NULL) {
+      Arena_free(oSymTable->oArena);
+      free(oSymTable);
+      return;
+   }
+
    for (psCurrentNode = oSymTable->psFirstNode;
         psCurrentNode != NULL;
         psCurrentNode = psNextNode)
    {
       psNextNode = psCurrentNode->psNextNode;
-      free((char*)(psCurrentNode->pcKey));
+      if (psCurrentNode->pcKey != psCurrentNode->acShortKey &&
+          !oSymTable->iBorrowedKeys)
+         free((char*)(psCurrentNode->pcKey));
       free(psCurrentNode);
       psCurrentNode = NULL;
    }
@@ -67,36 +296,159 @@ size_t SymTable_getLength(SymTable_T oSymTable) {
    return oSymTable->nodeCount;
 }
 
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   assert(oSymTable != NULL);
+
+   /* Only an Arena can set memory aside ahead of time */
+   if (oSymTable->oArena != NULL && uCapacity > oSymTable->nodeCount)
+      return Arena_reserve(oSymTable->oArena,
+                           uCapacity - oSymTable->nodeCount);
+   return 1;
+}
+
+/* A list holds no memory beyond its bindings, so there is nothing to
+   compact. */
+void SymTable_compact(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+   (void)oSymTable;
+}
+
+/* The whole list is one bucket, and it never resizes. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct SymTableNode *psNode;
+
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+   psStats->uBindings = oSymTable->nodeCount;
+   psStats->uBuckets = 1;
+   psStats->dLoadFactor = (double)oSymTable->nodeCount;
+   psStats->uMaxChain = oSymTable->nodeCount;
+   if (oSymTable->nodeCount < SYMTABLE_HISTOGRAM_SIZE)
+      psStats->auChains[oSymTable->nodeCount] = 1;
+   else
+      psStats->auChains[SYMTABLE_HISTOGRAM_SIZE - 1] = 1;
+
+   psStats->uBytes = sizeof(struct SymTable);
+   if (oSymTable->oArena != NULL)
+      psStats->uBytes += Arena_bytes(oSymTable->oArena);
+   else {
+      for (psNode = oSymTable->psFirstNode; psNode != NULL;
+           psNode = psNode->psNextNode) {
+         psStats->uBytes += sizeof(struct SymTableNode);
+         if (psNode->pcKey != psNode->acShortKey &&
+             !oSymTable->iBorrowedKeys)
+            psStats->uBytes += psNode->uLength + 1;
+      }
+   }
+
+   psStats->uHits = oSymTable->uHits;
+   psStats->uHitProbes = oSymTable->uHitProbes;
+   psStats->uMisses = oSymTable->uMisses;
+   psStats->uMissProbes = oSymTable->uMissProbes;
+}
+
 int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+/* Adds the binding of the uLength characters at pcKey to pvValue at
+   the front of oSymTable, which must not hold the key already.
+   Returns the new SymTableNode, or NULL if insufficient memory is
+   available. */
+static struct SymTableNode *SymTable_insert(SymTable_T oSymTable,
+                                            const char *pcKey,
+                                            size_t uLength,
+                                            const void *pvValue) {
    struct SymTableNode *psNewNode;
-   char *pcTempKey;
 
+   psNewNode = SymTable_newNode(oSymTable, pcKey, uLength);
+   if (psNewNode == NULL) 
+      return NULL;
+
+   psNewNode->pvValue = pvValue;
+   psNewNode->psNextNode = oSymTable->psFirstNode;
+   oSymTable->psFirstNode = psNewNode;
+
+   oSymTable->nodeCount++;
+   oSymTable->uVersion++;
+   return psNewNode;
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   psNewNode = (struct SymTableNode*)malloc(sizeof(struct SymTableNode));
-   if (psNewNode == NULL) 
+   if (SymTable_findLink(oSymTable, pcKey, uLength) != NULL)
       return 0;
 
-   if (SymTable_contains(oSymTable, pcKey)) {
-      free(psNewNode);
-      return 0;
+   return SymTable_insert(oSymTable, pcKey, uLength, pvValue) != NULL;
+}
+
+/* A list has nothing to size ahead of time, so the bindings are put
+   one at a time. */
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (u = 0; u < uCount; u++) {
+      iSuccessful = SymTable_put(oSymTable, apcKeys[u], apvValues[u]);
+      if (aiResults != NULL) aiResults[u] = iSuccessful;
+      if (iSuccessful) uAdded++;
    }
+   return uAdded;
+}
 
-   pcTempKey = malloc(strlen(pcKey) + 1);
-   if (pcTempKey == NULL) {
-      free(psNewNode);
-      return 0;
+/* A binding that is found is reordered as by SymTable_get; one that
+   is added goes to the front. */
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   struct SymTableNode *psNode;
+   size_t uLength;
+   int iInserted = 0;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uLength = strlen(pcKey);
+   psNode = SymTable_findNode(oSymTable, pcKey, uLength);
+   if (psNode == NULL) {
+      psNode = SymTable_insert(oSymTable, pcKey, uLength, pvDefault);
+      iInserted = psNode != NULL;
    }
 
-   strcpy(pcTempKey, pcKey);
+   if (piInserted != NULL) *piInserted = iInserted;
+   if (psNode == NULL) return NULL;
+   return (void**)&psNode->pvValue;
+}
 
-   psNewNode->pcKey = pcTempKey;
-   psNewNode->pvValue = pvValue;
-   psNewNode->psNextNode = oSymTable->psFirstNode;
-   oSymTable->psFirstNode = psNewNode;
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   void **ppvValue;
 
-   oSymTable->nodeCount++;
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   ppvValue = SymTable_findOrInsert(oSymTable, pcKey, pvDefault,
+                                    piInserted);
+   if (ppvValue == NULL) return 0;
+   if (pfUpdate != NULL)
+      *ppvValue = (*pfUpdate)(pcKey, *ppvValue, (void*)pvExtra);
    return 1;
 }
 
@@ -108,87 +460,99 @@ void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvVa
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
    
-   tempNode = oSymTable->psFirstNode;
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) {
-         tempValue = tempNode->pvValue;
-         tempNode->pvValue = pvValue;
-         return (void *) tempValue;
-      }
-      tempNode = tempNode->psNextNode;
-   }
-   return NULL; 
+   tempNode = SymTable_findNode(oSymTable, pcKey, strlen(pcKey));
+   if (tempNode == NULL) return NULL;
+
+   tempValue = tempNode->pvValue;
+   tempNode->pvValue = pvValue;
+   return (void *) tempValue;
 }
 
 int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
-   struct SymTableNode *tempNode;
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   tempNode = oSymTable->psFirstNode;
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) {
-         return 1;
-      }
-      tempNode = tempNode->psNextNode;
-   }
-   
-   return 0;
+   return SymTable_findNode(oSymTable, pcKey, strlen(pcKey)) != NULL;
+}
+
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_findNode(oSymTable, pcKey, uLength) != NULL;
 }
 
 void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
    struct SymTableNode *tempNode;
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   tempNode = oSymTable->psFirstNode;
-   while (tempNode != NULL) {
-      if(strcmp(tempNode->pcKey, pcKey) == 0) return (void*) tempNode->pvValue;
-      tempNode = tempNode->psNextNode;
-   }
-   return NULL;
+   tempNode = SymTable_findNode(oSymTable, pcKey, uLength);
+   if (tempNode == NULL) return NULL;
+   return (void*) tempNode->pvValue;
 }
 
-void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
+/* A list gains nothing from batching, so the keys are looked up one
+   at a time. */
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   struct SymTableNode *psNode;
+   size_t u;
+   size_t uFound = 0;
 
-   struct SymTableNode *tempNode_current;
-   struct SymTableNode *tempNode_next;
-   const void *tempValue;
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (u = 0; u < uCount; u++) {
+      assert(apcKeys[u] != NULL);
+      psNode = SymTable_findNode(oSymTable, apcKeys[u],
+                                 strlen(apcKeys[u]));
+      if (psNode != NULL) {
+         apvValues[u] = (void*)psNode->pvValue;
+         uFound++;
+      }
+      else
+         apvValues[u] = NULL;
+   }
+   return uFound;
+}
 
+void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
    assert(oSymTable != NULL);
    assert(pcKey != NULL);
 
-   if (SymTable_contains(oSymTable, pcKey) != 1) return NULL;
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
 
-   tempNode_current = oSymTable->psFirstNode;
-   tempNode_next = tempNode_current->psNextNode;
-   if (strcmp(tempNode_current->pcKey, pcKey) == 0) {
-      oSymTable->psFirstNode = tempNode_next;
-      tempValue = tempNode_current->pvValue;
-      free((char*)tempNode_current->pcKey);
-      free(tempNode_current);
-      tempNode_current = NULL;
-      oSymTable->nodeCount--;
-      return (void *) tempValue;
-   }
-    
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct SymTableNode *psNode;
+   struct SymTableNode **link;
+   const void *tempValue;
 
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
 
-   while (tempNode_next != NULL) {
-      if(strcmp(tempNode_next->pcKey, pcKey) == 0) {
-         tempValue = tempNode_next->pvValue;
-         tempNode_current->psNextNode = (struct SymTableNode *) tempNode_next->psNextNode;
-         free((char*)tempNode_next->pcKey);
-         free(tempNode_next);
-         tempNode_next = NULL;
-         oSymTable->nodeCount--;
-         return (void *) tempValue;
-      }
-      tempNode_current = tempNode_next;
-      tempNode_next = tempNode_current->psNextNode;
-   }
+   link = SymTable_findLink(oSymTable, pcKey, uLength);
+   if (link == NULL) return NULL;
 
-   return NULL;
+   psNode = *link;
+   *link = psNode->psNextNode;
+   tempValue = psNode->pvValue;
+   SymTable_freeNode(oSymTable, psNode);
+   oSymTable->nodeCount--;
+   oSymTable->uVersion++;
+   return (void *) tempValue;
 }
 
 /* ADD COMMENT HERE */
@@ -205,4 +569,75 @@ void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void
    }
     
 
-}
\ No newline at end of file
+}
+
+/* A list cannot be split without walking it, so the bindings are
+   visited on the calling thread alone. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   assert(iThreads > 0);
+   (void)iThreads;
+   SymTable_map(oSymTable, pfApply, pvExtra);
+}
+
+size_t SymTable_mapWorker(void) {
+   return 0;
+}
+
+/* uIndex is 1 (TRUE) once the iterator has left its starting
+   position, and pvPosition is the SymTableNode it is at. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = NULL;
+   psIter->uIndex = 0;
+   psIter->uVersion = oSymTable->uVersion;
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   const struct SymTableNode *psNode;
+
+   assert(psIter != NULL);
+
+   if (psIter->uVersion != psIter->oSymTable->uVersion)
+      psIter->iStale = 1;
+   if (psIter->iStale) return 0;
+
+   if (! psIter->uIndex)
+      psNode = psIter->oSymTable->psFirstNode;
+   else if (psIter->pvPosition != NULL)
+      psNode = ((const struct SymTableNode*)psIter->pvPosition)->psNextNode;
+   else
+      return 0;
+   psIter->uIndex = 1;
+
+   psIter->pvPosition = psNode;
+   if (psNode == NULL) return 0;
+   psIter->pcKey = psNode->pcKey;
+   psIter->pvValue = (void*)psNode->pvValue;
+   return 1;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
@@ -0,0 +1,934 @@
+/* Module defining a number of symbol table functions using an
+   open-addressing hash table with Robin Hood probing. */
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "symtable.h"
+#include "arena.h"
+#include "keyhash.h"
+#include "parallel.h"
+
+/* The number of slots in a new SymTable. Must be a power of two. */
+enum {INITIAL_SLOT_COUNT = 512};
+
+/* The slot array grows once more than MAX_LOAD_NUMERATOR /
+   MAX_LOAD_DENOMINATOR of its slots are occupied. */
+enum {MAX_LOAD_NUMERATOR = 7, MAX_LOAD_DENOMINATOR = 8};
+
+/* The number of bits in a size_t. */
+enum {SIZE_BITS = sizeof(size_t) * 8};
+
+/* Multiplier that spreads a hash over the high bits of a size_t
+   (2^64, or 2^32 where keyhash.h mixes 32-bit words, divided by the
+   golden ratio). The fast hash policy does not need this, but linear
+   probing with the legacy hash does. */
+#if KEYHASH_WORD_BITS == 64
+static const size_t GOLDEN_MULTIPLIER = (size_t)0x9E3779B97F4A7C15UL;
+#else
+static const size_t GOLDEN_MULTIPLIER = (size_t)0x9E3779B9UL;
+#endif
+
+/* The number of keys that SymTable_putMany and SymTable_getMany hash
+   ahead of using them, so that the loads of their home slots
+   overlap. */
+enum {BATCH_SIZE = 32};
+
+/* Hints that the memory at address pv will be read soon. */
+#ifdef __GNUC__
+#define SymTable_prefetch(pv) __builtin_prefetch(pv)
+#else
+#define SymTable_prefetch(pv) ((void)(pv))
+#endif
+
+/* Each key-value binding is stored in a Slot. All Slots live in one
+   contiguous array, and a Slot whose pcKey is NULL is empty. */
+struct Slot
+{
+   /* The binding's key. */
+   const char *pcKey;
+
+   /* The binding's value. */
+   const void *pvValue;
+
+   /* The full hash of the binding's key. */
+   size_t uHash;
+
+   /* The number of characters in the binding's key, so that keys of
+      other lengths are passed over without being read. It also makes
+      a Slot 32 bytes, so that no Slot straddles two cache lines. */
+   size_t uLength;
+};
+
+/* A SymTable tracks an array of Slots in which every binding sits as
+   close as possible to the slot its hash selects. */
+struct SymTable
+{
+   /* The address of the first element of the array of Slots. */
+   struct Slot *slots;
+
+   /* The number of Slots in the array. Always a power of two. */
+   size_t slotCount;
+
+   /* The number of bindings in the SymTable. */
+   size_t nodeCount;
+
+   /* How far to shift a scrambled hash right to get a slot index. */
+   unsigned int uShift;
+
+   /* Mixed into every key's hash before it is scrambled, so that each
+      SymTable places keys in an order of its own. Otherwise putting
+      the bindings of one SymTable into a smaller one, in the order
+      SymTable_map gives, would pile them into one long run of slots.
+      Chosen when the SymTable is created and kept when it resizes. */
+   size_t uSeed;
+
+   /* The Arena that key copies come from, or NULL if they come from
+      malloc. */
+   Arena_T oArena;
+
+   /* 1 (TRUE) if Slots point to their callers' keys instead of to
+      copies, or 0 (FALSE) otherwise. */
+   int iBorrowedKeys;
+
+   /* Changed whenever a binding is added, removed or moved, so that
+      iterators can tell that they are stale. */
+   size_t uVersion;
+
+   /* The resizes since the SymTable was created, and those that found
+      insufficient memory. */
+   size_t uResizes;
+   size_t uFailedResizes;
+
+   /* Lookups that found their key and the slots they examined, and
+      lookups that did not and theirs, counted only if SYMTABLE_STATS
+      is defined. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
+};
+
+/* Counts, for SymTable_getStats, a lookup in oSymTable that examined
+   uProbes slots and found its key if iFound is 1 (TRUE). Compiles to
+   nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)((iFound) ? ((oSymTable)->uHits++,                          \
+                       (oSymTable)->uHitProbes += (uProbes))          \
+                    : ((oSymTable)->uMisses++,                        \
+                       (oSymTable)->uMissProbes += (uProbes))))
+#else
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)(oSymTable), (void)(iFound), (void)(uProbes))
+#endif
+
+/* Calculates and returns the hash of the uLength characters at
+   pcKey, mixed with oSymTable's seed. */
+static size_t SymTable_hash(SymTable_T oSymTable, const char *pcKey,
+                            size_t uLength)
+{
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return KeyHash_hash(pcKey, uLength) ^ oSymTable->uSeed;
+}
+
+/* Returns the index of the slot that hash uHash selects in a slot
+   array whose index bits are selected by uShift. */
+static size_t SymTable_home(size_t uHash, unsigned int uShift)
+{
+   return (uHash * GOLDEN_MULTIPLIER) >> uShift;
+}
+
+/* Returns how many slots past its home slot the binding in slot
+   uIndex of an array of slotCount slots is. */
+static size_t SymTable_distance(const struct Slot *psSlot, size_t uIndex,
+                                size_t slotCount, unsigned int uShift)
+{
+   return (uIndex - SymTable_home(psSlot->uHash, uShift))
+      & (slotCount - 1);
+}
+
+/* Places the binding pcKey-pvValue, whose key has uLength characters
+   and hash uHash, into the array of slotCount slots, starting at slot
+   uIndex, which is uDistance slots past the binding's home slot, and
+   displacing bindings that sit closer to their home slot than the new
+   binding would. Every slot before uIndex must be one that a probe for
+   the key passes over. The key must not already be in the array, and
+   the array must have at least one empty slot. Returns the index of
+   the slot that the new binding went into. */
+static size_t SymTable_insertFrom(struct Slot *slots, size_t slotCount,
+                                  unsigned int uShift, const char *pcKey,
+                                  size_t uLength, const void *pvValue,
+                                  size_t uHash, size_t uIndex,
+                                  size_t uDistance)
+{
+   struct Slot sEntry;
+   struct Slot sTemp;
+   size_t uExisting;
+   size_t uPlaced = slotCount;
+
+   sEntry.pcKey = pcKey;
+   sEntry.pvValue = pvValue;
+   sEntry.uHash = uHash;
+   sEntry.uLength = uLength;
+
+   for (;;) {
+      if (slots[uIndex].pcKey == NULL) {
+         slots[uIndex] = sEntry;
+         return uPlaced == slotCount ? uIndex : uPlaced;
+      }
+      uExisting = SymTable_distance(&slots[uIndex], uIndex, slotCount,
+                                    uShift);
+      if (uExisting < uDistance) {
+         if (uPlaced == slotCount) uPlaced = uIndex;
+         sTemp = slots[uIndex];
+         slots[uIndex] = sEntry;
+         sEntry = sTemp;
+         uDistance = uExisting;
+      }
+      uIndex = (uIndex + 1) & (slotCount - 1);
+      uDistance++;
+   }
+}
+
+/* Places the binding pcKey-pvValue as SymTable_insertFrom does,
+   starting from the binding's home slot. */
+static size_t SymTable_insert(struct Slot *slots, size_t slotCount,
+                              unsigned int uShift, const char *pcKey,
+                              size_t uLength, const void *pvValue,
+                              size_t uHash)
+{
+   return SymTable_insertFrom(slots, slotCount, uShift, pcKey, uLength,
+                              pvValue, uHash,
+                              SymTable_home(uHash, uShift), 0);
+}
+
+/* Returns the index of the slot of oSymTable holding the binding whose
+   key is the uLength characters at pcKey and whose hash is uHash, or
+   slotCount if no such binding exists, in which case sets *puStop to
+   the slot where the probe stopped, where the binding would go, and
+   *puDistance to how far that slot is past the key's home slot. The
+   characters are compared only once the hashes and lengths match. */
+static size_t SymTable_search(SymTable_T oSymTable, const char *pcKey,
+                              size_t uLength, size_t uHash,
+                              size_t *puStop, size_t *puDistance)
+{
+   struct Slot *psSlot;
+   size_t uIndex;
+   size_t uDistance = 0;
+
+   uIndex = SymTable_home(uHash, oSymTable->uShift);
+   for (;;) {
+      psSlot = &oSymTable->slots[uIndex];
+      if (psSlot->pcKey == NULL)
+         break;
+
+      /* Robin Hood order: the key would have displaced this binding */
+      if (SymTable_distance(psSlot, uIndex, oSymTable->slotCount,
+                            oSymTable->uShift) < uDistance)
+         break;
+
+      if (psSlot->uHash == uHash && psSlot->uLength == uLength &&
+          (psSlot->pcKey == pcKey ||
+           memcmp(psSlot->pcKey, pcKey, uLength) == 0)) {
+         SymTable_countLookup(oSymTable, 1, uDistance + 1);
+         return uIndex;
+      }
+
+      uIndex = (uIndex + 1) & (oSymTable->slotCount - 1);
+      uDistance++;
+   }
+   SymTable_countLookup(oSymTable, 0, uDistance + 1);
+   *puStop = uIndex;
+   *puDistance = uDistance;
+   return oSymTable->slotCount;
+}
+
+/* Returns the index of the slot of oSymTable holding the binding whose
+   key is the uLength characters at pcKey and whose hash is uHash, or
+   slotCount if no such binding exists. */
+static size_t SymTable_find(SymTable_T oSymTable, const char *pcKey,
+                            size_t uLength, size_t uHash)
+{
+   size_t uStop;
+   size_t uDistance;
+
+   return SymTable_search(oSymTable, pcKey, uLength, uHash, &uStop,
+                          &uDistance);
+}
+
+/* Returns the shift that selects a slot index from a scrambled hash
+   in an array of slotCount slots. */
+static unsigned int SymTable_shiftFor(size_t slotCount)
+{
+   unsigned int uShift = SIZE_BITS;
+
+   for (; slotCount > 1; slotCount /= 2)
+      uShift--;
+   return uShift;
+}
+
+/* Returns the smallest slot count that holds uCapacity bindings
+   without exceeding the maximum load, or 0 if no slot array can be
+   that large. */
+static size_t SymTable_sizeFor(size_t uCapacity)
+{
+   size_t slotCount = INITIAL_SLOT_COUNT;
+
+   while (slotCount / MAX_LOAD_DENOMINATOR * MAX_LOAD_NUMERATOR
+          < uCapacity) {
+      if (slotCount > (size_t)-1 / 2 / sizeof(struct Slot))
+         return 0;
+      slotCount *= 2;
+   }
+   return slotCount;
+}
+
+/* Moves every binding of oSymTable into a new array of newCount
+   slots. Returns 1 (TRUE) if successful, or 0 (FALSE) if insufficient
+   memory is available, in which case oSymTable is left unchanged. */
+static int SymTable_resize(SymTable_T oSymTable, size_t newCount) {
+   struct Slot *slots;
+   size_t uIndex;
+   unsigned int uShift;
+
+   uShift = SymTable_shiftFor(newCount);
+
+   slots = calloc(newCount, sizeof(struct Slot));
+   if (slots == NULL) {
+      oSymTable->uFailedResizes++;
+      return 0;
+   }
+
+   for (uIndex = 0; uIndex < oSymTable->slotCount; uIndex++) {
+      if (oSymTable->slots[uIndex].pcKey != NULL)
+         (void)SymTable_insert(slots, newCount, uShift,
+                         oSymTable->slots[uIndex].pcKey,
+                         oSymTable->slots[uIndex].uLength,
+                         oSymTable->slots[uIndex].pvValue,
+                         oSymTable->slots[uIndex].uHash);
+   }
+
+   free(oSymTable->slots);
+   oSymTable->slots = slots;
+   oSymTable->slotCount = newCount;
+   oSymTable->uShift = uShift;
+   oSymTable->uVersion++;
+   oSymTable->uResizes++;
+   return 1;
+}
+
+/* Doubles the number of slots in oSymTable. Returns 1 (TRUE) if
+   successful, or 0 (FALSE) if insufficient memory is available, in
+   which case oSymTable is left unchanged. */
+static int SymTable_expand(SymTable_T oSymTable) {
+   if (oSymTable->slotCount > (size_t)-1 / 2 / sizeof(struct Slot))
+      return 0;
+   return SymTable_resize(oSymTable, oSymTable->slotCount * 2);
+}
+
+/* Returns a new SymTable_T object configured by iOptions and with
+   slotCount slots, or NULL if insufficient memory is available. */
+static SymTable_T SymTable_create(int iOptions, size_t slotCount) {
+   SymTable_T oSymTable;
+
+   oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
+   if (oSymTable == NULL) return NULL;
+
+   /* Bindings live in the slot array, so the Arena only holds keys */
+   oSymTable->oArena = NULL;
+   if (iOptions & SYMTABLE_ARENA) {
+      oSymTable->oArena = Arena_new(0);
+      if (oSymTable->oArena == NULL) {
+         free(oSymTable);
+         return NULL;
+      }
+   }
+
+   oSymTable->slots = calloc(slotCount, sizeof(struct Slot));
+   if (oSymTable->slots == NULL) {
+      if (oSymTable->oArena != NULL) Arena_free(oSymTable->oArena);
+      free(oSymTable);
+      return NULL;
+   }
+
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
+   oSymTable->slotCount = slotCount;
+   oSymTable->nodeCount = 0;
+   oSymTable->uShift = SymTable_shiftFor(slotCount);
+   /* No two SymTables that exist at once share an address */
+   oSymTable->uSeed = KeyHash_hash((const char*)&oSymTable,
+                                   sizeof(oSymTable));
+   oSymTable->uVersion = 0;
+   oSymTable->uResizes = 0;
+   oSymTable->uFailedResizes = 0;
+   oSymTable->uHits = 0;
+   oSymTable->uHitProbes = 0;
+   oSymTable->uMisses = 0;
+   oSymTable->uMissProbes = 0;
+   return oSymTable;
+}
+
+/* Returns a copy of the uLength characters at pcKey followed by '\0',
+   from oSymTable's Arena if it has one, or pcKey itself if oSymTable
+   borrows keys, or NULL if insufficient memory is available. */
+static const char *SymTable_copyKey(SymTable_T oSymTable,
+                                    const char *pcKey, size_t uLength) {
+   char *pcTempKey;
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      return pcKey;
+   }
+
+   if (oSymTable->oArena != NULL)
+      return Arena_copyString(oSymTable->oArena, pcKey, uLength);
+
+   pcTempKey = malloc(uLength + 1);
+   if (pcTempKey != NULL) {
+      memcpy(pcTempKey, pcKey, uLength);
+      pcTempKey[uLength] = '\0';
+   }
+   return pcTempKey;
+}
+
+/* Frees pcKey, which came from SymTable_copyKey on oSymTable, unless
+   its Arena owns it or it was borrowed. */
+static void SymTable_freeKey(SymTable_T oSymTable, const char *pcKey) {
+   if (oSymTable->oArena == NULL && !oSymTable->iBorrowedKeys)
+      free((char*)pcKey);
+}
+
+SymTable_T SymTable_new(void) {
+   return SymTable_create(0, INITIAL_SLOT_COUNT);
+}
+
+SymTable_T SymTable_newWithOptions(int iOptions) {
+   return SymTable_create(iOptions, INITIAL_SLOT_COUNT);
+}
+
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   size_t slotCount;
+
+   slotCount = SymTable_sizeFor(uCapacity);
+   if (slotCount == 0) return NULL;
+   return SymTable_create(0, slotCount);
+}
+
+void SymTable_free(SymTable_T oSymTable) {
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+
+   if (oSymTable->oArena != NULL)
+      Arena_free(oSymTable->oArena);
+   else {
+      for (uIndex = 0; uIndex < oSymTable->slotCount; uIndex++)
+         SymTable_freeKey(oSymTable, oSymTable->slots[uIndex].pcKey);
+   }
+   free(oSymTable->slots);
+   free(oSymTable);
+}
+
+size_t SymTable_getLength(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+   return oSymTable->nodeCount;
+}
+
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   size_t slotCount;
+
+   assert(oSymTable != NULL);
+
+   slotCount = SymTable_sizeFor(uCapacity);
+   if (slotCount == 0) return 0;
+   if (slotCount <= oSymTable->slotCount) return 1;
+   return SymTable_resize(oSymTable, slotCount);
+}
+
+void SymTable_compact(SymTable_T oSymTable) {
+   size_t slotCount;
+
+   assert(oSymTable != NULL);
+
+   slotCount = SymTable_sizeFor(oSymTable->nodeCount);
+   if (slotCount != 0 && slotCount < oSymTable->slotCount)
+      (void)SymTable_resize(oSymTable, slotCount);
+}
+
+/* Adds one chain of uLength slots to the histogram of *psStats. */
+static void SymTable_countChain(struct SymTableStats *psStats,
+                                size_t uLength) {
+   if (uLength > psStats->uMaxChain)
+      psStats->uMaxChain = uLength;
+   if (uLength >= SYMTABLE_HISTOGRAM_SIZE)
+      uLength = SYMTABLE_HISTOGRAM_SIZE - 1;
+   psStats->auChains[uLength]++;
+}
+
+/* Each slot is a bucket, and the chain of a binding is the slots from
+   its home slot to its own. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct Slot *psSlot;
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+   psStats->uBindings = oSymTable->nodeCount;
+   psStats->uBuckets = oSymTable->slotCount;
+   psStats->dLoadFactor = (double)oSymTable->nodeCount
+      / (double)oSymTable->slotCount;
+   psStats->uBytes = sizeof(struct SymTable)
+      + oSymTable->slotCount * sizeof(struct Slot);
+   if (oSymTable->oArena != NULL)
+      psStats->uBytes += Arena_bytes(oSymTable->oArena);
+
+   for (uIndex = 0; uIndex < oSymTable->slotCount; uIndex++) {
+      psSlot = &oSymTable->slots[uIndex];
+      if (psSlot->pcKey == NULL) {
+         SymTable_countChain(psStats, 0);
+         continue;
+      }
+      SymTable_countChain(psStats,
+                          SymTable_distance(psSlot, uIndex,
+                                            oSymTable->slotCount,
+                                            oSymTable->uShift) + 1);
+      if (oSymTable->oArena == NULL && !oSymTable->iBorrowedKeys)
+         psStats->uBytes += psSlot->uLength + 1;
+   }
+
+   psStats->uResizes = oSymTable->uResizes;
+   psStats->uFailedResizes = oSymTable->uFailedResizes;
+   psStats->uHits = oSymTable->uHits;
+   psStats->uHitProbes = oSymTable->uHitProbes;
+   psStats->uMisses = oSymTable->uMisses;
+   psStats->uMissProbes = oSymTable->uMissProbes;
+}
+
+int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+/* Returns the index of the slot of oSymTable holding the binding
+   whose key is the uLength characters at pcKey, first adding the
+   binding of that key to pvValue if there is none, or the slot count
+   if insufficient memory is available to add it. Sets *piInserted to
+   1 (TRUE) if the binding was added, or to 0 (FALSE) otherwise. A
+   missing key is added where the probe for it stopped, so it takes a
+   single probe, unless the table must grow first. */
+static size_t SymTable_findOrAdd(SymTable_T oSymTable, const char *pcKey,
+                                 size_t uLength, const void *pvValue,
+                                 int *piInserted) {
+   const char *pcTempKey;
+   size_t uHash;
+   size_t uIndex;
+   size_t uStop;
+   size_t uDistance;
+
+   *piInserted = 0;
+   uHash = SymTable_hash(oSymTable, pcKey, uLength);
+   uIndex = SymTable_search(oSymTable, pcKey, uLength, uHash, &uStop,
+                            &uDistance);
+   if (uIndex != oSymTable->slotCount)
+      return uIndex;
+
+   /* Grow before the insertion would exceed the maximum load; keep
+      going at a higher load if memory is short but a slot is free.
+      Growing moves every binding, so the probe starts over */
+   if ((oSymTable->nodeCount + 1) * MAX_LOAD_DENOMINATOR >
+       oSymTable->slotCount * MAX_LOAD_NUMERATOR) {
+      if (SymTable_expand(oSymTable)) {
+         uStop = SymTable_home(uHash, oSymTable->uShift);
+         uDistance = 0;
+      }
+      else if (oSymTable->nodeCount + 1 == oSymTable->slotCount)
+         return oSymTable->slotCount;
+   }
+
+   pcTempKey = SymTable_copyKey(oSymTable, pcKey, uLength);
+   if (pcTempKey == NULL)
+      return oSymTable->slotCount;
+
+   uIndex = SymTable_insertFrom(oSymTable->slots, oSymTable->slotCount,
+                                oSymTable->uShift, pcTempKey, uLength,
+                                pvValue, uHash, uStop, uDistance);
+   oSymTable->nodeCount++;
+   oSymTable->uVersion++;
+   *piInserted = 1;
+   return uIndex;
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)SymTable_findOrAdd(oSymTable, pcKey, uLength, pvValue,
+                            &iInserted);
+   return iInserted;
+}
+
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   size_t uIndex;
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uIndex = SymTable_findOrAdd(oSymTable, pcKey, strlen(pcKey),
+                               pvDefault, &iInserted);
+   if (piInserted != NULL) *piInserted = iInserted;
+   if (uIndex == oSymTable->slotCount) return NULL;
+   return (void**)&oSymTable->slots[uIndex].pvValue;
+}
+
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   void **ppvValue;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   ppvValue = SymTable_findOrInsert(oSymTable, pcKey, pvDefault,
+                                    piInserted);
+   if (ppvValue == NULL) return 0;
+   if (pfUpdate != NULL)
+      *ppvValue = (*pfUpdate)(pcKey, *ppvValue, (void*)pvExtra);
+   return 1;
+}
+
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t auHash[BATCH_SIZE];
+   size_t auLength[BATCH_SIZE];
+   const char *pcTempKey;
+   size_t uStart;
+   size_t uBatch;
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   /* Decide on growth once for the whole batch. Without the memory
+      for that, put the bindings one at a time, growing as they go. */
+   if (uCount > (size_t)-1 - oSymTable->nodeCount ||
+       !SymTable_reserve(oSymTable, oSymTable->nodeCount + uCount)) {
+      for (u = 0; u < uCount; u++) {
+         iSuccessful = SymTable_put(oSymTable, apcKeys[u], apvValues[u]);
+         if (aiResults != NULL) aiResults[u] = iSuccessful;
+         if (iSuccessful) uAdded++;
+      }
+      return uAdded;
+   }
+
+   for (uStart = 0; uStart < uCount; uStart += uBatch) {
+      uBatch = uCount - uStart;
+      if (uBatch > BATCH_SIZE) uBatch = BATCH_SIZE;
+
+      /* Hash the whole group first, so that its slot loads are in
+         flight together */
+      for (u = 0; u < uBatch; u++) {
+         assert(apcKeys[uStart + u] != NULL);
+         auLength[u] = strlen(apcKeys[uStart + u]);
+         auHash[u] = SymTable_hash(oSymTable, apcKeys[uStart + u],
+                                   auLength[u]);
+         SymTable_prefetch(&oSymTable->slots[
+            SymTable_home(auHash[u], oSymTable->uShift)]);
+      }
+
+      for (u = 0; u < uBatch; u++) {
+         iSuccessful = 0;
+         if (SymTable_find(oSymTable, apcKeys[uStart + u], auLength[u],
+                           auHash[u]) == oSymTable->slotCount) {
+            pcTempKey = SymTable_copyKey(oSymTable, apcKeys[uStart + u],
+                                         auLength[u]);
+            if (pcTempKey != NULL) {
+               (void)SymTable_insert(oSymTable->slots, oSymTable->slotCount,
+                               oSymTable->uShift, pcTempKey, auLength[u],
+                               apvValues[uStart + u], auHash[u]);
+               oSymTable->nodeCount++;
+               oSymTable->uVersion++;
+               iSuccessful = 1;
+            }
+         }
+         if (aiResults != NULL) aiResults[uStart + u] = iSuccessful;
+         if (iSuccessful) uAdded++;
+      }
+   }
+   return uAdded;
+}
+
+void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   size_t uIndex;
+   size_t uLength;
+   const void *tempValue;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uLength = strlen(pcKey);
+   uIndex = SymTable_find(oSymTable, pcKey, uLength,
+                          SymTable_hash(oSymTable, pcKey, uLength));
+   if (uIndex == oSymTable->slotCount) return NULL;
+
+   tempValue = oSymTable->slots[uIndex].pvValue;
+   oSymTable->slots[uIndex].pvValue = pvValue;
+   return (void *) tempValue;
+}
+
+int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_containsN(oSymTable, pcKey, strlen(pcKey));
+}
+
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_find(oSymTable, pcKey, uLength,
+                        SymTable_hash(oSymTable, pcKey, uLength))
+      != oSymTable->slotCount;
+}
+
+void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uIndex = SymTable_find(oSymTable, pcKey, uLength,
+                          SymTable_hash(oSymTable, pcKey, uLength));
+   if (uIndex == oSymTable->slotCount) return NULL;
+   return (void*) oSymTable->slots[uIndex].pvValue;
+}
+
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   size_t auHash[BATCH_SIZE];
+   size_t auLength[BATCH_SIZE];
+   size_t uIndex;
+   size_t uStart;
+   size_t uBatch;
+   size_t u;
+   size_t uFound = 0;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (uStart = 0; uStart < uCount; uStart += uBatch) {
+      uBatch = uCount - uStart;
+      if (uBatch > BATCH_SIZE) uBatch = BATCH_SIZE;
+
+      /* Start loading every home slot of the group before probing */
+      for (u = 0; u < uBatch; u++) {
+         assert(apcKeys[uStart + u] != NULL);
+         auLength[u] = strlen(apcKeys[uStart + u]);
+         auHash[u] = SymTable_hash(oSymTable, apcKeys[uStart + u],
+                                   auLength[u]);
+         SymTable_prefetch(&oSymTable->slots[
+            SymTable_home(auHash[u], oSymTable->uShift)]);
+      }
+
+      for (u = 0; u < uBatch; u++) {
+         uIndex = SymTable_find(oSymTable, apcKeys[uStart + u],
+                                auLength[u], auHash[u]);
+         if (uIndex == oSymTable->slotCount)
+            apvValues[uStart + u] = NULL;
+         else {
+            apvValues[uStart + u] = (void*)oSymTable->slots[uIndex].pvValue;
+            uFound++;
+         }
+      }
+   }
+   return uFound;
+}
+
+void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct Slot *slots;
+   size_t uIndex;
+   size_t uNext;
+   size_t mask;
+   const void *tempValue;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uIndex = SymTable_find(oSymTable, pcKey, uLength,
+                          SymTable_hash(oSymTable, pcKey, uLength));
+   if (uIndex == oSymTable->slotCount) return NULL;
+
+   slots = oSymTable->slots;
+   mask = oSymTable->slotCount - 1;
+   tempValue = slots[uIndex].pvValue;
+   SymTable_freeKey(oSymTable, slots[uIndex].pcKey);
+
+   /* Shift the rest of the run back one slot so that no tombstone is
+      needed */
+   uNext = (uIndex + 1) & mask;
+   while (slots[uNext].pcKey != NULL &&
+          SymTable_distance(&slots[uNext], uNext, oSymTable->slotCount,
+                            oSymTable->uShift) != 0) {
+      slots[uIndex] = slots[uNext];
+      uIndex = uNext;
+      uNext = (uNext + 1) & mask;
+   }
+   slots[uIndex].pcKey = NULL;
+
+   oSymTable->nodeCount--;
+   oSymTable->uVersion++;
+   return (void *) tempValue;
+}
+
+void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra) {
+   struct Slot *psSlot;
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+
+   for (uIndex = 0; uIndex < oSymTable->slotCount; uIndex++) {
+      psSlot = &oSymTable->slots[uIndex];
+      if (psSlot->pcKey != NULL)
+         (*pfApply)(psSlot->pcKey, (void*)psSlot->pvValue, (void*)pvExtra);
+   }
+}
+
+/* The number of slots that a thread of SymTable_mapParallel takes at
+   a time. */
+enum {MAP_CHUNK_SIZE = 4096};
+
+/* What each thread of SymTable_mapParallel needs. */
+struct MapWork
+{
+   SymTable_T oSymTable;
+   void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra);
+   void *pvExtra;
+};
+
+/* Applies the MapWork at pvWork to slots uFirst to uLimit - 1. */
+static void SymTable_mapChunk(size_t uFirst, size_t uLimit,
+                              void *pvWork) {
+   struct MapWork *psWork = (struct MapWork*)pvWork;
+   struct Slot *psSlot;
+   size_t uIndex;
+
+   for (uIndex = uFirst; uIndex < uLimit; uIndex++) {
+      psSlot = &psWork->oSymTable->slots[uIndex];
+      if (psSlot->pcKey != NULL)
+         (*psWork->pfApply)(psSlot->pcKey, (void*)psSlot->pvValue,
+                            psWork->pvExtra);
+   }
+}
+
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   struct MapWork sWork;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+   assert(iThreads > 0);
+
+   sWork.oSymTable = oSymTable;
+   sWork.pfApply = pfApply;
+   sWork.pvExtra = (void*)pvExtra;
+   Parallel_run(oSymTable->slotCount, MAP_CHUNK_SIZE,
+                SymTable_mapChunk, &sWork, iThreads);
+}
+
+size_t SymTable_mapWorker(void) {
+   return Parallel_worker();
+}
+
+/* uIndex is the next slot to look in. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = NULL;
+   psIter->uIndex = 0;
+   psIter->uVersion = oSymTable->uVersion;
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   SymTable_T oSymTable;
+   const struct Slot *psSlot;
+
+   assert(psIter != NULL);
+
+   oSymTable = psIter->oSymTable;
+   if (psIter->uVersion != oSymTable->uVersion)
+      psIter->iStale = 1;
+   if (psIter->iStale) return 0;
+
+   while (psIter->uIndex < oSymTable->slotCount) {
+      psSlot = &oSymTable->slots[psIter->uIndex++];
+      if (psSlot->pcKey != NULL) {
+         psIter->pcKey = psSlot->pcKey;
+         psIter->pvValue = (void*)psSlot->pvValue;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
@@ -0,0 +1,28 @@
+/* Interface for ordered Symbol Table functions */
+#ifndef SYMORDERED_INCLUDED
+#define SYMORDERED_INCLUDED
+#include "symtable.h"
+
+/* These functions are offered only by implementations that keep
+   their bindings sorted by key, such as symtabletree.c, in which
+   SymTable_map and SymTable_iterNext also visit bindings in key order.
+   Keys are ordered as strcmp orders them. */
+
+/* Calls (*pfApply) for each binding of oSymTable whose key is no less
+   than pcLow and less than pcHigh, in key order, passing pvExtra as an
+   extra parameter. A NULL pcLow or pcHigh leaves that end of the range
+   open. (*pfApply) must not change oSymTable. */
+void SymTable_mapRange(SymTable_T oSymTable, const char *pcLow,
+                       const char *pcHigh,
+                       void (*pfApply)(const char *pcKey, void *pvValue,
+                                       void *pvExtra),
+                       const void *pvExtra);
+
+/* Calls (*pfApply) for each binding of oSymTable whose key begins with
+   pcPrefix, in key order, passing pvExtra as an extra parameter.
+   (*pfApply) must not change oSymTable. */
+void SymTable_mapPrefix(SymTable_T oSymTable, const char *pcPrefix,
+                        void (*pfApply)(const char *pcKey, void *pvValue,
+                                        void *pvExtra),
+                        const void *pvExtra);
+#endif
@@ -0,0 +1,1103 @@
+/* Module defining a number of symbol table functions using a hash
+   table for read-mostly use by several threads. Lookups take no locks
+   and perform no atomic read-modify-write operations, so they scale
+   with the number of threads; puts, replaces and removes take one
+   lock per table. Memory that a lookup may still be reading is freed
+   only after epoch-based reclamation shows that it is unreachable. */
+
+/* For pthread_mutex_t */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "symtable.h"
+#include "keyhash.h"
+#include "epoch.h"
+#include "parallel.h"
+
+/* Loads the pointer at pp, seeing everything written before it was
+   stored by SymTable_publish. */
+#define SymTable_load(pp) __atomic_load_n(pp, __ATOMIC_ACQUIRE)
+
+/* Stores pointer p at pp, after everything written before it. */
+#define SymTable_publish(pp, p) __atomic_store_n(pp, p, __ATOMIC_RELEASE)
+
+/* The number of buckets in a new SymTable. Bucket counts are powers
+   of two, so a bucket number is the low bits of the full hash. */
+enum {INITIAL_BUCKET_COUNT = 512};
+
+/* Keys shorter than this many characters are stored inline in their
+   node instead of in a separate allocation. */
+enum {SHORT_KEY_SIZE = 24};
+
+/* Each key-value binding is stored in a BucketNode. BucketNodes
+   are placed in buckets to form lists. Only pvValue and psNextNode
+   change once a BucketNode is published. */
+struct BucketNode
+{
+   /* The binding's key. */
+   const char *pcKey;
+
+   /* The binding's value. */
+   const void *pvValue;
+
+   /* The full hash of the binding's key, before it is reduced to a
+      bucket number. */
+   size_t uHash;
+
+   /* The number of characters in the binding's key, so that keys of
+      other lengths are passed over without being read. */
+   size_t uLength;
+
+   /* The address of the next BucketNode. */
+   struct BucketNode *psNextNode;
+
+   /* Once the BucketNode is removed, the address of the next removed
+      BucketNode waiting to be freed. */
+   struct BucketNode *psRetiredNode;
+
+   /* Once the BucketNode is removed, the epoch Epoch_retire gave. */
+   size_t uRetireEpoch;
+
+   /* Storage for the key, if it is shorter than SHORT_KEY_SIZE, so
+      that comparing it touches no memory outside the node. */
+   char acShortKey[SHORT_KEY_SIZE];
+};
+
+/* A BucketArray is a hash table together with its size, so that a
+   lookup gets both from one load. */
+struct BucketArray
+{
+   /* The number of buckets. */
+   size_t uSize;
+
+   /* Once the BucketArray is replaced by a resize, the address of the
+      next replaced BucketArray waiting to be freed. */
+   struct BucketArray *psRetiredArray;
+
+   /* Once the BucketArray is replaced, the epoch Epoch_retire gave. */
+   size_t uRetireEpoch;
+
+   /* The buckets; the array really has uSize elements. */
+   struct BucketNode *apsBuckets[1];
+};
+
+/* A SymTable tracks a hash table containing lists of key-value
+   bindings, along with the memory that lookups may still be reading
+   but that nothing else refers to. */
+struct SymTable
+{
+   /* The current hash table. */
+   struct BucketArray *psArray;
+
+   /* The number of bindings in the SymTable. */
+   size_t nodeCount;
+
+   /* Changed whenever a binding is added or removed or the hash table
+      is replaced, before anything unlinked is retired, so that
+      iterators can tell that they are stale. */
+   size_t uVersion;
+
+   /* Held by any thread that changes the SymTable. */
+   pthread_mutex_t writeLock;
+
+   /* 1 (TRUE) if BucketNodes point to their callers' keys instead of
+      to copies, or 0 (FALSE) otherwise. Never changes. */
+   int iBorrowedKeys;
+
+   /* The removed BucketNodes waiting to be freed, newest first. */
+   struct BucketNode *psRetiredNodes;
+
+   /* The replaced BucketArrays waiting to be freed, newest first.
+      Their BucketNodes are copies whose keys belong to newer ones. */
+   struct BucketArray *psRetiredArrays;
+
+   /* The resizes since the SymTable was created, and those that found
+      insufficient memory. Guarded by writeLock. */
+   size_t uResizes;
+   size_t uFailedResizes;
+
+   /* Lookups that found their key and the nodes they compared, and
+      lookups that did not and theirs, counted only if SYMTABLE_STATS
+      is defined. Lookups hold no lock, so every update is an atomic
+      read-modify-write, which is why counting is left out by
+      default. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
+};
+
+/* Counts, for SymTable_getStats, a lookup in oSymTable that compared
+   uProbes nodes and found its key if iFound is 1 (TRUE). Compiles to
+   nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_add(pu, u) __atomic_fetch_add(pu, u, __ATOMIC_RELAXED)
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)((iFound) ? (SymTable_add(&(oSymTable)->uHits, 1),          \
+                       SymTable_add(&(oSymTable)->uHitProbes, uProbes)) \
+                    : (SymTable_add(&(oSymTable)->uMisses, 1),        \
+                       SymTable_add(&(oSymTable)->uMissProbes, uProbes))))
+#else
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)(oSymTable), (void)(iFound), (void)(uProbes))
+#endif
+
+/* Calculates and returns the full hash of the uLength characters at
+   pcKey. Mask it with the number of buckets minus one to get a bucket
+   number. */
+static size_t SymTable_hash(const char *pcKey, size_t uLength)
+{
+   assert(pcKey != NULL);
+
+   return KeyHash_hash(pcKey, uLength);
+}
+
+/* Returns the bucket count that follows uSize, or uSize itself if the
+   table cannot grow any further. */
+static size_t SymTable_nextSize(size_t uSize)
+{
+   if (uSize > ((size_t)-1 - sizeof(struct BucketArray))
+               / sizeof(struct BucketNode*) / 2)
+      return uSize;
+   return 2 * uSize;
+}
+
+/* Returns the smallest bucket count that holds uCapacity bindings
+   without expanding, or 0 if no bucket array can be that large. */
+static size_t SymTable_sizeFor(size_t uCapacity)
+{
+   size_t uSize = INITIAL_BUCKET_COUNT;
+
+   while (uSize <= uCapacity) {
+      if (SymTable_nextSize(uSize) == uSize) return 0;
+      uSize = SymTable_nextSize(uSize);
+   }
+   return uSize;
+}
+
+/* Returns a new BucketArray of uSize empty buckets, or NULL if
+   insufficient memory is available. */
+static struct BucketArray *SymTable_newArray(size_t uSize) {
+   struct BucketArray *psArray;
+
+   psArray = (struct BucketArray*)calloc(1,
+      offsetof(struct BucketArray, apsBuckets)
+      + uSize * sizeof(struct BucketNode*));
+   if (psArray == NULL) return NULL;
+
+   psArray->uSize = uSize;
+   return psArray;
+}
+
+/* Returns a new SymTable_T object configured by iOptions and with
+   uBucketCount buckets, or NULL if insufficient memory is
+   available. */
+static SymTable_T SymTable_create(int iOptions, size_t uBucketCount) {
+   SymTable_T oSymTable;
+
+   oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
+   if (oSymTable == NULL) return NULL;
+
+   oSymTable->psArray = SymTable_newArray(uBucketCount);
+   if (oSymTable->psArray == NULL) {
+      free(oSymTable);
+      return NULL;
+   }
+
+   if (pthread_mutex_init(&oSymTable->writeLock, NULL) != 0) {
+      free(oSymTable->psArray);
+      free(oSymTable);
+      return NULL;
+   }
+
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
+   oSymTable->nodeCount = 0;
+   oSymTable->uVersion = 0;
+   oSymTable->psRetiredNodes = NULL;
+   oSymTable->psRetiredArrays = NULL;
+   oSymTable->uResizes = 0;
+   oSymTable->uFailedResizes = 0;
+   oSymTable->uHits = 0;
+   oSymTable->uHitProbes = 0;
+   oSymTable->uMisses = 0;
+   oSymTable->uMissProbes = 0;
+   return oSymTable;
+}
+
+SymTable_T SymTable_new(void) {
+   return SymTable_create(0, INITIAL_BUCKET_COUNT);
+}
+
+/* The Arena of SYMTABLE_ARENA is not safe to share between threads,
+   so this implementation supports only SYMTABLE_BORROWED_KEYS. */
+SymTable_T SymTable_newWithOptions(int iOptions) {
+   return SymTable_create(iOptions, INITIAL_BUCKET_COUNT);
+}
+
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   size_t uSize;
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return NULL;
+   return SymTable_create(0, uSize);
+}
+
+/* Returns a new BucketNode holding a copy of the uLength characters
+   at pcKey followed by '\0', or pcKey itself if oSymTable borrows
+   keys, or NULL if insufficient memory is available. Short keys are
+   copied into the node itself. The caller fills in the node's other
+   fields but uLength. */
+static struct BucketNode *SymTable_newNode(SymTable_T oSymTable,
+                                           const char *pcKey,
+                                           size_t uLength) {
+   struct BucketNode *psNewNode;
+   char *pcTempKey;
+
+   psNewNode = (struct BucketNode*)malloc(sizeof(struct BucketNode));
+   if (psNewNode == NULL)
+      return NULL;
+   psNewNode->uLength = uLength;
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      psNewNode->pcKey = pcKey;
+      return psNewNode;
+   }
+
+   if (uLength < SHORT_KEY_SIZE) {
+      memcpy(psNewNode->acShortKey, pcKey, uLength);
+      psNewNode->acShortKey[uLength] = '\0';
+      psNewNode->pcKey = psNewNode->acShortKey;
+      return psNewNode;
+   }
+
+   pcTempKey = malloc(uLength + 1);
+   if (pcTempKey == NULL) {
+      free(psNewNode);
+      return NULL;
+   }
+   memcpy(pcTempKey, pcKey, uLength);
+   pcTempKey[uLength] = '\0';
+
+   psNewNode->pcKey = pcTempKey;
+   return psNewNode;
+}
+
+/* Frees psNode, which came from SymTable_newNode on oSymTable, along
+   with its key. */
+static void SymTable_freeNode(SymTable_T oSymTable,
+                              struct BucketNode *psNode) {
+   if (psNode->pcKey != psNode->acShortKey && !oSymTable->iBorrowedKeys)
+      free((char*)psNode->pcKey);
+   free(psNode);
+}
+
+/* Frees psArray and every BucketNode in its buckets, along with the
+   nodes' keys if iFreeKeys is 1 (TRUE). */
+static void SymTable_freeArray(struct BucketArray *psArray,
+                               int iFreeKeys) {
+   struct BucketNode *psCurrentNode;
+   struct BucketNode *psNextNode;
+   size_t hash;
+
+   for (hash = 0; hash < psArray->uSize; hash++) {
+      for (psCurrentNode = psArray->apsBuckets[hash];
+           psCurrentNode != NULL;
+           psCurrentNode = psNextNode) {
+         psNextNode = psCurrentNode->psNextNode;
+         if (iFreeKeys && psCurrentNode->pcKey != psCurrentNode->acShortKey)
+            free((char*)psCurrentNode->pcKey);
+         free(psCurrentNode);
+      }
+   }
+   free(psArray);
+}
+
+/* Frees the removed BucketNodes and replaced BucketArrays of
+   oSymTable that no lookup can reach any more. The caller holds
+   writeLock. */
+static void SymTable_reclaim(SymTable_T oSymTable) {
+   struct BucketNode **pRetiredNode;
+   struct BucketNode *psNode;
+   struct BucketArray **pRetiredArray;
+   struct BucketArray *psArray;
+   size_t uOldest;
+
+   uOldest = Epoch_oldest();
+
+   pRetiredNode = &oSymTable->psRetiredNodes;
+   while (*pRetiredNode != NULL) {
+      psNode = *pRetiredNode;
+      if (psNode->uRetireEpoch <= uOldest) {
+         *pRetiredNode = psNode->psRetiredNode;
+         SymTable_freeNode(oSymTable, psNode);
+      }
+      else
+         pRetiredNode = &psNode->psRetiredNode;
+   }
+
+   pRetiredArray = &oSymTable->psRetiredArrays;
+   while (*pRetiredArray != NULL) {
+      psArray = *pRetiredArray;
+      if (psArray->uRetireEpoch <= uOldest) {
+         *pRetiredArray = psArray->psRetiredArray;
+         SymTable_freeArray(psArray, 0);
+      }
+      else
+         pRetiredArray = &psArray->psRetiredArray;
+   }
+}
+
+/* Marks iterators of oSymTable stale. The caller holds writeLock,
+   and calls this before retiring anything it has unlinked: an
+   iterator that checks uVersion inside a read section either sees
+   the change or began its section early enough to keep what was
+   unlinked from being freed. */
+static void SymTable_changed(SymTable_T oSymTable) {
+   __atomic_store_n(&oSymTable->uVersion, oSymTable->uVersion + 1,
+                    __ATOMIC_RELEASE);
+}
+
+/* Replaces oSymTable's hash table with one of newSize buckets, which
+   may be more or fewer than it has now. Lookups may still be walking
+   the old lists, so every BucketNode is copied rather than relinked;
+   the copies take over the keys, and the old hash table is freed once
+   no lookup can reach it. The caller holds writeLock. Returns 1
+   (TRUE) if successful, or 0 (FALSE) if newSize is the current size
+   or if insufficient memory is available, in which case oSymTable is
+   left unchanged. */
+static int SymTable_resize(SymTable_T oSymTable, size_t newSize) {
+   struct BucketArray *psOldArray = oSymTable->psArray;
+   struct BucketArray *psNewArray;
+   struct BucketNode *psCurrentNode;
+   struct BucketNode *psCopy;
+   size_t hash;
+   size_t hashNew;
+
+   if (newSize == psOldArray->uSize) return 0;
+
+   psNewArray = SymTable_newArray(newSize);
+   if (psNewArray == NULL) {
+      oSymTable->uFailedResizes++;
+      return 0;
+   }
+
+   for (hash = 0; hash < psOldArray->uSize; hash++) {
+      for (psCurrentNode = psOldArray->apsBuckets[hash];
+           psCurrentNode != NULL;
+           psCurrentNode = psCurrentNode->psNextNode) {
+         psCopy = (struct BucketNode*)malloc(sizeof(struct BucketNode));
+         if (psCopy == NULL) {
+            SymTable_freeArray(psNewArray, 0);
+            oSymTable->uFailedResizes++;
+            return 0;
+         }
+
+         *psCopy = *psCurrentNode;
+         if (psCurrentNode->pcKey == psCurrentNode->acShortKey)
+            psCopy->pcKey = psCopy->acShortKey;
+
+         hashNew = psCopy->uHash & (newSize - 1);
+         psCopy->psNextNode = psNewArray->apsBuckets[hashNew];
+         psNewArray->apsBuckets[hashNew] = psCopy;
+      }
+   }
+
+   SymTable_publish(&oSymTable->psArray, psNewArray);
+   SymTable_changed(oSymTable);
+   oSymTable->uResizes++;
+
+   psOldArray->uRetireEpoch = Epoch_retire();
+   psOldArray->psRetiredArray = oSymTable->psRetiredArrays;
+   oSymTable->psRetiredArrays = psOldArray;
+   SymTable_reclaim(oSymTable);
+   return 1;
+}
+
+/* Makes room in oSymTable for a total of uCapacity bindings. The
+   caller holds writeLock. Returns 1 (TRUE) if successful, or 0
+   (FALSE) if insufficient memory is available. */
+static int SymTable_grow(SymTable_T oSymTable, size_t uCapacity) {
+   size_t uSize;
+
+   uSize = SymTable_sizeFor(uCapacity);
+   if (uSize == 0) return 0;
+   if (uSize <= oSymTable->psArray->uSize) return 1;
+   return SymTable_resize(oSymTable, uSize);
+}
+
+/* Begins a lookup in oSymTable. Returns 0 (FALSE) if the lookup runs
+   lock-free in a read section, or 1 (TRUE) if there was no memory to
+   track a read section and it holds writeLock instead. */
+static int SymTable_beginRead(SymTable_T oSymTable) {
+   if (Epoch_enter()) return 0;
+   pthread_mutex_lock(&oSymTable->writeLock);
+   return 1;
+}
+
+/* Ends the lookup in oSymTable that SymTable_beginRead began and that
+   returned iLocked. */
+static void SymTable_endRead(SymTable_T oSymTable, int iLocked) {
+   if (iLocked)
+      pthread_mutex_unlock(&oSymTable->writeLock);
+   else
+      Epoch_exit();
+}
+
+/* Returns 1 (TRUE) if the key of psNode is the uLength characters at
+   pcKey, whose full hash is uHash, or 0 (FALSE) otherwise. The
+   characters are compared only once the hashes and lengths match.
+   None of these fields changes once the node is published. */
+static int SymTable_matches(const struct BucketNode *psNode,
+                            const char *pcKey, size_t uLength,
+                            size_t uHash) {
+   return psNode->uHash == uHash && psNode->uLength == uLength &&
+          (psNode->pcKey == pcKey ||
+           memcmp(psNode->pcKey, pcKey, uLength) == 0);
+}
+
+/* Returns the BucketNode of psArray, the hash table of oSymTable,
+   whose key is the uLength characters at pcKey and whose full hash is
+   uHash, or NULL if there is no such BucketNode. Safe to call while
+   another thread changes psArray. */
+static struct BucketNode *SymTable_find(SymTable_T oSymTable,
+                                        struct BucketArray *psArray,
+                                        const char *pcKey,
+                                        size_t uLength,
+                                        size_t uHash) {
+   struct BucketNode *psNode;
+   size_t uProbes = 0;
+
+   for (psNode = SymTable_load(
+           &psArray->apsBuckets[uHash & (psArray->uSize - 1)]);
+        psNode != NULL;
+        psNode = SymTable_load(&psNode->psNextNode)) {
+      uProbes++;
+      if (SymTable_matches(psNode, pcKey, uLength, uHash))
+         break;
+   }
+   SymTable_countLookup(oSymTable, psNode != NULL, uProbes);
+   return psNode;
+}
+
+/* Returns the address of the link in bucket, a bucket of oSymTable,
+   that points to the BucketNode whose key is the uLength characters
+   at pcKey and whose full hash is uHash, or NULL if bucket holds no
+   such BucketNode. The caller holds writeLock. */
+static struct BucketNode **SymTable_findLink(SymTable_T oSymTable,
+                                             struct BucketNode **bucket,
+                                             const char *pcKey,
+                                             size_t uLength,
+                                             size_t uHash) {
+   struct BucketNode **link;
+   size_t uProbes = 0;
+
+   for (link = bucket; *link != NULL; link = &(*link)->psNextNode) {
+      uProbes++;
+      if (SymTable_matches(*link, pcKey, uLength, uHash)) {
+         SymTable_countLookup(oSymTable, 1, uProbes);
+         return link;
+      }
+   }
+   SymTable_countLookup(oSymTable, 0, uProbes);
+   return NULL;
+}
+
+/* No other thread may be using oSymTable. */
+void SymTable_free(SymTable_T oSymTable) {
+   struct BucketNode *psNode;
+   struct BucketArray *psArray;
+
+   assert(oSymTable != NULL);
+
+   SymTable_freeArray(oSymTable->psArray, !oSymTable->iBorrowedKeys);
+
+   while (oSymTable->psRetiredNodes != NULL) {
+      psNode = oSymTable->psRetiredNodes;
+      oSymTable->psRetiredNodes = psNode->psRetiredNode;
+      SymTable_freeNode(oSymTable, psNode);
+   }
+   while (oSymTable->psRetiredArrays != NULL) {
+      psArray = oSymTable->psRetiredArrays;
+      oSymTable->psRetiredArrays = psArray->psRetiredArray;
+      SymTable_freeArray(psArray, 0);
+   }
+
+   pthread_mutex_destroy(&oSymTable->writeLock);
+   free(oSymTable);
+}
+
+size_t SymTable_getLength(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+   return __atomic_load_n(&oSymTable->nodeCount, __ATOMIC_RELAXED);
+}
+
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   iSuccessful = SymTable_grow(oSymTable, uCapacity);
+   pthread_mutex_unlock(&oSymTable->writeLock);
+   return iSuccessful;
+}
+
+void SymTable_compact(SymTable_T oSymTable) {
+   size_t uSize;
+
+   assert(oSymTable != NULL);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   uSize = SymTable_sizeFor(2 * oSymTable->nodeCount);
+   if (uSize != 0 && uSize < oSymTable->psArray->uSize)
+      (void)SymTable_resize(oSymTable, uSize);
+   pthread_mutex_unlock(&oSymTable->writeLock);
+}
+
+/* Adds one chain of uLength bindings to the histogram of *psStats. */
+static void SymTable_countChain(struct SymTableStats *psStats,
+                                size_t uLength) {
+   if (uLength > psStats->uMaxChain)
+      psStats->uMaxChain = uLength;
+   if (uLength >= SYMTABLE_HISTOGRAM_SIZE)
+      uLength = SYMTABLE_HISTOGRAM_SIZE - 1;
+   psStats->auChains[uLength]++;
+}
+
+/* Returns the number of bytes that psArray and its BucketNodes hold,
+   not counting the nodes' keys, which a replaced BucketArray shares
+   with a newer one. */
+static size_t SymTable_arrayBytes(struct BucketArray *psArray) {
+   struct BucketNode *psNode;
+   size_t uBytes;
+   size_t hash;
+
+   uBytes = offsetof(struct BucketArray, apsBuckets)
+      + psArray->uSize * sizeof(struct BucketNode*);
+   for (hash = 0; hash < psArray->uSize; hash++) {
+      for (psNode = psArray->apsBuckets[hash]; psNode != NULL;
+           psNode = psNode->psNextNode)
+         uBytes += sizeof(struct BucketNode);
+   }
+   return uBytes;
+}
+
+/* Holds writeLock, so that the hash table stands still. The bytes
+   include removed BucketNodes and replaced BucketArrays that are
+   waiting to be freed. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct BucketArray *psArray;
+   struct BucketNode *psNode;
+   size_t uLength;
+   size_t hash;
+
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   psArray = oSymTable->psArray;
+   psStats->uBindings = oSymTable->nodeCount;
+   psStats->uBuckets = psArray->uSize;
+   psStats->dLoadFactor = (double)oSymTable->nodeCount
+      / (double)psArray->uSize;
+   psStats->uBytes = sizeof(struct SymTable)
+      + SymTable_arrayBytes(psArray);
+
+   for (hash = 0; hash < psArray->uSize; hash++) {
+      uLength = 0;
+      for (psNode = psArray->apsBuckets[hash]; psNode != NULL;
+           psNode = psNode->psNextNode) {
+         uLength++;
+         if (psNode->pcKey != psNode->acShortKey &&
+             !oSymTable->iBorrowedKeys)
+            psStats->uBytes += psNode->uLength + 1;
+      }
+      SymTable_countChain(psStats, uLength);
+   }
+
+   for (psArray = oSymTable->psRetiredArrays; psArray != NULL;
+        psArray = psArray->psRetiredArray)
+      psStats->uBytes += SymTable_arrayBytes(psArray);
+
+   for (psNode = oSymTable->psRetiredNodes; psNode != NULL;
+        psNode = psNode->psRetiredNode) {
+      psStats->uBytes += sizeof(struct BucketNode);
+      if (psNode->pcKey != psNode->acShortKey &&
+          !oSymTable->iBorrowedKeys)
+         psStats->uBytes += psNode->uLength + 1;
+   }
+
+   psStats->uResizes = oSymTable->uResizes;
+   psStats->uFailedResizes = oSymTable->uFailedResizes;
+   pthread_mutex_unlock(&oSymTable->writeLock);
+
+   psStats->uHits = __atomic_load_n(&oSymTable->uHits, __ATOMIC_RELAXED);
+   psStats->uHitProbes = __atomic_load_n(&oSymTable->uHitProbes,
+                                         __ATOMIC_RELAXED);
+   psStats->uMisses = __atomic_load_n(&oSymTable->uMisses,
+                                      __ATOMIC_RELAXED);
+   psStats->uMissProbes = __atomic_load_n(&oSymTable->uMissProbes,
+                                          __ATOMIC_RELAXED);
+}
+
+/* Adds the binding of the uLength characters at pcKey to pvValue to
+   oSymTable as SymTable_putN does, unless the key is there already.
+   Returns the BucketNode of the current hash table that holds the
+   key, or NULL if insufficient memory is available to add it, and
+   sets *piInserted to 1 (TRUE) if the binding was added or to 0
+   (FALSE) otherwise. The caller holds writeLock. */
+static struct BucketNode *SymTable_insert(SymTable_T oSymTable,
+                                          const char *pcKey,
+                                          size_t uLength,
+                                          const void *pvValue,
+                                          int *piInserted) {
+   struct BucketNode *psNewNode;
+   struct BucketNode **bucket;
+   struct BucketNode **link;
+   size_t uHash;
+
+   assert(pcKey != NULL);
+
+   *piInserted = 0;
+   uHash = SymTable_hash(pcKey, uLength);
+   bucket = &oSymTable->psArray->apsBuckets[uHash &
+                                            (oSymTable->psArray->uSize - 1)];
+   link = SymTable_findLink(oSymTable, bucket, pcKey, uLength, uHash);
+   if (link != NULL)
+      return *link;
+
+   /* Allocate data to new node, make sure there is enough space */
+   psNewNode = SymTable_newNode(oSymTable, pcKey, uLength);
+   if (psNewNode == NULL)
+      return NULL;
+
+   psNewNode->pvValue = pvValue;
+   psNewNode->uHash = uHash;
+   psNewNode->psNextNode = *bucket;
+
+   /* Lookups see the node only once it is complete */
+   SymTable_publish(bucket, psNewNode);
+   __atomic_store_n(&oSymTable->nodeCount, oSymTable->nodeCount + 1,
+                    __ATOMIC_RELAXED);
+   SymTable_changed(oSymTable);
+
+   /* A resize copies every node, so the binding is in a new node
+      afterwards. Finding it again is not a lookup of the caller's, so
+      it walks the bucket without counting one. */
+   *piInserted = 1;
+   if (oSymTable->nodeCount >= oSymTable->psArray->uSize &&
+       SymTable_resize(oSymTable,
+                       SymTable_nextSize(oSymTable->psArray->uSize))) {
+      psNewNode = oSymTable->psArray->apsBuckets[
+         uHash & (oSymTable->psArray->uSize - 1)];
+      while (! SymTable_matches(psNewNode, pcKey, uLength, uHash))
+         psNewNode = psNewNode->psNextNode;
+   }
+
+   return psNewNode;
+}
+
+int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   (void)SymTable_insert(oSymTable, pcKey, uLength, pvValue, &iSuccessful);
+   pthread_mutex_unlock(&oSymTable->writeLock);
+   return iSuccessful;
+}
+
+/* A store through the address would race with lock-free lookups, and
+   a resize would retire the node under the caller, so no address is
+   handed out. */
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)oSymTable;
+   (void)pcKey;
+   (void)pvDefault;
+   if (piInserted != NULL) *piInserted = 0;
+   return NULL;
+}
+
+/* (*pfUpdate) runs under writeLock, and its result is published as
+   SymTable_replace publishes a value, so lock-free lookups see the
+   value either before or after it. */
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   struct BucketNode *psNode;
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   psNode = SymTable_insert(oSymTable, pcKey, strlen(pcKey), pvDefault,
+                            &iInserted);
+   if (psNode != NULL && pfUpdate != NULL)
+      SymTable_publish(&psNode->pvValue,
+                       (*pfUpdate)(pcKey, (void*)psNode->pvValue,
+                                   (void*)pvExtra));
+   pthread_mutex_unlock(&oSymTable->writeLock);
+
+   if (piInserted != NULL) *piInserted = iInserted;
+   return psNode != NULL;
+}
+
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+
+   /* Copying every binding once for the whole batch beats copying
+      them at each doubling along the way */
+   if (uCount <= (size_t)-1 - oSymTable->nodeCount)
+      (void)SymTable_grow(oSymTable, oSymTable->nodeCount + uCount);
+
+   for (u = 0; u < uCount; u++) {
+      assert(apcKeys[u] != NULL);
+      (void)SymTable_insert(oSymTable, apcKeys[u], strlen(apcKeys[u]),
+                            apvValues[u], &iSuccessful);
+      if (aiResults != NULL) aiResults[u] = iSuccessful;
+      if (iSuccessful) uAdded++;
+   }
+   pthread_mutex_unlock(&oSymTable->writeLock);
+   return uAdded;
+}
+
+void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   struct BucketNode **link;
+   const void *tempValue = NULL;
+   size_t uHash;
+   size_t uLength;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uLength = strlen(pcKey);
+   uHash = SymTable_hash(pcKey, uLength);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   link = SymTable_findLink(
+      oSymTable, &oSymTable->psArray->apsBuckets[uHash &
+                                      (oSymTable->psArray->uSize - 1)],
+      pcKey, uLength, uHash);
+   if (link != NULL) {
+      tempValue = (*link)->pvValue;
+      SymTable_publish(&(*link)->pvValue, pvValue);
+   }
+   pthread_mutex_unlock(&oSymTable->writeLock);
+   return (void *) tempValue;
+}
+
+int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_containsN(oSymTable, pcKey, strlen(pcKey));
+}
+
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct BucketNode *psNode;
+   size_t uHash;
+   int iLocked;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uHash = SymTable_hash(pcKey, uLength);
+
+   iLocked = SymTable_beginRead(oSymTable);
+   psNode = SymTable_find(oSymTable, SymTable_load(&oSymTable->psArray),
+                          pcKey, uLength, uHash);
+   SymTable_endRead(oSymTable, iLocked);
+   return psNode != NULL;
+}
+
+void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
+   struct BucketNode *psNode;
+   const void *pvValue = NULL;
+   size_t uHash;
+   int iLocked;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uHash = SymTable_hash(pcKey, uLength);
+
+   iLocked = SymTable_beginRead(oSymTable);
+   psNode = SymTable_find(oSymTable, SymTable_load(&oSymTable->psArray),
+                          pcKey, uLength, uHash);
+   if (psNode != NULL) pvValue = SymTable_load(&psNode->pvValue);
+   SymTable_endRead(oSymTable, iLocked);
+   return (void*)pvValue;
+}
+
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   struct BucketArray *psArray;
+   struct BucketNode *psNode;
+   size_t uLength;
+   size_t u;
+   size_t uFound = 0;
+   int iLocked;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   /* One read section covers the whole batch */
+   iLocked = SymTable_beginRead(oSymTable);
+   psArray = SymTable_load(&oSymTable->psArray);
+   for (u = 0; u < uCount; u++) {
+      assert(apcKeys[u] != NULL);
+      apvValues[u] = NULL;
+      uLength = strlen(apcKeys[u]);
+      psNode = SymTable_find(oSymTable, psArray, apcKeys[u], uLength,
+                             SymTable_hash(apcKeys[u], uLength));
+      if (psNode != NULL) {
+         apvValues[u] = (void*)SymTable_load(&psNode->pvValue);
+         uFound++;
+      }
+   }
+   SymTable_endRead(oSymTable, iLocked);
+   return uFound;
+}
+
+void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct BucketNode *psNode;
+   struct BucketNode **link;
+   const void *tempValue = NULL;
+   size_t uHash;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uHash = SymTable_hash(pcKey, uLength);
+
+   pthread_mutex_lock(&oSymTable->writeLock);
+   link = SymTable_findLink(
+      oSymTable, &oSymTable->psArray->apsBuckets[uHash &
+                                      (oSymTable->psArray->uSize - 1)],
+      pcKey, uLength, uHash);
+   if (link != NULL) {
+      psNode = *link;
+      tempValue = psNode->pvValue;
+
+      /* A lookup standing on psNode still finds the rest of the list
+         through psNode's own psNextNode, which stays as it is */
+      SymTable_publish(link, psNode->psNextNode);
+      __atomic_store_n(&oSymTable->nodeCount, oSymTable->nodeCount - 1,
+                       __ATOMIC_RELAXED);
+      SymTable_changed(oSymTable);
+
+      psNode->uRetireEpoch = Epoch_retire();
+      psNode->psRetiredNode = oSymTable->psRetiredNodes;
+      oSymTable->psRetiredNodes = psNode;
+      SymTable_reclaim(oSymTable);
+   }
+   pthread_mutex_unlock(&oSymTable->writeLock);
+   return (void *) tempValue;
+}
+
+/* Runs as one lookup. Bindings that other threads put or remove
+   meanwhile may or may not be visited. */
+void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra) {
+   struct BucketArray *psArray;
+   struct BucketNode *tempNode_current;
+   size_t hash;
+   int iLocked;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+
+   iLocked = SymTable_beginRead(oSymTable);
+   psArray = SymTable_load(&oSymTable->psArray);
+   for (hash = 0; hash < psArray->uSize; hash++) {
+      for (tempNode_current = SymTable_load(&psArray->apsBuckets[hash]);
+           tempNode_current != NULL;
+           tempNode_current = SymTable_load(&tempNode_current->psNextNode)) {
+         (*pfApply)(tempNode_current->pcKey, (void*)SymTable_load(&tempNode_current->pvValue), (void*)pvExtra);
+      }
+   }
+   SymTable_endRead(oSymTable, iLocked);
+}
+
+/* The number of buckets that a thread of SymTable_mapParallel takes
+   at a time. */
+enum {MAP_CHUNK_SIZE = 1024};
+
+/* What each thread of SymTable_mapParallel needs. */
+struct MapWork
+{
+   struct BucketArray *psArray;
+   void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra);
+   void *pvExtra;
+};
+
+/* Applies the MapWork at pvWork to buckets uFirst to uLimit - 1. */
+static void SymTable_mapChunk(size_t uFirst, size_t uLimit,
+                              void *pvWork) {
+   struct MapWork *psWork = (struct MapWork*)pvWork;
+   struct BucketNode *tempNode_current;
+   size_t hash;
+
+   for (hash = uFirst; hash < uLimit; hash++) {
+      for (tempNode_current =
+              SymTable_load(&psWork->psArray->apsBuckets[hash]);
+           tempNode_current != NULL;
+           tempNode_current = SymTable_load(&tempNode_current->psNextNode)) {
+         (*psWork->pfApply)(tempNode_current->pcKey,
+                            (void*)SymTable_load(&tempNode_current->pvValue),
+                            psWork->pvExtra);
+      }
+   }
+}
+
+/* Runs as one lookup on the calling thread. Nothing retired after its
+   read section begins is freed before it ends, so the other threads
+   need no read sections of their own. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   struct MapWork sWork;
+   int iLocked;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+   assert(iThreads > 0);
+
+   iLocked = SymTable_beginRead(oSymTable);
+   sWork.psArray = SymTable_load(&oSymTable->psArray);
+   sWork.pfApply = pfApply;
+   sWork.pvExtra = (void*)pvExtra;
+   Parallel_run(sWork.psArray->uSize, MAP_CHUNK_SIZE, SymTable_mapChunk,
+                &sWork, iThreads);
+   SymTable_endRead(oSymTable, iLocked);
+}
+
+size_t SymTable_mapWorker(void) {
+   return Parallel_worker();
+}
+
+/* An iterator holds no read section between calls; each
+   SymTable_iterNext runs as one lookup, so SymTable_map is cheaper for
+   visiting every binding. uIndex is the next bucket to
+   look in, and pvPosition the BucketNode the iterator is at, which
+   cannot have been freed while uVersion is unchanged. A key from
+   SymTable_iterKey is freed once another thread removes its binding
+   or replaces the hash table. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = NULL;
+   psIter->uIndex = 0;
+   psIter->uVersion = __atomic_load_n(&oSymTable->uVersion,
+                                      __ATOMIC_ACQUIRE);
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   SymTable_T oSymTable;
+   struct BucketArray *psArray;
+   struct BucketNode *psNode = NULL;
+   int iLocked;
+
+   assert(psIter != NULL);
+
+   if (psIter->iStale) return 0;
+
+   oSymTable = psIter->oSymTable;
+   iLocked = SymTable_beginRead(oSymTable);
+   if (__atomic_load_n(&oSymTable->uVersion, __ATOMIC_ACQUIRE)
+       != psIter->uVersion) {
+      SymTable_endRead(oSymTable, iLocked);
+      psIter->iStale = 1;
+      return 0;
+   }
+
+   psArray = SymTable_load(&oSymTable->psArray);
+   if (psIter->pvPosition != NULL)
+      psNode = SymTable_load(
+         &((struct BucketNode*)psIter->pvPosition)->psNextNode);
+   while (psNode == NULL && psIter->uIndex < psArray->uSize)
+      psNode = SymTable_load(&psArray->apsBuckets[psIter->uIndex++]);
+
+   psIter->pvPosition = psNode;
+   if (psNode != NULL) {
+      psIter->pcKey = psNode->pcKey;
+      psIter->pvValue = (void*)SymTable_load(&psNode->pvValue);
+   }
+   SymTable_endRead(oSymTable, iLocked);
+   return psNode != NULL;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
@@ -0,0 +1,1290 @@
+/* Module defining a number of symbol table functions using a B+tree,
+   which keeps the bindings sorted by key so that ranges and prefixes
+   of keys can be visited without looking at the rest. Every binding
+   sits in a leaf, the leaves are chained in key order, and each node
+   holds many keys side by side, so a lookup touches a few wide nodes
+   instead of a long chain of narrow ones. */
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include "symtable.h"
+#include "symtableordered.h"
+#include "parallel.h"
+
+/* The most bindings a Leaf holds. Even, so that a Leaf split in two
+   leaves both halves at least LEAF_MIN. */
+enum {LEAF_CAPACITY = 32};
+
+/* A Leaf other than the root that falls below this many bindings is
+   refilled from a neighbour or merged with it. */
+enum {LEAF_MIN = LEAF_CAPACITY / 2};
+
+/* The most children a Branch has. */
+enum {BRANCH_CAPACITY = 32};
+
+/* A Branch other than the root that falls below this many children
+   is refilled from a neighbour or merged with it. */
+enum {BRANCH_MIN = BRANCH_CAPACITY / 2};
+
+/* More levels than a tree of nodes at least half full can have while
+   its bindings fit in memory. */
+enum {MAX_HEIGHT = 32};
+
+/* A Leaf holds bindings in key order. Each key's prefix sits in an
+   array of its own, so that a search compares whole words and reads a
+   key's characters only when the prefixes tie. */
+struct Leaf
+{
+   /* The number of bindings in the Leaf. */
+   size_t uCount;
+
+   /* The address of the Leaf that follows in key order, or NULL. */
+   struct Leaf *psNextLeaf;
+
+   /* The prefixes, keys and values of the bindings. */
+   size_t auPrefixes[LEAF_CAPACITY];
+   const char *apcKeys[LEAF_CAPACITY];
+   const void *apvValues[LEAF_CAPACITY];
+};
+
+/* A Branch holds uCount children, which are Leaves if the Branch is
+   one level above the leaves and Branches otherwise, and uCount - 1
+   separators. Every key under child i is less than separator i and
+   no less than separator i - 1. Separators are copies owned by the
+   Branch, so removing a binding never leaves one dangling. */
+struct Branch
+{
+   /* The number of children. */
+   size_t uCount;
+
+   /* The prefixes and keys of the separators. */
+   size_t auPrefixes[BRANCH_CAPACITY - 1];
+   const char *apcKeys[BRANCH_CAPACITY - 1];
+
+   /* The children. */
+   void *apvChildren[BRANCH_CAPACITY];
+};
+
+/* A SymTable tracks the root of a B+tree and the first of its
+   leaves. */
+struct SymTable
+{
+   /* The root: a Leaf if uHeight is 0, or a Branch otherwise. */
+   void *pvRoot;
+
+   /* The number of Branch levels above the leaves. */
+   size_t uHeight;
+
+   /* The first Leaf in key order. Merges free the right-hand Leaf of
+      the two, so this one lives as long as the SymTable. */
+   struct Leaf *psFirstLeaf;
+
+   /* The number of bindings in the SymTable. */
+   size_t nodeCount;
+
+   /* Changed whenever a binding is added or removed, so that
+      iterators can tell that they are stale. */
+   size_t uVersion;
+
+   /* 1 (TRUE) if Leaves point to their callers' keys instead of to
+      copies, or 0 (FALSE) otherwise. Separators are copies either
+      way. */
+   int iBorrowedKeys;
+
+   /* Lookups that found their key and the nodes they visited, and
+      lookups that did not and theirs, counted only if SYMTABLE_STATS
+      is defined. */
+   size_t uHits;
+   size_t uHitProbes;
+   size_t uMisses;
+   size_t uMissProbes;
+};
+
+/* Counts, for SymTable_getStats, a lookup in oSymTable that visited
+   uProbes nodes and found its key if iFound is 1 (TRUE). Compiles to
+   nothing unless SYMTABLE_STATS is defined. */
+#ifdef SYMTABLE_STATS
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)((iFound) ? ((oSymTable)->uHits++,                          \
+                       (oSymTable)->uHitProbes += (uProbes))          \
+                    : ((oSymTable)->uMisses++,                        \
+                       (oSymTable)->uMissProbes += (uProbes))))
+#else
+#define SymTable_countLookup(oSymTable, iFound, uProbes)              \
+   ((void)(oSymTable), (void)(iFound), (void)(uProbes))
+#endif
+
+/* The Branches from the root down to a Leaf, and the index of the
+   child taken at each. */
+struct Path
+{
+   struct Branch *apsBranches[MAX_HEIGHT];
+   size_t auIndices[MAX_HEIGHT];
+};
+
+/* Returns the first sizeof(size_t) of the uLength characters at
+   pcKey, padded with NULs, as one number that orders as the
+   characters do. */
+static size_t SymTable_prefix(const char *pcKey, size_t uLength)
+{
+   size_t uPrefix = 0;
+   size_t u;
+
+   assert(pcKey != NULL);
+
+   for (u = 0; u < sizeof(size_t); u++) {
+      uPrefix <<= CHAR_BIT;
+      if (u < uLength)
+         uPrefix |= (unsigned char)pcKey[u];
+   }
+   return uPrefix;
+}
+
+/* Returns a negative number, 0, or a positive number as pcKey, whose
+   prefix is uPrefix, is less than, equal to, or greater than the
+   uOtherLength characters at pcOther, whose prefix is uOtherPrefix.
+   pcKey must end in '\0'; pcOther need not. */
+static int SymTable_compare(size_t uPrefix, const char *pcKey,
+                            size_t uOtherPrefix, const char *pcOther,
+                            size_t uOtherLength)
+{
+   int iCompare;
+
+   if (uPrefix != uOtherPrefix)
+      return uPrefix < uOtherPrefix ? -1 : 1;
+
+   /* strncmp stops at the '\0' of a shorter pcKey, and otherwise the
+      two are equal only if pcKey ends where pcOther does */
+   if (pcKey != pcOther) {
+      iCompare = strncmp(pcKey, pcOther, uOtherLength);
+      if (iCompare != 0)
+         return iCompare;
+   }
+   return pcKey[uOtherLength] != '\0';
+}
+
+/* Returns a copy of the uLength characters at pcKey followed by '\0',
+   or NULL if insufficient memory is available. */
+static char *SymTable_copyKey(const char *pcKey, size_t uLength)
+{
+   char *pcCopy;
+
+   pcCopy = (char*)malloc(uLength + 1);
+   if (pcCopy != NULL) {
+      memcpy(pcCopy, pcKey, uLength);
+      pcCopy[uLength] = '\0';
+   }
+   return pcCopy;
+}
+
+/* Returns the index of the first binding of psLeaf whose key is no
+   less than the uLength characters at pcKey, whose prefix is uPrefix,
+   and sets *piFound to 1 (TRUE) if that binding's key is those
+   characters or to 0 (FALSE) otherwise. */
+static size_t SymTable_leafSearch(const struct Leaf *psLeaf,
+                                  size_t uPrefix, const char *pcKey,
+                                  size_t uLength, int *piFound)
+{
+   size_t uLow = 0;
+   size_t uHigh = psLeaf->uCount;
+   size_t uMid;
+   int iCompare;
+
+   *piFound = 0;
+   while (uLow < uHigh) {
+      uMid = uLow + (uHigh - uLow) / 2;
+      iCompare = SymTable_compare(psLeaf->auPrefixes[uMid],
+                                  psLeaf->apcKeys[uMid], uPrefix, pcKey,
+                                  uLength);
+      if (iCompare < 0)
+         uLow = uMid + 1;
+      else {
+         if (iCompare == 0) *piFound = 1;
+         uHigh = uMid;
+      }
+   }
+   return uLow;
+}
+
+/* Returns the index of the child of psBranch under which the uLength
+   characters at pcKey, whose prefix is uPrefix, belong: the number of
+   separators no greater than they are. */
+static size_t SymTable_branchSearch(const struct Branch *psBranch,
+                                    size_t uPrefix, const char *pcKey,
+                                    size_t uLength)
+{
+   size_t uLow = 0;
+   size_t uHigh = psBranch->uCount - 1;
+   size_t uMid;
+
+   while (uLow < uHigh) {
+      uMid = uLow + (uHigh - uLow) / 2;
+      if (SymTable_compare(psBranch->auPrefixes[uMid],
+                           psBranch->apcKeys[uMid], uPrefix, pcKey,
+                           uLength) <= 0)
+         uLow = uMid + 1;
+      else
+         uHigh = uMid;
+   }
+   return uLow;
+}
+
+/* Returns the Leaf of oSymTable under which the uLength characters at
+   pcKey, whose prefix is uPrefix, belong. If psPath is not NULL,
+   records in it the Branches passed on the way down. */
+static struct Leaf *SymTable_descend(SymTable_T oSymTable, size_t uPrefix,
+                                     const char *pcKey, size_t uLength,
+                                     struct Path *psPath)
+{
+   void *pvNode = oSymTable->pvRoot;
+   size_t uLevel;
+   size_t uIndex;
+
+   for (uLevel = 0; uLevel < oSymTable->uHeight; uLevel++) {
+      uIndex = SymTable_branchSearch((struct Branch*)pvNode, uPrefix,
+                                     pcKey, uLength);
+      if (psPath != NULL) {
+         psPath->apsBranches[uLevel] = (struct Branch*)pvNode;
+         psPath->auIndices[uLevel] = uIndex;
+      }
+      pvNode = ((struct Branch*)pvNode)->apvChildren[uIndex];
+   }
+   return (struct Leaf*)pvNode;
+}
+
+/* Returns the binding index within its Leaf of the binding of
+   oSymTable whose key is the uLength characters at pcKey, and sets
+   *ppsLeaf to that Leaf, or returns LEAF_CAPACITY if no such binding
+   exists. */
+static size_t SymTable_find(SymTable_T oSymTable, const char *pcKey,
+                            size_t uLength, struct Leaf **ppsLeaf)
+{
+   size_t uPrefix;
+   size_t uIndex;
+   int iFound;
+
+   uPrefix = SymTable_prefix(pcKey, uLength);
+   *ppsLeaf = SymTable_descend(oSymTable, uPrefix, pcKey, uLength, NULL);
+   uIndex = SymTable_leafSearch(*ppsLeaf, uPrefix, pcKey, uLength,
+                                &iFound);
+   SymTable_countLookup(oSymTable, iFound, oSymTable->uHeight + 1);
+   return iFound ? uIndex : LEAF_CAPACITY;
+}
+
+/* Returns a new SymTable_T object configured by iOptions, or NULL if
+   insufficient memory is available. */
+static SymTable_T SymTable_create(int iOptions) {
+   SymTable_T oSymTable;
+   struct Leaf *psLeaf;
+
+   oSymTable = (SymTable_T)malloc(sizeof(struct SymTable));
+   if (oSymTable == NULL) return NULL;
+
+   psLeaf = (struct Leaf*)malloc(sizeof(struct Leaf));
+   if (psLeaf == NULL) {
+      free(oSymTable);
+      return NULL;
+   }
+   psLeaf->uCount = 0;
+   psLeaf->psNextLeaf = NULL;
+
+   oSymTable->pvRoot = psLeaf;
+   oSymTable->uHeight = 0;
+   oSymTable->psFirstLeaf = psLeaf;
+   oSymTable->nodeCount = 0;
+   oSymTable->uVersion = 0;
+   oSymTable->iBorrowedKeys = (iOptions & SYMTABLE_BORROWED_KEYS) != 0;
+   oSymTable->uHits = 0;
+   oSymTable->uHitProbes = 0;
+   oSymTable->uMisses = 0;
+   oSymTable->uMissProbes = 0;
+   return oSymTable;
+}
+
+SymTable_T SymTable_new(void) {
+   return SymTable_create(0);
+}
+
+/* Nodes hold many bindings each, so an Arena would save little; only
+   SYMTABLE_BORROWED_KEYS is supported. */
+SymTable_T SymTable_newWithOptions(int iOptions) {
+   return SymTable_create(iOptions);
+}
+
+/* A B+tree grows a node at a time, so uCapacity is accepted only for
+   portability with the hash table implementations. */
+SymTable_T SymTable_newWithCapacity(size_t uCapacity) {
+   (void)uCapacity;
+   return SymTable_create(0);
+}
+
+/* Frees pvNode, which is uHeight levels above the leaves, along with
+   everything under it, including the keys of its bindings if
+   iFreeKeys is 1 (TRUE). */
+static void SymTable_freeNode(void *pvNode, size_t uHeight,
+                              int iFreeKeys) {
+   struct Leaf *psLeaf;
+   struct Branch *psBranch;
+   size_t u;
+
+   if (uHeight == 0) {
+      psLeaf = (struct Leaf*)pvNode;
+      for (u = 0; u < psLeaf->uCount && iFreeKeys; u++)
+         free((char*)psLeaf->apcKeys[u]);
+      free(psLeaf);
+      return;
+   }
+
+   psBranch = (struct Branch*)pvNode;
+   for (u = 0; u < psBranch->uCount; u++)
+      SymTable_freeNode(psBranch->apvChildren[u], uHeight - 1,
+                        iFreeKeys);
+   for (u = 0; u + 1 < psBranch->uCount; u++)
+      free((char*)psBranch->apcKeys[u]);
+   free(psBranch);
+}
+
+void SymTable_free(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+
+   SymTable_freeNode(oSymTable->pvRoot, oSymTable->uHeight,
+                     !oSymTable->iBorrowedKeys);
+   free(oSymTable);
+}
+
+size_t SymTable_getLength(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+   return oSymTable->nodeCount;
+}
+
+/* Nodes are allocated as the tree grows, so there is nothing to set
+   aside. */
+int SymTable_reserve(SymTable_T oSymTable, size_t uCapacity) {
+   assert(oSymTable != NULL);
+   (void)oSymTable;
+   (void)uCapacity;
+   return 1;
+}
+
+/* Every node but the root is kept at least half full, so there is
+   nothing to compact. */
+void SymTable_compact(SymTable_T oSymTable) {
+   assert(oSymTable != NULL);
+   (void)oSymTable;
+}
+
+/* Returns the number of bytes that pvNode, which is uHeight levels
+   above the leaves, and everything under it hold, counting the keys
+   of its bindings only if iCountKeys is 1 (TRUE). */
+static size_t SymTable_nodeBytes(void *pvNode, size_t uHeight,
+                                 int iCountKeys) {
+   struct Leaf *psLeaf;
+   struct Branch *psBranch;
+   size_t uBytes;
+   size_t u;
+
+   if (uHeight == 0) {
+      psLeaf = (struct Leaf*)pvNode;
+      uBytes = sizeof(struct Leaf);
+      for (u = 0; u < psLeaf->uCount && iCountKeys; u++)
+         uBytes += strlen(psLeaf->apcKeys[u]) + 1;
+      return uBytes;
+   }
+
+   psBranch = (struct Branch*)pvNode;
+   uBytes = sizeof(struct Branch);
+   for (u = 0; u < psBranch->uCount; u++)
+      uBytes += SymTable_nodeBytes(psBranch->apvChildren[u], uHeight - 1,
+                                   iCountKeys);
+   for (u = 0; u + 1 < psBranch->uCount; u++)
+      uBytes += strlen(psBranch->apcKeys[u]) + 1;
+   return uBytes;
+}
+
+/* Each Leaf is a bucket whose chain is its bindings. The tree grows a
+   node at a time, so it never resizes. */
+void SymTable_getStats(SymTable_T oSymTable, struct SymTableStats *psStats) {
+   struct Leaf *psLeaf;
+   size_t uLength;
+
+   assert(oSymTable != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(struct SymTableStats));
+   psStats->uBindings = oSymTable->nodeCount;
+   for (psLeaf = oSymTable->psFirstLeaf; psLeaf != NULL;
+        psLeaf = psLeaf->psNextLeaf) {
+      psStats->uBuckets++;
+      uLength = psLeaf->uCount;
+      if (uLength > psStats->uMaxChain)
+         psStats->uMaxChain = uLength;
+      if (uLength >= SYMTABLE_HISTOGRAM_SIZE)
+         uLength = SYMTABLE_HISTOGRAM_SIZE - 1;
+      psStats->auChains[uLength]++;
+   }
+   psStats->dLoadFactor = (double)oSymTable->nodeCount
+      / (double)psStats->uBuckets;
+   psStats->uBytes = sizeof(struct SymTable)
+      + SymTable_nodeBytes(oSymTable->pvRoot, oSymTable->uHeight,
+                           !oSymTable->iBorrowedKeys);
+
+   psStats->uHits = oSymTable->uHits;
+   psStats->uHitProbes = oSymTable->uHitProbes;
+   psStats->uMisses = oSymTable->uMisses;
+   psStats->uMissProbes = oSymTable->uMissProbes;
+}
+
+/* Inserts the binding pcKey-pvValue, whose key has prefix uPrefix, at
+   index uIndex of psLeaf, which has room for it. */
+static void SymTable_leafInsert(struct Leaf *psLeaf, size_t uIndex,
+                                size_t uPrefix, const char *pcKey,
+                                const void *pvValue) {
+   size_t uMoved = psLeaf->uCount - uIndex;
+
+   assert(psLeaf->uCount < LEAF_CAPACITY);
+
+   memmove(&psLeaf->auPrefixes[uIndex + 1], &psLeaf->auPrefixes[uIndex],
+           uMoved * sizeof(size_t));
+   memmove(&psLeaf->apcKeys[uIndex + 1], &psLeaf->apcKeys[uIndex],
+           uMoved * sizeof(const char*));
+   memmove(&psLeaf->apvValues[uIndex + 1], &psLeaf->apvValues[uIndex],
+           uMoved * sizeof(const void*));
+   psLeaf->auPrefixes[uIndex] = uPrefix;
+   psLeaf->apcKeys[uIndex] = pcKey;
+   psLeaf->apvValues[uIndex] = pvValue;
+   psLeaf->uCount++;
+}
+
+/* Removes the binding at index uIndex of psLeaf, without freeing its
+   key. */
+static void SymTable_leafDelete(struct Leaf *psLeaf, size_t uIndex) {
+   size_t uMoved = psLeaf->uCount - uIndex - 1;
+
+   memmove(&psLeaf->auPrefixes[uIndex], &psLeaf->auPrefixes[uIndex + 1],
+           uMoved * sizeof(size_t));
+   memmove(&psLeaf->apcKeys[uIndex], &psLeaf->apcKeys[uIndex + 1],
+           uMoved * sizeof(const char*));
+   memmove(&psLeaf->apvValues[uIndex], &psLeaf->apvValues[uIndex + 1],
+           uMoved * sizeof(const void*));
+   psLeaf->uCount--;
+}
+
+/* Inserts separator pcKey, whose prefix is uPrefix, at index uIndex
+   of psBranch, and pvChild just after it, as child uIndex + 1.
+   psBranch has room for them. */
+static void SymTable_branchInsert(struct Branch *psBranch, size_t uIndex,
+                                  size_t uPrefix, const char *pcKey,
+                                  void *pvChild) {
+   size_t uMoved = psBranch->uCount - 1 - uIndex;
+
+   assert(psBranch->uCount < BRANCH_CAPACITY);
+
+   memmove(&psBranch->auPrefixes[uIndex + 1], &psBranch->auPrefixes[uIndex],
+           uMoved * sizeof(size_t));
+   memmove(&psBranch->apcKeys[uIndex + 1], &psBranch->apcKeys[uIndex],
+           uMoved * sizeof(const char*));
+   memmove(&psBranch->apvChildren[uIndex + 2],
+           &psBranch->apvChildren[uIndex + 1], uMoved * sizeof(void*));
+   psBranch->auPrefixes[uIndex] = uPrefix;
+   psBranch->apcKeys[uIndex] = pcKey;
+   psBranch->apvChildren[uIndex + 1] = pvChild;
+   psBranch->uCount++;
+}
+
+/* Removes separator uIndex of psBranch, without freeing it, and child
+   uIndex + 1. */
+static void SymTable_branchDelete(struct Branch *psBranch, size_t uIndex) {
+   size_t uMoved = psBranch->uCount - 2 - uIndex;
+
+   memmove(&psBranch->auPrefixes[uIndex], &psBranch->auPrefixes[uIndex + 1],
+           uMoved * sizeof(size_t));
+   memmove(&psBranch->apcKeys[uIndex], &psBranch->apcKeys[uIndex + 1],
+           uMoved * sizeof(const char*));
+   memmove(&psBranch->apvChildren[uIndex + 1],
+           &psBranch->apvChildren[uIndex + 2], uMoved * sizeof(void*));
+   psBranch->uCount--;
+}
+
+/* Adds separator pcKey, whose prefix is uPrefix, and the new node
+   pvChild to its right, to the Branch that psPath records uLevel
+   levels below the root, splitting full Branches on the way up into
+   the spare Branches apsSpare[0] to apsSpare[uSpareCount - 1], one
+   for each full Branch and one more for a new root if every Branch is
+   full. */
+static void SymTable_branchAdd(SymTable_T oSymTable, struct Path *psPath,
+                               size_t uLevel, size_t uPrefix,
+                               const char *pcKey, void *pvChild,
+                               struct Branch *apsSpare[],
+                               size_t uSpareCount) {
+   size_t auPrefixes[BRANCH_CAPACITY];
+   const char *apcKeys[BRANCH_CAPACITY];
+   void *apvChildren[BRANCH_CAPACITY + 1];
+   struct Branch *psBranch;
+   struct Branch *psRight;
+   struct Branch *psRoot;
+   size_t uIndex;
+   size_t uLeftCount;
+
+   while (uLevel > 0) {
+      psBranch = psPath->apsBranches[uLevel - 1];
+      uIndex = psPath->auIndices[uLevel - 1];
+      if (psBranch->uCount < BRANCH_CAPACITY) {
+         SymTable_branchInsert(psBranch, uIndex, uPrefix, pcKey, pvChild);
+         return;
+      }
+
+      /* Lay out all BRANCH_CAPACITY + 1 children, then give the left
+         half to psBranch and the right half to a spare, and pass the
+         separator between the halves up */
+      memcpy(auPrefixes, psBranch->auPrefixes, uIndex * sizeof(size_t));
+      memcpy(apcKeys, psBranch->apcKeys, uIndex * sizeof(const char*));
+      memcpy(apvChildren, psBranch->apvChildren,
+             (uIndex + 1) * sizeof(void*));
+      auPrefixes[uIndex] = uPrefix;
+      apcKeys[uIndex] = pcKey;
+      apvChildren[uIndex + 1] = pvChild;
+      memcpy(&auPrefixes[uIndex + 1], &psBranch->auPrefixes[uIndex],
+             (BRANCH_CAPACITY - 1 - uIndex) * sizeof(size_t));
+      memcpy(&apcKeys[uIndex + 1], &psBranch->apcKeys[uIndex],
+             (BRANCH_CAPACITY - 1 - uIndex) * sizeof(const char*));
+      memcpy(&apvChildren[uIndex + 2], &psBranch->apvChildren[uIndex + 1],
+             (BRANCH_CAPACITY - 1 - uIndex) * sizeof(void*));
+
+      assert(uSpareCount > 0);
+      psRight = apsSpare[--uSpareCount];
+      uLeftCount = (BRANCH_CAPACITY + 2) / 2;
+      psBranch->uCount = uLeftCount;
+      memcpy(psBranch->auPrefixes, auPrefixes,
+             (uLeftCount - 1) * sizeof(size_t));
+      memcpy(psBranch->apcKeys, apcKeys,
+             (uLeftCount - 1) * sizeof(const char*));
+      memcpy(psBranch->apvChildren, apvChildren,
+             uLeftCount * sizeof(void*));
+      psRight->uCount = BRANCH_CAPACITY + 1 - uLeftCount;
+      memcpy(psRight->auPrefixes, &auPrefixes[uLeftCount],
+             (psRight->uCount - 1) * sizeof(size_t));
+      memcpy(psRight->apcKeys, &apcKeys[uLeftCount],
+             (psRight->uCount - 1) * sizeof(const char*));
+      memcpy(psRight->apvChildren, &apvChildren[uLeftCount],
+             psRight->uCount * sizeof(void*));
+
+      uPrefix = auPrefixes[uLeftCount - 1];
+      pcKey = apcKeys[uLeftCount - 1];
+      pvChild = psRight;
+      uLevel--;
+   }
+
+   /* The root itself split */
+   assert(uSpareCount == 1);
+   psRoot = apsSpare[0];
+   psRoot->uCount = 2;
+   psRoot->auPrefixes[0] = uPrefix;
+   psRoot->apcKeys[0] = pcKey;
+   psRoot->apvChildren[0] = oSymTable->pvRoot;
+   psRoot->apvChildren[1] = pvChild;
+   oSymTable->pvRoot = psRoot;
+   oSymTable->uHeight++;
+}
+
+/* Adds the binding pcCopy-pvValue, whose key has prefix uPrefix, at
+   index uIndex of psLeaf, the full Leaf that psPath leads to, by
+   splitting it. Allocates every node and separator that the split
+   needs before changing anything. Returns 1 (TRUE) if successful, or
+   0 (FALSE) if insufficient memory is available, in which case
+   oSymTable is left unchanged. */
+static int SymTable_split(SymTable_T oSymTable, struct Path *psPath,
+                          struct Leaf *psLeaf, size_t uIndex,
+                          size_t uPrefix, const char *pcCopy,
+                          const void *pvValue) {
+   struct Branch *apsSpare[MAX_HEIGHT + 1];
+   struct Leaf *psRight;
+   const char *pcFirst;
+   char *pcSeparator;
+   size_t uSpareCount = 0;
+   size_t uSpare;
+   size_t uLevel;
+   size_t uMoved;
+
+   /* One Branch for each full Branch on the way up, and one for a new
+      root if they are all full */
+   uLevel = oSymTable->uHeight;
+   while (uLevel > 0 &&
+          psPath->apsBranches[uLevel - 1]->uCount == BRANCH_CAPACITY) {
+      uSpareCount++;
+      uLevel--;
+   }
+   if (uLevel == 0) uSpareCount++;
+
+   /* The right half's first key, once pcCopy is in, is the
+      separator */
+   if (uIndex == LEAF_MIN)
+      pcFirst = pcCopy;
+   else if (uIndex < LEAF_MIN)
+      pcFirst = psLeaf->apcKeys[LEAF_MIN - 1];
+   else
+      pcFirst = psLeaf->apcKeys[LEAF_MIN];
+
+   psRight = (struct Leaf*)malloc(sizeof(struct Leaf));
+   pcSeparator = SymTable_copyKey(pcFirst, strlen(pcFirst));
+   for (uSpare = 0; uSpare < uSpareCount; uSpare++) {
+      apsSpare[uSpare] = (struct Branch*)malloc(sizeof(struct Branch));
+      if (apsSpare[uSpare] == NULL) break;
+   }
+   if (psRight == NULL || pcSeparator == NULL || uSpare < uSpareCount) {
+      while (uSpare > 0) free(apsSpare[--uSpare]);
+      free(pcSeparator);
+      free(psRight);
+      return 0;
+   }
+
+   /* Give the upper half to psRight, then add the binding to
+      whichever half it belongs in */
+   uMoved = LEAF_CAPACITY - LEAF_MIN;
+   if (uIndex < LEAF_MIN) uMoved++;
+   psLeaf->uCount -= uMoved;
+   memcpy(psRight->auPrefixes, &psLeaf->auPrefixes[psLeaf->uCount],
+          uMoved * sizeof(size_t));
+   memcpy(psRight->apcKeys, &psLeaf->apcKeys[psLeaf->uCount],
+          uMoved * sizeof(const char*));
+   memcpy(psRight->apvValues, &psLeaf->apvValues[psLeaf->uCount],
+          uMoved * sizeof(const void*));
+   psRight->uCount = uMoved;
+   psRight->psNextLeaf = psLeaf->psNextLeaf;
+   psLeaf->psNextLeaf = psRight;
+   if (uIndex < LEAF_MIN)
+      SymTable_leafInsert(psLeaf, uIndex, uPrefix, pcCopy, pvValue);
+   else
+      SymTable_leafInsert(psRight, uIndex - LEAF_MIN, uPrefix, pcCopy,
+                          pvValue);
+
+   SymTable_branchAdd(oSymTable, psPath, oSymTable->uHeight,
+                      SymTable_prefix(pcSeparator, strlen(pcSeparator)),
+                      pcSeparator, psRight, apsSpare, uSpareCount);
+   return 1;
+}
+
+int SymTable_put(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_putN(oSymTable, pcKey, strlen(pcKey), pvValue);
+}
+
+/* Adds the binding of the uLength characters at pcKey to pvValue to
+   oSymTable, unless the key is there already. Returns the address of
+   the value of the binding with the key, or NULL if insufficient
+   memory is available to add it, and sets *piInserted to 1 (TRUE) if
+   the binding was added or to 0 (FALSE) otherwise. */
+static const void **SymTable_add(SymTable_T oSymTable, const char *pcKey,
+                                 size_t uLength, const void *pvValue,
+                                 int *piInserted) {
+   struct Path sPath;
+   struct Leaf *psLeaf;
+   const char *pcCopy;
+   size_t uPrefix;
+   size_t uIndex;
+   int iFound;
+
+   *piInserted = 0;
+   uPrefix = SymTable_prefix(pcKey, uLength);
+   psLeaf = SymTable_descend(oSymTable, uPrefix, pcKey, uLength, &sPath);
+   uIndex = SymTable_leafSearch(psLeaf, uPrefix, pcKey, uLength, &iFound);
+   SymTable_countLookup(oSymTable, iFound, oSymTable->uHeight + 1);
+   if (iFound)
+      return &psLeaf->apvValues[uIndex];
+
+   if (oSymTable->iBorrowedKeys) {
+      assert(pcKey[uLength] == '\0');
+      pcCopy = pcKey;
+   }
+   else {
+      pcCopy = SymTable_copyKey(pcKey, uLength);
+      if (pcCopy == NULL)
+         return NULL;
+   }
+
+   if (psLeaf->uCount < LEAF_CAPACITY)
+      SymTable_leafInsert(psLeaf, uIndex, uPrefix, pcCopy, pvValue);
+   else {
+      if (! SymTable_split(oSymTable, &sPath, psLeaf, uIndex, uPrefix,
+                           pcCopy, pvValue)) {
+         if (! oSymTable->iBorrowedKeys)
+            free((char*)pcCopy);
+         return NULL;
+      }
+
+      /* The split put the binding in the left half if it came before
+         LEAF_MIN, and in the new right half otherwise */
+      if (uIndex >= LEAF_MIN) {
+         psLeaf = psLeaf->psNextLeaf;
+         uIndex -= LEAF_MIN;
+      }
+   }
+
+   oSymTable->nodeCount++;
+   oSymTable->uVersion++;
+   *piInserted = 1;
+   return &psLeaf->apvValues[uIndex];
+}
+
+int SymTable_putN(SymTable_T oSymTable, const char *pcKey, size_t uLength,
+                  const void *pvValue) {
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   (void)SymTable_add(oSymTable, pcKey, uLength, pvValue, &iInserted);
+   return iInserted;
+}
+
+void **SymTable_findOrInsert(SymTable_T oSymTable, const char *pcKey,
+                             const void *pvDefault, int *piInserted) {
+   const void **ppvValue;
+   int iInserted;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   ppvValue = SymTable_add(oSymTable, pcKey, strlen(pcKey), pvDefault,
+                           &iInserted);
+   if (piInserted != NULL) *piInserted = iInserted;
+   return (void**)ppvValue;
+}
+
+int SymTable_upsert(SymTable_T oSymTable, const char *pcKey,
+                    const void *pvDefault,
+                    void *(*pfUpdate)(const char *pcKey, void *pvValue,
+                                      void *pvExtra),
+                    const void *pvExtra, int *piInserted) {
+   void **ppvValue;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   ppvValue = SymTable_findOrInsert(oSymTable, pcKey, pvDefault,
+                                    piInserted);
+   if (ppvValue == NULL) return 0;
+   if (pfUpdate != NULL)
+      *ppvValue = (*pfUpdate)(pcKey, *ppvValue, (void*)pvExtra);
+   return 1;
+}
+
+/* Bindings go in one at a time, each into the node that holds its
+   neighbours. */
+size_t SymTable_putMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        const void *const apvValues[], size_t uCount,
+                        int aiResults[]) {
+   size_t u;
+   size_t uAdded = 0;
+   int iSuccessful;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (u = 0; u < uCount; u++) {
+      iSuccessful = SymTable_put(oSymTable, apcKeys[u], apvValues[u]);
+      if (aiResults != NULL) aiResults[u] = iSuccessful;
+      if (iSuccessful) uAdded++;
+   }
+   return uAdded;
+}
+
+void *SymTable_replace(SymTable_T oSymTable, const char *pcKey, const void *pvValue) {
+   struct Leaf *psLeaf;
+   const void *tempValue;
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uIndex = SymTable_find(oSymTable, pcKey, strlen(pcKey), &psLeaf);
+   if (uIndex == LEAF_CAPACITY) return NULL;
+
+   tempValue = psLeaf->apvValues[uIndex];
+   psLeaf->apvValues[uIndex] = pvValue;
+   return (void *) tempValue;
+}
+
+int SymTable_contains(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_containsN(oSymTable, pcKey, strlen(pcKey));
+}
+
+int SymTable_containsN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct Leaf *psLeaf;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_find(oSymTable, pcKey, uLength, &psLeaf)
+      != LEAF_CAPACITY;
+}
+
+void *SymTable_get(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_getN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_getN(SymTable_T oSymTable, const char *pcKey,
+                    size_t uLength) {
+   struct Leaf *psLeaf;
+   size_t uIndex;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uIndex = SymTable_find(oSymTable, pcKey, uLength, &psLeaf);
+   if (uIndex == LEAF_CAPACITY) return NULL;
+   return (void*)psLeaf->apvValues[uIndex];
+}
+
+/* Each key is looked up on its own. */
+size_t SymTable_getMany(SymTable_T oSymTable, const char *const apcKeys[],
+                        size_t uCount, void *apvValues[]) {
+   struct Leaf *psLeaf;
+   size_t uIndex;
+   size_t u;
+   size_t uFound = 0;
+
+   assert(oSymTable != NULL);
+   assert(apcKeys != NULL);
+   assert(apvValues != NULL);
+
+   for (u = 0; u < uCount; u++) {
+      assert(apcKeys[u] != NULL);
+      uIndex = SymTable_find(oSymTable, apcKeys[u], strlen(apcKeys[u]),
+                             &psLeaf);
+      if (uIndex != LEAF_CAPACITY) {
+         apvValues[u] = (void*)psLeaf->apvValues[uIndex];
+         uFound++;
+      }
+      else
+         apvValues[u] = NULL;
+   }
+   return uFound;
+}
+
+/* Refills or merges the Branch that psPath records uLevel levels below
+   the root, which has just lost a child, and so on up the tree, and
+   drops a root left with only one child. */
+static void SymTable_fixBranch(SymTable_T oSymTable, struct Path *psPath,
+                               size_t uLevel) {
+   struct Branch *psBranch;
+   struct Branch *psParent;
+   struct Branch *psLeft;
+   struct Branch *psRight;
+   size_t uIndex;
+
+   for (;;) {
+      psBranch = psPath->apsBranches[uLevel];
+      if (uLevel == 0) {
+         if (psBranch->uCount == 1) {
+            oSymTable->pvRoot = psBranch->apvChildren[0];
+            oSymTable->uHeight--;
+            free(psBranch);
+         }
+         return;
+      }
+      if (psBranch->uCount >= BRANCH_MIN) return;
+
+      psParent = psPath->apsBranches[uLevel - 1];
+      uIndex = psPath->auIndices[uLevel - 1];
+
+      /* Merge with a neighbour if the two fit in one Branch, pulling
+         their separator down between them; the parent loses a
+         child */
+      if (uIndex > 0) {
+         psLeft = (struct Branch*)psParent->apvChildren[uIndex - 1];
+         psRight = psBranch;
+         uIndex--;
+      }
+      else {
+         psLeft = psBranch;
+         psRight = (struct Branch*)psParent->apvChildren[uIndex + 1];
+      }
+      if (psLeft->uCount + psRight->uCount <= BRANCH_CAPACITY) {
+         psLeft->auPrefixes[psLeft->uCount - 1] =
+            psParent->auPrefixes[uIndex];
+         psLeft->apcKeys[psLeft->uCount - 1] = psParent->apcKeys[uIndex];
+         memcpy(&psLeft->auPrefixes[psLeft->uCount], psRight->auPrefixes,
+                (psRight->uCount - 1) * sizeof(size_t));
+         memcpy(&psLeft->apcKeys[psLeft->uCount], psRight->apcKeys,
+                (psRight->uCount - 1) * sizeof(const char*));
+         memcpy(&psLeft->apvChildren[psLeft->uCount],
+                psRight->apvChildren, psRight->uCount * sizeof(void*));
+         psLeft->uCount += psRight->uCount;
+         free(psRight);
+         SymTable_branchDelete(psParent, uIndex);
+         uLevel--;
+         continue;
+      }
+
+      /* Otherwise move one child across, rotating the separators
+         through the parent */
+      if (psRight == psBranch) {
+         SymTable_branchInsert(psBranch, 0, psParent->auPrefixes[uIndex],
+                               psParent->apcKeys[uIndex],
+                               psBranch->apvChildren[0]);
+         psBranch->apvChildren[0] =
+            psLeft->apvChildren[psLeft->uCount - 1];
+         psParent->auPrefixes[uIndex] =
+            psLeft->auPrefixes[psLeft->uCount - 2];
+         psParent->apcKeys[uIndex] = psLeft->apcKeys[psLeft->uCount - 2];
+         psLeft->uCount--;
+      }
+      else {
+         SymTable_branchInsert(psBranch, psBranch->uCount - 1,
+                               psParent->auPrefixes[uIndex],
+                               psParent->apcKeys[uIndex],
+                               psRight->apvChildren[0]);
+         psParent->auPrefixes[uIndex] = psRight->auPrefixes[0];
+         psParent->apcKeys[uIndex] = psRight->apcKeys[0];
+         memmove(psRight->auPrefixes, &psRight->auPrefixes[1],
+                 (psRight->uCount - 2) * sizeof(size_t));
+         memmove(psRight->apcKeys, &psRight->apcKeys[1],
+                 (psRight->uCount - 2) * sizeof(const char*));
+         memmove(psRight->apvChildren, &psRight->apvChildren[1],
+                 (psRight->uCount - 1) * sizeof(void*));
+         psRight->uCount--;
+      }
+      return;
+   }
+}
+
+/* Refills or merges psLeaf, the Leaf that psPath leads to, which has
+   just lost a binding. Merging is tried first, since moving a binding
+   across needs a new separator; if there is no memory for one, the
+   Leaf is left less than half full, which costs space but not
+   correctness. */
+static void SymTable_fixLeaf(SymTable_T oSymTable, struct Path *psPath,
+                             struct Leaf *psLeaf) {
+   struct Branch *psParent;
+   struct Leaf *psLeft;
+   struct Leaf *psRight;
+   char *pcSeparator;
+   size_t uIndex;
+   size_t uLevel;
+
+   if (oSymTable->uHeight == 0 || psLeaf->uCount >= LEAF_MIN) return;
+
+   uLevel = oSymTable->uHeight - 1;
+   psParent = psPath->apsBranches[uLevel];
+   uIndex = psPath->auIndices[uLevel];
+   if (uIndex > 0) {
+      psLeft = (struct Leaf*)psParent->apvChildren[uIndex - 1];
+      psRight = psLeaf;
+      uIndex--;
+   }
+   else {
+      psLeft = psLeaf;
+      psRight = (struct Leaf*)psParent->apvChildren[uIndex + 1];
+   }
+
+   if (psLeft->uCount + psRight->uCount <= LEAF_CAPACITY) {
+      memcpy(&psLeft->auPrefixes[psLeft->uCount], psRight->auPrefixes,
+             psRight->uCount * sizeof(size_t));
+      memcpy(&psLeft->apcKeys[psLeft->uCount], psRight->apcKeys,
+             psRight->uCount * sizeof(const char*));
+      memcpy(&psLeft->apvValues[psLeft->uCount], psRight->apvValues,
+             psRight->uCount * sizeof(const void*));
+      psLeft->uCount += psRight->uCount;
+      psLeft->psNextLeaf = psRight->psNextLeaf;
+      free(psRight);
+      free((char*)psParent->apcKeys[uIndex]);
+      SymTable_branchDelete(psParent, uIndex);
+      SymTable_fixBranch(oSymTable, psPath, uLevel);
+      return;
+   }
+
+   if (psRight == psLeaf) {
+      pcSeparator = SymTable_copyKey(
+         psLeft->apcKeys[psLeft->uCount - 1],
+         strlen(psLeft->apcKeys[psLeft->uCount - 1]));
+      if (pcSeparator == NULL) return;
+      SymTable_leafInsert(psLeaf, 0, psLeft->auPrefixes[psLeft->uCount - 1],
+                          psLeft->apcKeys[psLeft->uCount - 1],
+                          psLeft->apvValues[psLeft->uCount - 1]);
+      psLeft->uCount--;
+   }
+   else {
+      pcSeparator = SymTable_copyKey(psRight->apcKeys[1],
+                                     strlen(psRight->apcKeys[1]));
+      if (pcSeparator == NULL) return;
+      SymTable_leafInsert(psLeaf, psLeaf->uCount, psRight->auPrefixes[0],
+                          psRight->apcKeys[0], psRight->apvValues[0]);
+      SymTable_leafDelete(psRight, 0);
+   }
+   free((char*)psParent->apcKeys[uIndex]);
+   psParent->auPrefixes[uIndex] = SymTable_prefix(pcSeparator,
+                                                  strlen(pcSeparator));
+   psParent->apcKeys[uIndex] = pcSeparator;
+}
+
+void *SymTable_remove(SymTable_T oSymTable, const char *pcKey) {
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   return SymTable_removeN(oSymTable, pcKey, strlen(pcKey));
+}
+
+void *SymTable_removeN(SymTable_T oSymTable, const char *pcKey,
+                       size_t uLength) {
+   struct Path sPath;
+   struct Leaf *psLeaf;
+   const void *tempValue;
+   size_t uPrefix;
+   size_t uIndex;
+   int iFound;
+
+   assert(oSymTable != NULL);
+   assert(pcKey != NULL);
+
+   uPrefix = SymTable_prefix(pcKey, uLength);
+   psLeaf = SymTable_descend(oSymTable, uPrefix, pcKey, uLength, &sPath);
+   uIndex = SymTable_leafSearch(psLeaf, uPrefix, pcKey, uLength, &iFound);
+   SymTable_countLookup(oSymTable, iFound, oSymTable->uHeight + 1);
+   if (! iFound) return NULL;
+
+   tempValue = psLeaf->apvValues[uIndex];
+   if (! oSymTable->iBorrowedKeys)
+      free((char*)psLeaf->apcKeys[uIndex]);
+   SymTable_leafDelete(psLeaf, uIndex);
+   oSymTable->nodeCount--;
+   oSymTable->uVersion++;
+
+   SymTable_fixLeaf(oSymTable, &sPath, psLeaf);
+   return (void *) tempValue;
+}
+
+/* Visits the bindings in key order, along the chain of leaves. */
+void SymTable_map(SymTable_T oSymTable, void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra), const void *pvExtra) {
+   struct Leaf *psLeaf;
+   size_t u;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+
+   for (psLeaf = oSymTable->psFirstLeaf; psLeaf != NULL;
+        psLeaf = psLeaf->psNextLeaf) {
+      for (u = 0; u < psLeaf->uCount; u++)
+         (*pfApply)(psLeaf->apcKeys[u], (void*)psLeaf->apvValues[u],
+                    (void*)pvExtra);
+   }
+}
+
+/* Calls (*pfApply) with pvExtra for each binding of oSymTable, in key
+   order, from the first whose key is no less than pcLow, or from the
+   first binding if pcLow is NULL, until (*pfStop)(pcKey, pvStop)
+   returns 1 (TRUE) for a key. */
+static void SymTable_mapFrom(SymTable_T oSymTable, const char *pcLow,
+                             int (*pfStop)(const char *pcKey,
+                                           const void *pvStop),
+                             const void *pvStop,
+                             void (*pfApply)(const char *pcKey,
+                                             void *pvValue,
+                                             void *pvExtra),
+                             const void *pvExtra) {
+   struct Leaf *psLeaf;
+   size_t uPrefix;
+   size_t uLength;
+   size_t u = 0;
+   int iFound;
+
+   if (pcLow == NULL)
+      psLeaf = oSymTable->psFirstLeaf;
+   else {
+      uLength = strlen(pcLow);
+      uPrefix = SymTable_prefix(pcLow, uLength);
+      psLeaf = SymTable_descend(oSymTable, uPrefix, pcLow, uLength, NULL);
+      u = SymTable_leafSearch(psLeaf, uPrefix, pcLow, uLength, &iFound);
+   }
+
+   for (; psLeaf != NULL; psLeaf = psLeaf->psNextLeaf, u = 0) {
+      for (; u < psLeaf->uCount; u++) {
+         if ((*pfStop)(psLeaf->apcKeys[u], pvStop)) return;
+         (*pfApply)(psLeaf->apcKeys[u], (void*)psLeaf->apvValues[u],
+                    (void*)pvExtra);
+      }
+   }
+}
+
+/* Returns 1 (TRUE) if pcKey is no less than the key pvHigh, which is
+   NULL if there is no upper bound. */
+static int SymTable_atHigh(const char *pcKey, const void *pvHigh) {
+   return pvHigh != NULL && strcmp(pcKey, (const char*)pvHigh) >= 0;
+}
+
+/* Returns 1 (TRUE) if pcKey does not begin with the key pvPrefix. */
+static int SymTable_pastPrefix(const char *pcKey, const void *pvPrefix) {
+   const char *pcPrefix = (const char*)pvPrefix;
+
+   return strncmp(pcKey, pcPrefix, strlen(pcPrefix)) != 0;
+}
+
+void SymTable_mapRange(SymTable_T oSymTable, const char *pcLow,
+                       const char *pcHigh,
+                       void (*pfApply)(const char *pcKey, void *pvValue,
+                                       void *pvExtra),
+                       const void *pvExtra) {
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+
+   SymTable_mapFrom(oSymTable, pcLow, SymTable_atHigh, pcHigh, pfApply,
+                    pvExtra);
+}
+
+/* Every key that begins with pcPrefix sorts at or after it, and all
+   of them sort before any key that does not and is greater. */
+void SymTable_mapPrefix(SymTable_T oSymTable, const char *pcPrefix,
+                        void (*pfApply)(const char *pcKey, void *pvValue,
+                                        void *pvExtra),
+                        const void *pvExtra) {
+   assert(oSymTable != NULL);
+   assert(pcPrefix != NULL);
+   assert(pfApply != NULL);
+
+   SymTable_mapFrom(oSymTable, pcPrefix, SymTable_pastPrefix, pcPrefix,
+                    pfApply, pvExtra);
+}
+
+/* What each thread of SymTable_mapParallel needs. */
+struct MapWork
+{
+   struct Branch *psRoot;
+   size_t uHeight;
+   void (*pfApply)(const char *pcKey, void *pvValue, void *pvExtra);
+   void *pvExtra;
+};
+
+/* Calls (*pfApply) with pvExtra for every binding under pvNode, which
+   is uHeight levels above the leaves. */
+static void SymTable_mapNode(void *pvNode, size_t uHeight,
+                             void (*pfApply)(const char *pcKey,
+                                             void *pvValue,
+                                             void *pvExtra),
+                             void *pvExtra) {
+   struct Leaf *psLeaf;
+   struct Branch *psBranch;
+   size_t u;
+
+   if (uHeight == 0) {
+      psLeaf = (struct Leaf*)pvNode;
+      for (u = 0; u < psLeaf->uCount; u++)
+         (*pfApply)(psLeaf->apcKeys[u], (void*)psLeaf->apvValues[u],
+                    pvExtra);
+      return;
+   }
+
+   psBranch = (struct Branch*)pvNode;
+   for (u = 0; u < psBranch->uCount; u++)
+      SymTable_mapNode(psBranch->apvChildren[u], uHeight - 1, pfApply,
+                       pvExtra);
+}
+
+/* Applies the MapWork at pvWork to children uFirst to uLimit - 1 of
+   the root. */
+static void SymTable_mapChunk(size_t uFirst, size_t uLimit,
+                              void *pvWork) {
+   struct MapWork *psWork = (struct MapWork*)pvWork;
+   size_t u;
+
+   for (u = uFirst; u < uLimit; u++)
+      SymTable_mapNode(psWork->psRoot->apvChildren[u],
+                       psWork->uHeight - 1, psWork->pfApply,
+                       psWork->pvExtra);
+}
+
+/* The threads take the subtrees under the root one at a time, so no
+   more than the root's children share the work. */
+void SymTable_mapParallel(SymTable_T oSymTable,
+                          void (*pfApply)(const char *pcKey,
+                                          void *pvValue, void *pvExtra),
+                          const void *pvExtra, int iThreads) {
+   struct MapWork sWork;
+
+   assert(oSymTable != NULL);
+   assert(pfApply != NULL);
+   assert(iThreads > 0);
+
+   if (oSymTable->uHeight == 0) {
+      SymTable_map(oSymTable, pfApply, pvExtra);
+      return;
+   }
+
+   sWork.psRoot = (struct Branch*)oSymTable->pvRoot;
+   sWork.uHeight = oSymTable->uHeight;
+   sWork.pfApply = pfApply;
+   sWork.pvExtra = (void*)pvExtra;
+   Parallel_run(sWork.psRoot->uCount, 1, SymTable_mapChunk, &sWork,
+                iThreads);
+}
+
+size_t SymTable_mapWorker(void) {
+   return Parallel_worker();
+}
+
+/* pvPosition is the Leaf the iterator is in, and uIndex the next of
+   its bindings to visit. */
+void SymTable_iterBegin(SymTable_T oSymTable, struct SymTableIter *psIter) {
+   assert(oSymTable != NULL);
+   assert(psIter != NULL);
+
+   psIter->oSymTable = oSymTable;
+   psIter->pvPosition = oSymTable->psFirstLeaf;
+   psIter->uIndex = 0;
+   psIter->uVersion = oSymTable->uVersion;
+   psIter->pcKey = NULL;
+   psIter->pvValue = NULL;
+   psIter->iStale = 0;
+}
+
+int SymTable_iterNext(struct SymTableIter *psIter) {
+   const struct Leaf *psLeaf;
+
+   assert(psIter != NULL);
+
+   if (psIter->uVersion != psIter->oSymTable->uVersion)
+      psIter->iStale = 1;
+   if (psIter->iStale) return 0;
+
+   psLeaf = (const struct Leaf*)psIter->pvPosition;
+   while (psLeaf != NULL && psIter->uIndex >= psLeaf->uCount) {
+      psLeaf = psLeaf->psNextLeaf;
+      psIter->uIndex = 0;
+   }
+   psIter->pvPosition = psLeaf;
+   if (psLeaf == NULL) return 0;
+
+   psIter->pcKey = psLeaf->apcKeys[psIter->uIndex];
+   psIter->pvValue = (void*)psLeaf->apvValues[psIter->uIndex];
+   psIter->uIndex++;
+   return 1;
+}
+
+const char *SymTable_iterKey(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pcKey;
+}
+
+void *SymTable_iterValue(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   assert(psIter->pcKey != NULL);
+   return psIter->pvValue;
+}
+
+int SymTable_iterStale(const struct SymTableIter *psIter) {
+   assert(psIter != NULL);
+   return psIter->iStale;
+}
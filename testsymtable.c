@@ -4,6 +4,8 @@
 /*--------------------------------------------------------------------*/
 
 #include "symtable.h"
+#include "symtablefrozen.h"
+#include "symtableio.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -83,6 +85,143 @@ static void printBindingSimple(const char *pcKey, void *pvValue,
 
 /*--------------------------------------------------------------------*/
 
+/* Increment the count at pvExtra if the binding whose key is pcKey
+   has a NULL value or a string value equal to pcKey. */
+
+static void countSelfBinding(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   assert(pcKey != NULL);
+   assert(pvExtra != NULL);
+
+   if (pvValue == NULL || strcmp(pcKey, (char*)pvValue) == 0)
+      (*(size_t*)pvExtra)++;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Increment the count at pvExtra. pcKey and pvValue are unused. */
+
+static void countBinding(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvValue;
+   assert(pvExtra != NULL);
+
+   (*(size_t*)pvExtra)++;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Copy the string value pvValue, or an empty string if pvValue is
+   NULL, into the payload at pvPayload, whose size is at pvExtra.
+   pcKey is unused. */
+
+static void encodeString(const char *pcKey, void *pvValue,
+   void *pvPayload, void *pvExtra)
+{
+   (void)pcKey;
+   assert(pvPayload != NULL);
+   assert(pvExtra != NULL);
+
+   if (pvValue != NULL)
+      strncpy((char*)pvPayload, (char*)pvValue,
+              *(size_t*)pvExtra - 1);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Write the string value pvValue to psFile with its NUL, preceded by
+   1 if pvValue is a string or 0 if it is NULL. Return 1 (TRUE) if
+   successful, or 0 (FALSE) otherwise. pcKey and pvExtra are
+   unused. */
+
+static int writeString(const char *pcKey, void *pvValue, FILE *psFile,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvExtra;
+   assert(psFile != NULL);
+
+   if (pvValue == NULL)
+      return putc(0, psFile) != EOF;
+   return putc(1, psFile) != EOF
+      && fwrite(pvValue, 1, strlen((char*)pvValue) + 1, psFile)
+         == strlen((char*)pvValue) + 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Read a value written by writeString from psFile into *ppvValue,
+   as a new string or NULL, and increment the count of strings at
+   pvExtra. Return 1 (TRUE) if successful, or 0 (FALSE) otherwise.
+   pcKey is unused. */
+
+static int readString(const char *pcKey, void **ppvValue, FILE *psFile,
+   void *pvExtra)
+{
+   char *pcValue;
+   size_t uLength;
+   int iChar;
+
+   (void)pcKey;
+   assert(ppvValue != NULL);
+   assert(psFile != NULL);
+   assert(pvExtra != NULL);
+
+   iChar = getc(psFile);
+   if (iChar == 0)
+   {
+      *ppvValue = NULL;
+      return 1;
+   }
+   if (iChar != 1)
+      return 0;
+
+   uLength = 0;
+   pcValue = (char*)malloc(1);
+   if (pcValue == NULL)
+      return 0;
+   while ((iChar = getc(psFile)) != EOF && iChar != 0)
+   {
+      /* Growing by one keeps the helper simple; values are short. */
+      char *pcNewValue = (char*)realloc(pcValue, uLength + 2);
+      if (pcNewValue == NULL)
+         break;
+      pcValue = pcNewValue;
+      pcValue[uLength++] = (char)iChar;
+   }
+   if (iChar != 0)
+   {
+      free(pcValue);
+      return 0;
+   }
+   pcValue[uLength] = '\0';
+   *ppvValue = pcValue;
+   (*(size_t*)pvExtra)++;
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Free the string value pvValue, if it is not NULL, and decrement the
+   count of strings at pvExtra. pcKey is unused. */
+
+static void freeString(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   (void)pcKey;
+   assert(pvExtra != NULL);
+
+   if (pvValue != NULL)
+   {
+      free(pvValue);
+      (*(size_t*)pvExtra)--;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
 /* Test the most basic SymTable functions. */
 
 static void testBasics(void)
@@ -776,6 +915,1582 @@ static void testCollisions(void)
 
 /*--------------------------------------------------------------------*/
 
+/* Test a SymTable object that takes its memory from an arena,
+   including reuse of the memory of removed bindings. */
+
+static void testArena(void)
+{
+   enum {BINDING_COUNT = 2000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   char acKey[MAX_KEY_LENGTH];
+   char acLongKey[] =
+      "/usr/local/include/a/path/long/enough/to/need/its/own/space.h";
+   char acShortstop[] = "Shortstop";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uLength;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing a SymTable object that uses an arena.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_newWithOptions(SYMTABLE_ARENA);
+   ASSURE(oSymTable != NULL);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+   iSuccessful = SymTable_put(oSymTable, acLongKey, acShortstop);
+   ASSURE(iSuccessful);
+
+   /* Remove every other binding, then put them back. */
+   for (i = 0; i < BINDING_COUNT; i += 2)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_remove(oSymTable, acKey);
+      ASSURE(pcValue == acShortstop);
+   }
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == BINDING_COUNT / 2 + 1);
+
+   for (i = 0; i < BINDING_COUNT; i += 2)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acKey);
+      ASSURE(iSuccessful);
+   }
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == BINDING_COUNT + 1);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_get(oSymTable, acKey);
+      ASSURE(pcValue == ((i % 2 == 0) ? acKey : acShortstop));
+   }
+   pcValue = (char*)SymTable_get(oSymTable, acLongKey);
+   ASSURE(pcValue == acShortstop);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test SymTable objects whose lookups may reorder their bindings, with
+   each of the reordering options, checking that lookups still find
+   the right values however often the same few keys are used. */
+
+static void testReorder(void)
+{
+   enum {BINDING_COUNT = 200, LOOKUP_COUNT = 5000, MAX_KEY_LENGTH = 10};
+   static const int aiOptions[] = {
+      SYMTABLE_MOVE_TO_FRONT, SYMTABLE_TRANSPOSE,
+      SYMTABLE_MOVE_TO_FRONT | SYMTABLE_TRANSPOSE,
+      SYMTABLE_TRANSPOSE | SYMTABLE_ARENA
+   };
+   enum {OPTION_COUNT = sizeof(aiOptions) / sizeof(aiOptions[0])};
+
+   SymTable_T oSymTable;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   char acMissing[] = "missing";
+   size_t uCount;
+   int i;
+   int j;
+   int iOption;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing SymTable objects whose lookups reorder them.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+      sprintf(aacKeys[i], "%d", i);
+
+   for (iOption = 0; iOption < OPTION_COUNT; iOption++)
+   {
+      oSymTable = SymTable_newWithOptions(aiOptions[iOption]);
+      ASSURE(oSymTable != NULL);
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+         ASSURE(iSuccessful);
+      }
+
+      /* Mostly the last keys put, with the occasional other one. */
+      for (j = 0; j < LOOKUP_COUNT; j++)
+      {
+         i = (j % 7 == 0) ? (j * 31) % BINDING_COUNT : j % 4;
+         ASSURE(SymTable_get(oSymTable, aacKeys[i]) == aacKeys[i]);
+         ASSURE(SymTable_contains(oSymTable, aacKeys[i]));
+         ASSURE(SymTable_replace(oSymTable, aacKeys[i], aacKeys[i])
+            == aacKeys[i]);
+         ASSURE(SymTable_get(oSymTable, acMissing) == NULL);
+      }
+
+      /* Every binding is still there, once. */
+      ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT);
+      uCount = 0;
+      SymTable_map(oSymTable, countSelfBinding, &uCount);
+      ASSURE(uCount == BINDING_COUNT);
+
+      /* Removing the hot keys leaves the rest. */
+      for (i = 0; i < 4; i++)
+         ASSURE(SymTable_remove(oSymTable, aacKeys[i]) == aacKeys[i]);
+      for (i = 0; i < BINDING_COUNT; i++)
+         ASSURE(SymTable_contains(oSymTable, aacKeys[i]) == (i >= 4));
+      ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT - 4);
+
+      SymTable_free(oSymTable);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test SymTable objects that borrow their keys instead of copying
+   them, checking that each binding's key is the caller's own pointer
+   and that keys that are equal but elsewhere still match. */
+
+static void testBorrowedKeys(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 40};
+   static const int aiOptions[] = {
+      SYMTABLE_BORROWED_KEYS, SYMTABLE_BORROWED_KEYS | SYMTABLE_ARENA
+   };
+   enum {OPTION_COUNT = sizeof(aiOptions) / sizeof(aiOptions[0])};
+
+   static char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   SymTable_T oSymTable;
+   struct SymTableIter sIter;
+   char acCopy[MAX_KEY_LENGTH];
+   size_t uCount;
+   int i;
+   int iOption;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing SymTable objects that borrow their keys.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   /* Some keys short enough to be stored inline when copied, and some
+      too long to be. */
+   for (i = 0; i < BINDING_COUNT; i++)
+      sprintf(aacKeys[i], (i % 2 == 0) ? "%d" : "a/long/enough/key/%d", i);
+
+   for (iOption = 0; iOption < OPTION_COUNT; iOption++)
+   {
+      oSymTable = SymTable_newWithOptions(aiOptions[iOption]);
+      ASSURE(oSymTable != NULL);
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+         ASSURE(iSuccessful);
+      }
+
+      /* The table holds the very pointers it was given. */
+      uCount = 0;
+      SymTable_iterBegin(oSymTable, &sIter);
+      while (SymTable_iterNext(&sIter))
+      {
+         ASSURE(SymTable_iterKey(&sIter) == SymTable_iterValue(&sIter));
+         uCount++;
+      }
+      ASSURE(uCount == BINDING_COUNT);
+
+      /* Equal keys at other addresses match too. */
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         strcpy(acCopy, aacKeys[i]);
+         ASSURE(SymTable_get(oSymTable, aacKeys[i]) == aacKeys[i]);
+         ASSURE(SymTable_get(oSymTable, acCopy) == aacKeys[i]);
+         iSuccessful = SymTable_put(oSymTable, acCopy, acCopy);
+         ASSURE(! iSuccessful);
+      }
+
+      /* Removing a binding leaves its key to the caller. */
+      for (i = 0; i < BINDING_COUNT; i += 2)
+      {
+         strcpy(acCopy, aacKeys[i]);
+         ASSURE(SymTable_remove(oSymTable, acCopy) == aacKeys[i]);
+      }
+      for (i = 0; i < BINDING_COUNT; i++)
+         ASSURE(SymTable_contains(oSymTable, aacKeys[i]) == (i % 2 != 0));
+      ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT / 2);
+
+      SymTable_free(oSymTable);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test SymTable objects that are sized ahead of time, with
+   SymTable_newWithCapacity() and with SymTable_reserve(). */
+
+static void testCapacity(void)
+{
+   enum {BINDING_COUNT = 2000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   SymTable_T oSymTableArena;
+   char acKey[MAX_KEY_LENGTH];
+   char acShortstop[] = "Shortstop";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uLength;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing SymTable objects that are sized ahead of time.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_newWithCapacity(BINDING_COUNT);
+   ASSURE(oSymTable != NULL);
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == 0);
+
+   oSymTableArena = SymTable_newWithOptions(SYMTABLE_ARENA);
+   ASSURE(oSymTableArena != NULL);
+   iSuccessful = SymTable_put(oSymTableArena, "Jeter", acShortstop);
+   ASSURE(iSuccessful);
+   iSuccessful = SymTable_reserve(oSymTableArena, BINDING_COUNT);
+   ASSURE(iSuccessful);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+      iSuccessful = SymTable_put(oSymTableArena, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+
+   /* Reserving less than the current length changes nothing. */
+   iSuccessful = SymTable_reserve(oSymTable, 1);
+   ASSURE(iSuccessful);
+
+   /* Reserving more keeps every binding. */
+   iSuccessful = SymTable_reserve(oSymTable, 4 * BINDING_COUNT);
+   ASSURE(iSuccessful);
+
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == BINDING_COUNT);
+   uLength = SymTable_getLength(oSymTableArena);
+   ASSURE(uLength == BINDING_COUNT + 1);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_get(oSymTable, acKey);
+      ASSURE(pcValue == acShortstop);
+      pcValue = (char*)SymTable_get(oSymTableArena, acKey);
+      ASSURE(pcValue == acShortstop);
+   }
+   pcValue = (char*)SymTable_get(oSymTableArena, "Jeter");
+   ASSURE(pcValue == acShortstop);
+
+   SymTable_free(oSymTableArena);
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test a SymTable object that grows, drains, and is compacted with
+   SymTable_compact(). */
+
+static void testCompact(void)
+{
+   enum {BINDING_COUNT = 5000, KEPT_COUNT = 10, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   char acKey[MAX_KEY_LENGTH];
+   char acShortstop[] = "Shortstop";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uLength;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing a SymTable object that drains and is compacted.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+
+   /* Drain all but a few bindings. */
+   for (i = KEPT_COUNT; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_remove(oSymTable, acKey);
+      ASSURE(pcValue == acShortstop);
+   }
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == KEPT_COUNT);
+
+   SymTable_compact(oSymTable);
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == KEPT_COUNT);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_get(oSymTable, acKey);
+      ASSURE(pcValue == ((i < KEPT_COUNT) ? acShortstop : NULL));
+   }
+
+   /* The table still grows after it has been compacted. */
+   for (i = KEPT_COUNT; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == BINDING_COUNT);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Assure that *psStats is consistent with itself: the histogram
+   counts every bucket once, and the load factor and longest chain
+   agree with the other fields. */
+
+static void checkStats(const struct SymTableStats *psStats)
+{
+   size_t uBuckets = 0;
+   size_t uLongest = 0;
+   size_t u;
+
+   for (u = 0; u < SYMTABLE_HISTOGRAM_SIZE; u++)
+   {
+      uBuckets += psStats->auChains[u];
+      if (psStats->auChains[u] != 0)
+         uLongest = u;
+   }
+   ASSURE(psStats->uBuckets >= 1);
+   ASSURE(uBuckets == psStats->uBuckets);
+   if (psStats->uMaxChain < SYMTABLE_HISTOGRAM_SIZE - 1)
+      ASSURE(psStats->uMaxChain == uLongest);
+   else
+      ASSURE(uLongest == SYMTABLE_HISTOGRAM_SIZE - 1);
+   ASSURE(psStats->dLoadFactor ==
+          (double)psStats->uBindings / (double)psStats->uBuckets);
+   ASSURE(psStats->uBytes > 0);
+   ASSURE(psStats->uHitProbes >= psStats->uHits);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_getStats() function. */
+
+static void testStats(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   SymTable_T oSymTableArena;
+   struct SymTableStats sEmpty;
+   struct SymTableStats sFull;
+   struct SymTableStats sLooked;
+   char acKey[MAX_KEY_LENGTH];
+   char acShortstop[] = "Shortstop";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_getStats() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   oSymTableArena = SymTable_newWithOptions(SYMTABLE_ARENA);
+   ASSURE(oSymTableArena != NULL);
+
+   SymTable_getStats(oSymTable, &sEmpty);
+   checkStats(&sEmpty);
+   ASSURE(sEmpty.uBindings == 0);
+   ASSURE(sEmpty.uMaxChain == 0);
+   ASSURE(sEmpty.uResizes == 0);
+   ASSURE(sEmpty.uFailedResizes == 0);
+   ASSURE(sEmpty.uHits == 0);
+   ASSURE(sEmpty.uMisses == 0);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+      iSuccessful = SymTable_put(oSymTableArena, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+
+   SymTable_getStats(oSymTable, &sFull);
+   checkStats(&sFull);
+   ASSURE(sFull.uBindings == BINDING_COUNT);
+   ASSURE(sFull.uMaxChain >= 1);
+   ASSURE(sFull.uBytes > sEmpty.uBytes);
+   ASSURE(sFull.uFailedResizes == 0);
+
+   /* Every binding lives somewhere, whether or not in an Arena. */
+   SymTable_getStats(oSymTableArena, &sLooked);
+   checkStats(&sLooked);
+   ASSURE(sLooked.uBindings == BINDING_COUNT);
+   ASSURE(sLooked.uBytes > sEmpty.uBytes);
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      pcValue = (char*)SymTable_get(oSymTable, acKey);
+      ASSURE(pcValue == acShortstop);
+      sprintf(acKey, "%d", -1 - i);
+      pcValue = (char*)SymTable_get(oSymTable, acKey);
+      ASSURE(pcValue == NULL);
+   }
+
+   /* Lookups leave the layout alone, and are counted only if the
+      implementation counts them at all. */
+   SymTable_getStats(oSymTable, &sLooked);
+   checkStats(&sLooked);
+   ASSURE(sLooked.uBindings == sFull.uBindings);
+   ASSURE(sLooked.uBuckets == sFull.uBuckets);
+   ASSURE(sLooked.uResizes == sFull.uResizes);
+#ifdef SYMTABLE_STATS
+   ASSURE(sLooked.uHits == sFull.uHits + BINDING_COUNT);
+   ASSURE(sLooked.uMisses == sFull.uMisses + BINDING_COUNT);
+   ASSURE(sLooked.uHitProbes >= sFull.uHitProbes + BINDING_COUNT);
+#else
+   ASSURE(sLooked.uHits == 0);
+   ASSURE(sLooked.uHitProbes == 0);
+   ASSURE(sLooked.uMisses == 0);
+   ASSURE(sLooked.uMissProbes == 0);
+#endif
+
+   SymTable_free(oSymTableArena);
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Put the binding pcKey-pvValue into the SymTable_T at pvExtra. */
+
+static void copyBinding(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   int iSuccessful;
+
+   assert(pcKey != NULL);
+   assert(pvExtra != NULL);
+
+   iSuccessful = SymTable_put((SymTable_T)pvExtra, pcKey, pvValue);
+   ASSURE(iSuccessful);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test copying a SymTable_T into a new one through SymTable_map(),
+   which puts the bindings in the order the first table keeps them.
+   While the copy is still small, that order must not crowd its
+   bindings together, so the puts of the copy may probe no more than
+   those that built the first table. */
+
+static void testMapCopy(void)
+{
+   enum {BINDING_COUNT = 20000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   SymTable_T oCopy;
+   struct SymTableStats sStats;
+   struct SymTableStats sCopyStats;
+   char acKey[MAX_KEY_LENGTH];
+   char acShortstop[] = "Shortstop";
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing copying a table with SymTable_map().\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      iSuccessful = SymTable_put(oSymTable, acKey, acShortstop);
+      ASSURE(iSuccessful);
+   }
+
+   oCopy = SymTable_new();
+   ASSURE(oCopy != NULL);
+   SymTable_map(oSymTable, copyBinding, oCopy);
+   ASSURE(SymTable_getLength(oCopy) == BINDING_COUNT);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(acKey, "%d", i);
+      ASSURE(SymTable_get(oCopy, acKey) == acShortstop);
+   }
+
+   /* The probes are counted only if SYMTABLE_STATS is defined, and
+      are otherwise 0. */
+   SymTable_getStats(oSymTable, &sStats);
+   SymTable_getStats(oCopy, &sCopyStats);
+   checkStats(&sCopyStats);
+   ASSURE(sCopyStats.uMisses == sStats.uMisses);
+   ASSURE(sCopyStats.uMissProbes
+          <= 2 * sStats.uMissProbes + BINDING_COUNT);
+
+   SymTable_free(oCopy);
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_putMany() function. */
+
+static void testPutMany(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   const char *apcKeys[BINDING_COUNT];
+   const void *apvValues[BINDING_COUNT];
+   int aiResults[BINDING_COUNT];
+   char acShortstop[] = "Shortstop";
+   char acCenterField[] = "Center Field";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uAdded;
+   size_t uLength;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_putMany() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   iSuccessful = SymTable_put(oSymTable, "7", acCenterField);
+   ASSURE(iSuccessful);
+
+   /* Key 7 is already bound, and the last key repeats key 0. */
+   for (i = 0; i < BINDING_COUNT - 1; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      apcKeys[i] = aacKeys[i];
+      apvValues[i] = acShortstop;
+   }
+   apcKeys[BINDING_COUNT - 1] = "0";
+   apvValues[BINDING_COUNT - 1] = acCenterField;
+
+   uAdded = SymTable_putMany(oSymTable, apcKeys, apvValues,
+                             BINDING_COUNT, aiResults);
+   ASSURE(uAdded == BINDING_COUNT - 2);
+   ASSURE(aiResults[0]);
+   ASSURE(! aiResults[7]);
+   ASSURE(! aiResults[BINDING_COUNT - 1]);
+
+   uLength = SymTable_getLength(oSymTable);
+   ASSURE(uLength == BINDING_COUNT - 1);
+
+   pcValue = (char*)SymTable_get(oSymTable, "7");
+   ASSURE(pcValue == acCenterField);
+   for (i = 0; i < BINDING_COUNT - 1; i++)
+   {
+      pcValue = (char*)SymTable_get(oSymTable, aacKeys[i]);
+      ASSURE(pcValue == ((i == 7) ? acCenterField : acShortstop));
+   }
+
+   /* A batch of known keys adds nothing, and results are optional. */
+   uAdded = SymTable_putMany(oSymTable, apcKeys, apvValues,
+                             BINDING_COUNT, NULL);
+   ASSURE(uAdded == 0);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_getMany() function. */
+
+static void testGetMany(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   char aacKeys[2 * BINDING_COUNT][MAX_KEY_LENGTH];
+   const char *apcKeys[2 * BINDING_COUNT];
+   void *apvValues[2 * BINDING_COUNT];
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uFound;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_getMany() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   /* Bind the even keys to themselves, and look up every key. */
+   for (i = 0; i < 2 * BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      apcKeys[i] = aacKeys[i];
+      if (i % 2 == 0)
+      {
+         iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+         ASSURE(iSuccessful);
+      }
+   }
+
+   uFound = SymTable_getMany(oSymTable, apcKeys, 2 * BINDING_COUNT,
+                             apvValues);
+   ASSURE(uFound == BINDING_COUNT);
+   for (i = 0; i < 2 * BINDING_COUNT; i++)
+   {
+      pcValue = (char*)apvValues[i];
+      ASSURE(pcValue == ((i % 2 == 0) ? aacKeys[i] : NULL));
+   }
+
+   uFound = SymTable_getMany(oSymTable, apcKeys, 0, apvValues);
+   ASSURE(uFound == 0);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_findOrInsert() function by counting the
+   occurrences of keys, each through the value slot it returns. */
+
+static void testFindOrInsert(void)
+{
+   enum {BINDING_COUNT = 1000, ROUND_COUNT = 3, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   static char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   static int aiCounts[BINDING_COUNT];
+   struct SymTableStats sStats;
+   void **ppvValue;
+   size_t uCalls = 0;
+   int iRound;
+   int iInserted;
+   int iCounters = 0;
+   int i;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_findOrInsert() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   /* An implementation that several threads may change at once hands
+      out no addresses, and leaves the table unchanged. */
+   ppvValue = SymTable_findOrInsert(oSymTable, "probe", NULL, &iInserted);
+   if (ppvValue == NULL)
+   {
+      ASSURE(! iInserted);
+      ASSURE(SymTable_getLength(oSymTable) == 0);
+      SymTable_free(oSymTable);
+      return;
+   }
+   ASSURE(iInserted);
+   SymTable_free(oSymTable);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   /* Key i occurs in the first i % ROUND_COUNT + 1 rounds. A new key
+      is bound to the next free counter, and every occurrence adds one
+      to its key's counter. */
+   for (i = 0; i < BINDING_COUNT; i++)
+      sprintf(aacKeys[i], "%d", i);
+   for (iRound = 0; iRound < ROUND_COUNT; iRound++)
+   {
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         if (i % ROUND_COUNT < iRound)
+            continue;
+         ppvValue = SymTable_findOrInsert(oSymTable, aacKeys[i],
+                                          &aiCounts[iCounters],
+                                          &iInserted);
+         uCalls++;
+         ASSURE(ppvValue != NULL);
+         ASSURE(iInserted == (iRound == 0));
+         if (iInserted)
+         {
+            ASSURE(*ppvValue == &aiCounts[iCounters]);
+            iCounters++;
+         }
+         (*(int*)*ppvValue)++;
+      }
+   }
+   ASSURE(iCounters == BINDING_COUNT);
+   ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT);
+
+   /* Each call is one lookup, even if it resized the table. */
+   SymTable_getStats(oSymTable, &sStats);
+#ifdef SYMTABLE_STATS
+   ASSURE(sStats.uHits + sStats.uMisses == uCalls);
+   ASSURE(sStats.uHits == uCalls - BINDING_COUNT);
+#else
+   ASSURE(sStats.uHits + sStats.uMisses == 0);
+#endif
+   for (i = 0; i < BINDING_COUNT; i++)
+      ASSURE(*(int*)SymTable_get(oSymTable, aacKeys[i])
+             == i % ROUND_COUNT + 1);
+
+   /* Storing through the slot replaces the value */
+   ppvValue = SymTable_findOrInsert(oSymTable, aacKeys[0], NULL, NULL);
+   ASSURE(ppvValue != NULL);
+   *ppvValue = aacKeys[0];
+   ASSURE(SymTable_get(oSymTable, aacKeys[0]) == aacKeys[0]);
+
+   /* So does storing through the slot of a new binding */
+   ppvValue = SymTable_findOrInsert(oSymTable, "new", NULL, &iInserted);
+   ASSURE(ppvValue != NULL);
+   ASSURE(iInserted);
+   ASSURE(*ppvValue == NULL);
+   *ppvValue = aacKeys[1];
+   ASSURE(SymTable_get(oSymTable, "new") == aacKeys[1]);
+   ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT + 1);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Add one to the int that pvValue points to, and return pvValue.
+   pcKey and pvExtra are unused. */
+
+static void *incrementCount(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvExtra;
+   assert(pvValue != NULL);
+
+   (*(int*)pvValue)++;
+   return pvValue;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return pvExtra, to become the value of the binding whose key is
+   pcKey. pvValue is unused. */
+
+static void *replaceWithExtra(const char *pcKey, void *pvValue,
+   void *pvExtra)
+{
+   (void)pcKey;
+   (void)pvValue;
+   return pvExtra;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_upsert() function by counting the occurrences of
+   keys, each through an update of its binding's value. */
+
+static void testUpsert(void)
+{
+   enum {BINDING_COUNT = 1000, ROUND_COUNT = 3, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   static char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   static int aiCounts[BINDING_COUNT];
+   struct SymTableStats sStats;
+   size_t uCalls = 0;
+   int iRound;
+   int iInserted;
+   int iSuccessful;
+   int i;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_upsert() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   /* Key i occurs in the first i % ROUND_COUNT + 1 rounds, and is
+      bound to counter i when it first occurs. */
+   for (i = 0; i < BINDING_COUNT; i++)
+      sprintf(aacKeys[i], "%d", i);
+   for (iRound = 0; iRound < ROUND_COUNT; iRound++)
+   {
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         if (i % ROUND_COUNT < iRound)
+            continue;
+         iSuccessful = SymTable_upsert(oSymTable, aacKeys[i],
+                                       &aiCounts[i], incrementCount,
+                                       NULL, &iInserted);
+         uCalls++;
+         ASSURE(iSuccessful);
+         ASSURE(iInserted == (iRound == 0));
+      }
+   }
+   ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT);
+
+   /* Each call is one lookup, even if it resized the table. */
+   SymTable_getStats(oSymTable, &sStats);
+#ifdef SYMTABLE_STATS
+   ASSURE(sStats.uHits + sStats.uMisses == uCalls);
+   ASSURE(sStats.uHits == uCalls - BINDING_COUNT);
+#else
+   ASSURE(sStats.uHits + sStats.uMisses == 0);
+#endif
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      ASSURE(SymTable_get(oSymTable, aacKeys[i]) == &aiCounts[i]);
+      ASSURE(aiCounts[i] == i % ROUND_COUNT + 1);
+   }
+
+   /* The update's result becomes the value */
+   iSuccessful = SymTable_upsert(oSymTable, aacKeys[0], NULL,
+                                 replaceWithExtra, aacKeys[1], NULL);
+   ASSURE(iSuccessful);
+   ASSURE(SymTable_get(oSymTable, aacKeys[0]) == aacKeys[1]);
+   iSuccessful = SymTable_upsert(oSymTable, "new", NULL,
+                                 replaceWithExtra, aacKeys[2],
+                                 &iInserted);
+   ASSURE(iSuccessful);
+   ASSURE(iInserted);
+   ASSURE(SymTable_get(oSymTable, "new") == aacKeys[2]);
+
+   /* Without an update, an existing value is left alone */
+   iSuccessful = SymTable_upsert(oSymTable, "new", aacKeys[3], NULL,
+                                 NULL, &iInserted);
+   ASSURE(iSuccessful);
+   ASSURE(! iInserted);
+   ASSURE(SymTable_get(oSymTable, "new") == aacKeys[2]);
+   iSuccessful = SymTable_upsert(oSymTable, "newer", aacKeys[3], NULL,
+                                 NULL, &iInserted);
+   ASSURE(iSuccessful);
+   ASSURE(iInserted);
+   ASSURE(SymTable_get(oSymTable, "newer") == aacKeys[3]);
+   ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT + 2);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_putN(), SymTable_getN(), SymTable_containsN() and
+   SymTable_removeN() functions, with keys that lie within one buffer
+   and are not followed by '\0'. */
+
+static void testLengthKeys(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 40};
+   static const int aiOptions[] = {0, SYMTABLE_ARENA};
+   enum {OPTION_COUNT = sizeof(aiOptions) / sizeof(aiOptions[0])};
+
+   static char acBuffer[BINDING_COUNT * MAX_KEY_LENGTH];
+   static const char *apcKeys[BINDING_COUNT];
+   static size_t auLengths[BINDING_COUNT];
+   static const char acWord[] = "alphabet";
+   char acKey[MAX_KEY_LENGTH];
+   SymTable_T oSymTable;
+   struct SymTableIter sIter;
+   char *pcNext;
+   int i;
+   int iOption;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_putN(), SymTable_getN(), "
+          "SymTable_containsN() and SymTable_removeN() functions.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   /* Keys separated by spaces, as a tokenizer would find them. Some
+      are short enough to be stored inline, and some too long to be. */
+   pcNext = acBuffer;
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      apcKeys[i] = pcNext;
+      pcNext += sprintf(pcNext,
+                        (i % 2 == 0) ? "%d" : "a/long/enough/key/%d", i);
+      auLengths[i] = (size_t)(pcNext - apcKeys[i]);
+      *pcNext++ = ' ';
+   }
+
+   for (iOption = 0; iOption < OPTION_COUNT; iOption++)
+   {
+      oSymTable = SymTable_newWithOptions(aiOptions[iOption]);
+      ASSURE(oSymTable != NULL);
+
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         iSuccessful = SymTable_putN(oSymTable, apcKeys[i], auLengths[i],
+                                     apcKeys[i]);
+         ASSURE(iSuccessful);
+      }
+      ASSURE(SymTable_getLength(oSymTable) == BINDING_COUNT);
+
+      /* The table's keys are copies that end in '\0', and they are
+         the same keys to the functions that take strings. */
+      SymTable_iterBegin(oSymTable, &sIter);
+      while (SymTable_iterNext(&sIter))
+      {
+         ASSURE(SymTable_iterKey(&sIter) != SymTable_iterValue(&sIter));
+         ASSURE(strncmp(SymTable_iterKey(&sIter),
+                        (const char*)SymTable_iterValue(&sIter),
+                        strlen(SymTable_iterKey(&sIter))) == 0);
+      }
+      for (i = 0; i < BINDING_COUNT; i++)
+      {
+         memcpy(acKey, apcKeys[i], auLengths[i]);
+         acKey[auLengths[i]] = '\0';
+         ASSURE(SymTable_get(oSymTable, acKey) == apcKeys[i]);
+         ASSURE(SymTable_getN(oSymTable, apcKeys[i], auLengths[i])
+                == apcKeys[i]);
+         ASSURE(SymTable_containsN(oSymTable, acKey, auLengths[i]));
+         iSuccessful = SymTable_putN(oSymTable, apcKeys[i], auLengths[i],
+                                     NULL);
+         ASSURE(! iSuccessful);
+
+         /* A key's prefixes and extensions are other keys: a long
+            key less its last digit is bound only if that leaves the
+            long key of another odd number */
+         ASSURE(! SymTable_containsN(oSymTable, apcKeys[i],
+                                     auLengths[i] + 1));
+         if (i % 2 != 0)
+            ASSURE(SymTable_containsN(oSymTable, apcKeys[i],
+                                      auLengths[i] - 1)
+                   == (i >= 10 && (i / 10) % 2 != 0));
+      }
+
+      /* Removing through a slice leaves the other keys alone */
+      for (i = 0; i < BINDING_COUNT; i += 2)
+         ASSURE(SymTable_removeN(oSymTable, apcKeys[i], auLengths[i])
+                == apcKeys[i]);
+      for (i = 0; i < BINDING_COUNT; i++)
+         ASSURE(SymTable_containsN(oSymTable, apcKeys[i], auLengths[i])
+                == (i % 2 != 0));
+      ASSURE(SymTable_removeN(oSymTable, apcKeys[0], auLengths[0])
+             == NULL);
+
+      /* Keys that are prefixes of one another */
+      iSuccessful = SymTable_putN(oSymTable, acWord, 5, "alpha");
+      ASSURE(iSuccessful);
+      iSuccessful = SymTable_putN(oSymTable, acWord, 8, "alphabet");
+      ASSURE(iSuccessful);
+      iSuccessful = SymTable_putN(oSymTable, acWord, 0, "empty");
+      ASSURE(iSuccessful);
+      ASSURE(strcmp((char*)SymTable_get(oSymTable, "alpha"), "alpha")
+             == 0);
+      ASSURE(strcmp((char*)SymTable_getN(oSymTable, acWord, 8),
+                    "alphabet") == 0);
+      ASSURE(strcmp((char*)SymTable_get(oSymTable, ""), "empty") == 0);
+      ASSURE(SymTable_getN(oSymTable, acWord, 4) == NULL);
+      ASSURE(SymTable_getN(oSymTable, acWord, 6) == NULL);
+      ASSURE(strcmp((char*)SymTable_removeN(oSymTable, acWord, 5),
+                    "alpha") == 0);
+      ASSURE(SymTable_contains(oSymTable, "alphabet"));
+      ASSURE(! SymTable_contains(oSymTable, "alpha"));
+
+      SymTable_free(oSymTable);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_freeze() function and the SymTableFrozen_T object
+   that it returns. */
+
+static void testFreeze(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   SymTableFrozen_T oFrozen;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   char acMissingKey[MAX_KEY_LENGTH];
+   const char *pcLongKey =
+      "a key much too long to be stored inside a node";
+   char *pcValue;
+   int i;
+   int iSuccessful;
+   size_t uCount;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_freeze() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   /* An empty table freezes into an empty frozen table. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   oFrozen = SymTable_freeze(oSymTable);
+   ASSURE(oFrozen != NULL);
+   ASSURE(SymTableFrozen_getLength(oFrozen) == 0);
+   ASSURE(! SymTableFrozen_contains(oFrozen, ""));
+   ASSURE(SymTableFrozen_get(oFrozen, "xxx") == NULL);
+   SymTableFrozen_free(oFrozen);
+
+   /* Bind keys to themselves, along with an empty key bound to NULL
+      and a long key. */
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+      ASSURE(iSuccessful);
+   }
+   iSuccessful = SymTable_put(oSymTable, "", NULL);
+   ASSURE(iSuccessful);
+   iSuccessful = SymTable_put(oSymTable, pcLongKey, pcLongKey);
+   ASSURE(iSuccessful);
+
+   /* The frozen table keeps its own keys once oSymTable is gone. */
+   oFrozen = SymTable_freeze(oSymTable);
+   ASSURE(oFrozen != NULL);
+   SymTable_free(oSymTable);
+
+   ASSURE(SymTableFrozen_getLength(oFrozen) == BINDING_COUNT + 2);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      pcValue = (char*)SymTableFrozen_get(oFrozen, aacKeys[i]);
+      ASSURE(pcValue == aacKeys[i]);
+      ASSURE(SymTableFrozen_contains(oFrozen, aacKeys[i]));
+   }
+   ASSURE(SymTableFrozen_contains(oFrozen, ""));
+   ASSURE(SymTableFrozen_get(oFrozen, "") == NULL);
+   ASSURE(SymTableFrozen_get(oFrozen, pcLongKey) == pcLongKey);
+
+   /* Keys that were never put are not found, including prefixes and
+      extensions of keys that were. */
+   for (i = BINDING_COUNT; i < 2 * BINDING_COUNT; i++)
+   {
+      sprintf(acMissingKey, "%d", i);
+      ASSURE(! SymTableFrozen_contains(oFrozen, acMissingKey));
+      ASSURE(SymTableFrozen_get(oFrozen, acMissingKey) == NULL);
+   }
+   ASSURE(! SymTableFrozen_contains(oFrozen, "a key"));
+   ASSURE(! SymTableFrozen_contains(oFrozen, "0 "));
+
+   /* Every binding is visited once. */
+   uCount = 0;
+   SymTableFrozen_map(oFrozen, countSelfBinding, &uCount);
+   ASSURE(uCount == BINDING_COUNT + 2);
+
+   SymTableFrozen_free(oFrozen);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTableFrozen_write() and SymTableFrozen_open()
+   functions, using a file named after pcProgramName, so that test
+   programs built from this file can run at the same time. */
+
+static void testFrozenFile(const char *pcProgramName)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10};
+
+   /* The file's header is 8 characters of magic number followed by
+      HEADER_WORDS size_ts, of which the fourth is the number of
+      buckets and the sixth the size of an entry. */
+   enum {MAGIC_SIZE = 8, HEADER_WORDS = 7};
+
+   const char acSuffix[] = ".frozen";
+   char *pcFileName;
+   SymTable_T oSymTable;
+   SymTableFrozen_T oFrozen;
+   SymTableFrozen_T oMapped;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   char *pcValue;
+   size_t uPayloadSize = MAX_KEY_LENGTH;
+   size_t uCount;
+   size_t auHeader[HEADER_WORDS];
+   size_t uBadOffset = (size_t)-1 / 2;
+   long lEntries;
+   FILE *psFile;
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTableFrozen_write() and SymTableFrozen_open()"
+          " functions.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   pcFileName = (char*)malloc(strlen(pcProgramName) + sizeof(acSuffix));
+   ASSURE(pcFileName != NULL);
+   strcpy(pcFileName, pcProgramName);
+   strcat(pcFileName, acSuffix);
+
+   /* Bind keys to themselves, along with an empty key bound to
+      NULL. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+      ASSURE(iSuccessful);
+   }
+   iSuccessful = SymTable_put(oSymTable, "", NULL);
+   ASSURE(iSuccessful);
+   oFrozen = SymTable_freeze(oSymTable);
+   ASSURE(oFrozen != NULL);
+   SymTable_free(oSymTable);
+
+   /* Store each value as a copy of its string. */
+   iSuccessful = SymTableFrozen_write(oFrozen, pcFileName, uPayloadSize,
+                                      encodeString, &uPayloadSize);
+   ASSURE(iSuccessful);
+   SymTableFrozen_free(oFrozen);
+
+   /* The mapped values are the stored strings. */
+   oMapped = SymTableFrozen_open(pcFileName);
+   ASSURE(oMapped != NULL);
+   ASSURE(SymTableFrozen_getLength(oMapped) == BINDING_COUNT + 1);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      pcValue = (char*)SymTableFrozen_get(oMapped, aacKeys[i]);
+      ASSURE(pcValue != NULL && strcmp(pcValue, aacKeys[i]) == 0);
+   }
+   pcValue = (char*)SymTableFrozen_get(oMapped, "");
+   ASSURE(pcValue != NULL && strcmp(pcValue, "") == 0);
+   ASSURE(! SymTableFrozen_contains(oMapped, "1000"));
+   ASSURE(SymTableFrozen_get(oMapped, "xxx") == NULL);
+
+   uCount = 0;
+   SymTableFrozen_map(oMapped, countSelfBinding, &uCount);
+   ASSURE(uCount == BINDING_COUNT + 1);
+
+   /* A mapped table can be written again, without payloads. */
+   iSuccessful = SymTableFrozen_write(oMapped, pcFileName, 0, NULL, NULL);
+   ASSURE(iSuccessful);
+   SymTableFrozen_free(oMapped);
+   oMapped = SymTableFrozen_open(pcFileName);
+   ASSURE(oMapped != NULL);
+   ASSURE(SymTableFrozen_contains(oMapped, "999"));
+   SymTableFrozen_free(oMapped);
+
+   /* An entry whose key lies outside the file damages the bindings
+      that it and the entry before it bound, but lookups, maps and
+      writes pass over them instead of reading outside the file. The
+      entries follow the header and the displacements, which are
+      unsigned ints padded to a multiple of sizeof(size_t). */
+   psFile = fopen(pcFileName, "r+b");
+   ASSURE(psFile != NULL);
+   ASSURE(fseek(psFile, MAGIC_SIZE, SEEK_SET) == 0);
+   ASSURE(fread(auHeader, sizeof(size_t), HEADER_WORDS, psFile)
+          == HEADER_WORDS);
+   lEntries = (long)(MAGIC_SIZE + sizeof(auHeader)
+      + (auHeader[3] * sizeof(unsigned int) + sizeof(size_t) - 1)
+        / sizeof(size_t) * sizeof(size_t));
+   ASSURE(fseek(psFile, lEntries + (long)auHeader[5], SEEK_SET) == 0);
+   ASSURE(fwrite(&uBadOffset, sizeof(size_t), 1, psFile) == 1);
+   fclose(psFile);
+   oMapped = SymTableFrozen_open(pcFileName);
+   ASSURE(oMapped != NULL);
+   uCount = 0;
+   SymTableFrozen_map(oMapped, countBinding, &uCount);
+   ASSURE(uCount == BINDING_COUNT - 1);
+   uCount = 0;
+   for (i = 0; i < BINDING_COUNT; i++)
+      if (SymTableFrozen_contains(oMapped, aacKeys[i]))
+         uCount++;
+   if (SymTableFrozen_contains(oMapped, ""))
+      uCount++;
+   ASSURE(uCount == BINDING_COUNT - 1);
+   iSuccessful = SymTableFrozen_write(oMapped, pcFileName, 0, NULL, NULL);
+   ASSURE(! iSuccessful);
+   SymTableFrozen_free(oMapped);
+
+   /* Files that SymTableFrozen_write did not write are refused. */
+   psFile = fopen(pcFileName, "w");
+   ASSURE(psFile != NULL);
+   fprintf(psFile, "This is not a frozen symbol table.\n");
+   fclose(psFile);
+   ASSURE(SymTableFrozen_open(pcFileName) == NULL);
+
+   remove(pcFileName);
+   ASSURE(SymTableFrozen_open(pcFileName) == NULL);
+   free(pcFileName);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_write() and SymTable_read() functions. */
+
+static void testStream(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10,
+         LONG_KEY_LENGTH = 40000};
+
+   SymTable_T oSymTable;
+   SymTable_T oRead;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   char *pcLongKey;
+   char *pcValue;
+   FILE *psFile;
+   FILE *psTruncated;
+   long lSize;
+   long l;
+   size_t uLive;
+   size_t uCount;
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_write() and SymTable_read() functions.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   /* Bind keys to themselves, along with an empty key bound to NULL
+      and a key longer than a chunk's room for keys. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+      ASSURE(iSuccessful);
+   }
+   iSuccessful = SymTable_put(oSymTable, "", NULL);
+   ASSURE(iSuccessful);
+   pcLongKey = (char*)malloc(LONG_KEY_LENGTH + 1);
+   ASSURE(pcLongKey != NULL);
+   memset(pcLongKey, 'x', LONG_KEY_LENGTH);
+   pcLongKey[LONG_KEY_LENGTH] = '\0';
+   iSuccessful = SymTable_put(oSymTable, pcLongKey, pcLongKey);
+   ASSURE(iSuccessful);
+
+   /* Data after the table is left for the caller. */
+   psFile = tmpfile();
+   ASSURE(psFile != NULL);
+   iSuccessful = SymTable_write(oSymTable, psFile, writeString, NULL);
+   ASSURE(iSuccessful);
+   putc('!', psFile);
+   lSize = ftell(psFile) - 1;
+   rewind(psFile);
+
+   uLive = 0;
+   oRead = SymTable_read(psFile, readString, freeString, &uLive);
+   ASSURE(oRead != NULL);
+   ASSURE(getc(psFile) == '!');
+   ASSURE(SymTable_getLength(oRead) == BINDING_COUNT + 2);
+   ASSURE(uLive == BINDING_COUNT + 1);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      pcValue = (char*)SymTable_get(oRead, aacKeys[i]);
+      ASSURE(pcValue != NULL && strcmp(pcValue, aacKeys[i]) == 0);
+   }
+   ASSURE(SymTable_contains(oRead, ""));
+   ASSURE(SymTable_get(oRead, "") == NULL);
+   pcValue = (char*)SymTable_get(oRead, pcLongKey);
+   ASSURE(pcValue != NULL && strcmp(pcValue, pcLongKey) == 0);
+   uCount = 0;
+   SymTable_map(oRead, countSelfBinding, &uCount);
+   ASSURE(uCount == BINDING_COUNT + 2);
+   SymTable_map(oRead, freeString, &uLive);
+   ASSURE(uLive == 0);
+   SymTable_free(oRead);
+
+   /* Without callbacks, only the keys survive. */
+   rewind(psFile);
+   iSuccessful = SymTable_write(oSymTable, psFile, NULL, NULL);
+   ASSURE(iSuccessful);
+   rewind(psFile);
+   oRead = SymTable_read(psFile, NULL, NULL, NULL);
+   ASSURE(oRead != NULL);
+   ASSURE(SymTable_getLength(oRead) == BINDING_COUNT + 2);
+   ASSURE(SymTable_contains(oRead, "999"));
+   ASSURE(SymTable_get(oRead, "999") == NULL);
+   SymTable_free(oRead);
+
+   /* A stream cut short yields no table, and every value decoded
+      before the cut is freed. */
+   rewind(psFile);
+   iSuccessful = SymTable_write(oSymTable, psFile, writeString, NULL);
+   ASSURE(iSuccessful);
+   rewind(psFile);
+   psTruncated = tmpfile();
+   ASSURE(psTruncated != NULL);
+   for (l = 0; l < lSize - 1; l++)
+      putc(getc(psFile), psTruncated);
+   rewind(psTruncated);
+   oRead = SymTable_read(psTruncated, readString, freeString, &uLive);
+   ASSURE(oRead == NULL);
+   ASSURE(uLive == 0);
+
+   /* So does a stream that SymTable_write did not write. */
+   rewind(psTruncated);
+   fprintf(psTruncated, "This is not a symbol table.\n");
+   rewind(psTruncated);
+   ASSURE(SymTable_read(psTruncated, readString, freeString, &uLive)
+          == NULL);
+
+   /* So does a stream whose count of bindings, here 2^40, is far more
+      than it holds, without first sizing a table for all of them. */
+   rewind(psTruncated);
+   fwrite("SYMSTR1", 1, sizeof("SYMSTR1"), psTruncated);
+   fwrite("\x80\x80\x80\x80\x80\x20", 1, 6, psTruncated);
+   rewind(psTruncated);
+   ASSURE(SymTable_read(psTruncated, readString, freeString, &uLive)
+          == NULL);
+   fclose(psTruncated);
+
+   /* An empty table round-trips. */
+   SymTable_free(oSymTable);
+   free(pcLongKey);
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   rewind(psFile);
+   iSuccessful = SymTable_write(oSymTable, psFile, writeString, NULL);
+   ASSURE(iSuccessful);
+   rewind(psFile);
+   oRead = SymTable_read(psFile, readString, freeString, &uLive);
+   ASSURE(oRead != NULL);
+   ASSURE(SymTable_getLength(oRead) == 0);
+   SymTable_free(oRead);
+   SymTable_free(oSymTable);
+   fclose(psFile);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Store the key pcKey where the cursor at pvExtra points, and advance
+   the cursor. pvValue is unused. */
+
+static void appendKey(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   (void)pvValue;
+   assert(pcKey != NULL);
+   assert(pvExtra != NULL);
+
+   *(*(const char***)pvExtra)++ = pcKey;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_iterBegin(), SymTable_iterNext(),
+   SymTable_iterKey(), SymTable_iterValue(), and SymTable_iterStale()
+   functions. */
+
+static void testIterator(void)
+{
+   enum {BINDING_COUNT = 1000, MAX_KEY_LENGTH = 10, FIRST_PART = 10};
+
+   SymTable_T oSymTable;
+   struct SymTableIter sIter;
+   struct SymTableIter sOther;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   const char *apcMapped[BINDING_COUNT];
+   const char **ppcMappedEnd;
+   char acReplacement[] = "replacement";
+   const char *pcKey;
+   size_t uCount;
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_iter functions.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   /* An empty table has nothing to visit. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   SymTable_iterBegin(oSymTable, &sIter);
+   ASSURE(! SymTable_iterNext(&sIter));
+   ASSURE(! SymTable_iterNext(&sIter));
+   ASSURE(! SymTable_iterStale(&sIter));
+
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      iSuccessful = SymTable_put(oSymTable, aacKeys[i], aacKeys[i]);
+      ASSURE(iSuccessful);
+   }
+
+   /* The iterator visits every binding once, in the order that
+      SymTable_map does. */
+   ppcMappedEnd = apcMapped;
+   SymTable_map(oSymTable, appendKey, &ppcMappedEnd);
+   ASSURE(ppcMappedEnd == apcMapped + BINDING_COUNT);
+   uCount = 0;
+   SymTable_iterBegin(oSymTable, &sIter);
+   while (SymTable_iterNext(&sIter))
+   {
+      ASSURE(uCount < BINDING_COUNT);
+      pcKey = SymTable_iterKey(&sIter);
+      ASSURE(strcmp(pcKey, apcMapped[uCount]) == 0);
+      ASSURE(strcmp((char*)SymTable_iterValue(&sIter), pcKey) == 0);
+      uCount++;
+   }
+   ASSURE(uCount == BINDING_COUNT);
+   ASSURE(! SymTable_iterNext(&sIter));
+   ASSURE(! SymTable_iterStale(&sIter));
+
+   /* An iteration can stop and pick up later, and two iterators can
+      walk the table in lockstep. */
+   SymTable_iterBegin(oSymTable, &sIter);
+   for (uCount = 0; uCount < FIRST_PART; uCount++)
+      ASSURE(SymTable_iterNext(&sIter));
+   SymTable_iterBegin(oSymTable, &sOther);
+   for (uCount = 0; uCount < FIRST_PART; uCount++)
+      ASSURE(SymTable_iterNext(&sOther));
+   while (SymTable_iterNext(&sIter))
+   {
+      ASSURE(SymTable_iterNext(&sOther));
+      ASSURE(SymTable_iterKey(&sIter) == SymTable_iterKey(&sOther));
+      uCount++;
+   }
+   ASSURE(! SymTable_iterNext(&sOther));
+   ASSURE(uCount == BINDING_COUNT);
+
+   /* Replacing values leaves an iterator usable. */
+   uCount = 0;
+   SymTable_iterBegin(oSymTable, &sIter);
+   while (SymTable_iterNext(&sIter))
+   {
+      (void)SymTable_replace(oSymTable, SymTable_iterKey(&sIter),
+                             acReplacement);
+      uCount++;
+   }
+   ASSURE(uCount == BINDING_COUNT);
+   ASSURE(! SymTable_iterStale(&sIter));
+   ASSURE(SymTable_get(oSymTable, "0") == acReplacement);
+
+   /* Removing the binding an iterator is at makes it stale. */
+   SymTable_iterBegin(oSymTable, &sIter);
+   ASSURE(SymTable_iterNext(&sIter));
+   ASSURE(SymTable_iterNext(&sIter));
+   pcKey = SymTable_iterKey(&sIter);
+   ASSURE(SymTable_remove(oSymTable, pcKey) == acReplacement);
+   ASSURE(! SymTable_iterNext(&sIter));
+   ASSURE(SymTable_iterStale(&sIter));
+   ASSURE(! SymTable_iterNext(&sIter));
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* The number of threads that testMapParallel asks for. */
+
+enum {MAP_THREAD_COUNT = 4};
+
+/*--------------------------------------------------------------------*/
+
+/* Increment the visit count that pvValue points to, and add the
+   length of pcKey to the running total of the calling worker thread
+   in the array of MAP_THREAD_COUNT totals at pvExtra. */
+
+static void countVisit(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   size_t uWorker;
+
+   assert(pcKey != NULL);
+   assert(pvValue != NULL);
+   assert(pvExtra != NULL);
+
+   uWorker = SymTable_mapWorker();
+   ASSURE(uWorker < MAP_THREAD_COUNT);
+   (*(int*)pvValue)++;
+   ((size_t*)pvExtra)[uWorker] += strlen(pcKey);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_mapParallel() and SymTable_mapWorker()
+   functions. */
+
+static void testMapParallel(void)
+{
+   enum {BINDING_COUNT = 10000, MAX_KEY_LENGTH = 10};
+
+   SymTable_T oSymTable;
+   char aacKeys[BINDING_COUNT][MAX_KEY_LENGTH];
+   int aiVisits[BINDING_COUNT];
+   size_t auLengths[MAP_THREAD_COUNT];
+   size_t uExpectedLength = 0;
+   size_t uLength;
+   size_t u;
+   int i;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_mapParallel() function.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (i = 0; i < BINDING_COUNT; i++)
+   {
+      sprintf(aacKeys[i], "%d", i);
+      aiVisits[i] = 0;
+      uExpectedLength += strlen(aacKeys[i]);
+      iSuccessful = SymTable_put(oSymTable, aacKeys[i], &aiVisits[i]);
+      ASSURE(iSuccessful);
+   }
+
+   /* Every binding is visited once, and the per-thread totals add up
+      to the whole. */
+   for (u = 0; u < MAP_THREAD_COUNT; u++)
+      auLengths[u] = 0;
+   SymTable_mapParallel(oSymTable, countVisit, auLengths,
+                        MAP_THREAD_COUNT);
+   for (i = 0; i < BINDING_COUNT; i++)
+      ASSURE(aiVisits[i] == 1);
+   uLength = 0;
+   for (u = 0; u < MAP_THREAD_COUNT; u++)
+      uLength += auLengths[u];
+   ASSURE(uLength == uExpectedLength);
+   ASSURE(SymTable_mapWorker() == 0);
+
+   /* One thread works too. */
+   SymTable_mapParallel(oSymTable, countVisit, auLengths, 1);
+   for (i = 0; i < BINDING_COUNT; i++)
+      ASSURE(aiVisits[i] == 2);
+   ASSURE(auLengths[0] >= uExpectedLength);
+
+   SymTable_free(oSymTable);
+
+   /* So does an empty table. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   SymTable_mapParallel(oSymTable, countVisit, auLengths,
+                        MAP_THREAD_COUNT);
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
 /* Test the ability of a SymTable object to be large, that is, to
    contain iBindingCount bindings. Write the time consumed to stdout. */
 
@@ -960,6 +2675,23 @@ int main(int argc, char *argv[])
    testLongKey();
    testTableOfTables();
    testCollisions();
+   testArena();
+   testReorder();
+   testBorrowedKeys();
+   testCapacity();
+   testCompact();
+   testStats();
+   testMapCopy();
+   testPutMany();
+   testGetMany();
+   testFindOrInsert();
+   testUpsert();
+   testLengthKeys();
+   testIterator();
+   testMapParallel();
+   testFreeze();
+   testFrozenFile(argv[0]);
+   testStream();
    testLargeTable(iBindingCount);
 
    printf("------------------------------------------------------\n");
@@ -0,0 +1,426 @@
+/*--------------------------------------------------------------------*/
+/* testsymtableordered.c                                              */
+/*--------------------------------------------------------------------*/
+
+/* Tests the functions of symtableordered.h, and the key order in which
+   an ordered implementation of symtable.h, such as symtabletree.c,
+   visits its bindings. */
+
+#include "symtable.h"
+#include "symtableordered.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <assert.h>
+
+/*--------------------------------------------------------------------*/
+
+#define ASSURE(i) assure(i, __LINE__)
+
+/*--------------------------------------------------------------------*/
+
+/* If !iSuccessful, print a message to stdout indicating that the
+   test at line iLineNum failed. */
+
+static void assure(int iSuccessful, int iLineNum)
+{
+   if (! iSuccessful)
+   {
+      printf("Test at line %d failed.\n", iLineNum);
+      fflush(stdout);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* The most keys that any test collects. */
+
+enum {MAX_COLLECTED = 100000};
+
+/* The keys collected by collectKey, in the order visited. */
+
+struct Collected
+{
+   size_t uCount;
+   const char *apcKeys[MAX_COLLECTED];
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Append pcKey to the Collected at pvExtra, and check that pvValue
+   is the key itself. */
+
+static void collectKey(const char *pcKey, void *pvValue, void *pvExtra)
+{
+   struct Collected *psCollected = (struct Collected*)pvExtra;
+
+   assert(pcKey != NULL);
+   assert(psCollected != NULL);
+
+   ASSURE(strcmp(pcKey, (const char*)pvValue) == 0);
+   ASSURE(psCollected->uCount < MAX_COLLECTED);
+   if (psCollected->uCount < MAX_COLLECTED)
+      psCollected->apcKeys[psCollected->uCount++] = pcKey;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Compare the strings that pvFirst and pvSecond point to, for
+   qsort. */
+
+static int compareKeys(const void *pvFirst, const void *pvSecond)
+{
+   return strcmp(*(const char *const*)pvFirst,
+                 *(const char *const*)pvSecond);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return 1 (TRUE) if the psCollected keys are the keys of
+   apcSorted[uFirst] to apcSorted[uLimit - 1], in that order, or 0
+   (FALSE) otherwise. */
+
+static int sameKeys(const struct Collected *psCollected,
+   const char *const apcSorted[], size_t uFirst, size_t uLimit)
+{
+   size_t u;
+
+   if (psCollected->uCount != uLimit - uFirst)
+      return 0;
+   for (u = 0; u < psCollected->uCount; u++)
+      if (strcmp(psCollected->apcKeys[u], apcSorted[uFirst + u]) != 0)
+         return 0;
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test that SymTable_map() and the iterator visit bindings in key
+   order, with keys that tie in their first several characters. */
+
+static void testOrder(void)
+{
+   static struct Collected sCollected;
+   static const char *apcKeys[] = {
+      "banana", "apple", "", "applesauce", "apples", "b", "\x7f",
+      "\xc3\xa9t\xc3\xa9", "applf", "apple\x01", "zebra", "A"
+   };
+   enum {KEY_COUNT = sizeof(apcKeys) / sizeof(apcKeys[0])};
+
+   SymTable_T oSymTable;
+   struct SymTableIter sIter;
+   const char *apcSorted[KEY_COUNT];
+   size_t u;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the order in which bindings are visited.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (u = 0; u < KEY_COUNT; u++)
+   {
+      iSuccessful = SymTable_put(oSymTable, apcKeys[u], apcKeys[u]);
+      ASSURE(iSuccessful);
+      apcSorted[u] = apcKeys[u];
+   }
+   qsort(apcSorted, KEY_COUNT, sizeof(apcSorted[0]), compareKeys);
+
+   sCollected.uCount = 0;
+   SymTable_map(oSymTable, collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, KEY_COUNT));
+
+   u = 0;
+   SymTable_iterBegin(oSymTable, &sIter);
+   while (SymTable_iterNext(&sIter))
+   {
+      ASSURE(u < KEY_COUNT);
+      if (u < KEY_COUNT)
+         ASSURE(strcmp(SymTable_iterKey(&sIter), apcSorted[u]) == 0);
+      u++;
+   }
+   ASSURE(u == KEY_COUNT);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the SymTable_mapRange() and SymTable_mapPrefix() functions on
+   a small table whose answers are known. */
+
+static void testRangeAndPrefix(void)
+{
+   static struct Collected sCollected;
+   static const char *apcSorted[] = {
+      "car", "card", "cards", "care", "cart", "cat", "dog"
+   };
+   enum {KEY_COUNT = sizeof(apcSorted) / sizeof(apcSorted[0])};
+
+   SymTable_T oSymTable;
+   size_t u;
+   int iSuccessful;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing the SymTable_mapRange() and SymTable_mapPrefix() "
+      "functions.\n");
+   printf("No output should appear here:\n");
+   fflush(stdout);
+
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+
+   /* An empty table has nothing in any range. */
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, NULL, NULL, collectKey, &sCollected);
+   SymTable_mapPrefix(oSymTable, "", collectKey, &sCollected);
+   ASSURE(sCollected.uCount == 0);
+
+   for (u = KEY_COUNT; u > 0; u--)
+   {
+      iSuccessful = SymTable_put(oSymTable, apcSorted[u - 1],
+         apcSorted[u - 1]);
+      ASSURE(iSuccessful);
+   }
+
+   /* The low end is included and the high end is not. */
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, "card", "cart", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 1, 4));
+
+   /* Bounds need not be keys. */
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, "cara", "cas", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 1, 5));
+
+   /* NULL leaves an end open. */
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, NULL, "care", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, 3));
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, "cat", NULL, collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 5, KEY_COUNT));
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, NULL, NULL, collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, KEY_COUNT));
+
+   /* An empty or backward range visits nothing. */
+   sCollected.uCount = 0;
+   SymTable_mapRange(oSymTable, "cart", "cart", collectKey, &sCollected);
+   SymTable_mapRange(oSymTable, "dog", "car", collectKey, &sCollected);
+   SymTable_mapRange(oSymTable, "e", NULL, collectKey, &sCollected);
+   ASSURE(sCollected.uCount == 0);
+
+   /* A prefix matches itself and the keys that extend it. */
+   sCollected.uCount = 0;
+   SymTable_mapPrefix(oSymTable, "car", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, 5));
+   sCollected.uCount = 0;
+   SymTable_mapPrefix(oSymTable, "card", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 1, 3));
+   sCollected.uCount = 0;
+   SymTable_mapPrefix(oSymTable, "", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, KEY_COUNT));
+
+   /* Or nothing at all. */
+   sCollected.uCount = 0;
+   SymTable_mapPrefix(oSymTable, "cab", collectKey, &sCollected);
+   SymTable_mapPrefix(oSymTable, "cards!", collectKey, &sCollected);
+   SymTable_mapPrefix(oSymTable, "zz", collectKey, &sCollected);
+   ASSURE(sCollected.uCount == 0);
+
+   SymTable_free(oSymTable);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the ordered functions on a table of iBindingCount bindings
+   that grows and shrinks, checking the answers against a sorted array
+   of the keys. Write the time consumed to stdout. */
+
+static void testLargeTable(int iBindingCount)
+{
+   enum {MAX_KEY_LENGTH = 12};
+
+   static struct Collected sCollected;
+   SymTable_T oSymTable;
+   struct SymTableIter sIter;
+   char (*aacKeys)[MAX_KEY_LENGTH];
+   const char **apcSorted;
+   char acLow[MAX_KEY_LENGTH];
+   char acHigh[MAX_KEY_LENGTH];
+   size_t uCount;
+   size_t uKept;
+   size_t uFirst;
+   size_t uLimit;
+   size_t u;
+   int iSuccessful;
+   clock_t iInitialClock;
+   clock_t iFinalClock;
+
+   printf("------------------------------------------------------\n");
+   printf("Testing a potentially large ordered SymTable object.\n");
+   printf("No output except CPU time consumed should appear here:\n");
+   fflush(stdout);
+
+   uCount = (size_t)iBindingCount;
+   if (uCount > MAX_COLLECTED) uCount = MAX_COLLECTED;
+   aacKeys = (char(*)[MAX_KEY_LENGTH])malloc(
+      (uCount + 1) * MAX_KEY_LENGTH);
+   apcSorted = (const char**)malloc((uCount + 1) * sizeof(char*));
+   ASSURE(aacKeys != NULL && apcSorted != NULL);
+   if (aacKeys == NULL || apcSorted == NULL)
+   {
+      free(aacKeys);
+      free((void*)apcSorted);
+      return;
+   }
+
+   /* Note the current time. */
+   iInitialClock = clock();
+
+   /* Put the keys in an order unrelated to their sorted order. */
+   oSymTable = SymTable_new();
+   ASSURE(oSymTable != NULL);
+   for (u = 0; u < uCount; u++)
+   {
+      sprintf(aacKeys[u], "k%lu",
+         (unsigned long)((u * 7919) % uCount));
+      iSuccessful = SymTable_put(oSymTable, aacKeys[u], aacKeys[u]);
+      ASSURE(iSuccessful);
+   }
+   ASSURE(SymTable_getLength(oSymTable) == uCount);
+
+   /* Remove every key whose number is not a multiple of 3, so that
+      leaves merge and borrow, keeping the rest in apcSorted. */
+   uKept = 0;
+   for (u = 0; u < uCount; u++)
+   {
+      if (((u * 7919) % uCount) % 3 != 0)
+      {
+         ASSURE(SymTable_remove(oSymTable, aacKeys[u]) == aacKeys[u]);
+         ASSURE(! SymTable_contains(oSymTable, aacKeys[u]));
+      }
+      else
+         apcSorted[uKept++] = aacKeys[u];
+   }
+   ASSURE(SymTable_getLength(oSymTable) == uKept);
+   for (u = 0; u < uKept; u++)
+      ASSURE(SymTable_get(oSymTable, apcSorted[u]) == apcSorted[u]);
+   qsort((void*)apcSorted, uKept, sizeof(apcSorted[0]), compareKeys);
+
+   sCollected.uCount = 0;
+   SymTable_map(oSymTable, collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, 0, uKept));
+
+   u = 0;
+   SymTable_iterBegin(oSymTable, &sIter);
+   while (SymTable_iterNext(&sIter))
+   {
+      if (u < uKept)
+         ASSURE(strcmp(SymTable_iterKey(&sIter), apcSorted[u]) == 0);
+      u++;
+   }
+   ASSURE(u == uKept);
+
+   /* Ranges between keys, with bounds that are and are not keys. */
+   for (uFirst = 0; uFirst < uKept; uFirst += uKept / 7 + 1)
+   {
+      uLimit = uFirst + uKept / 5;
+      if (uLimit > uKept) uLimit = uKept;
+      strcpy(acLow, apcSorted[uFirst]);
+      sCollected.uCount = 0;
+      SymTable_mapRange(oSymTable, acLow,
+         uLimit < uKept ? apcSorted[uLimit] : NULL,
+         collectKey, &sCollected);
+      ASSURE(sameKeys(&sCollected, apcSorted, uFirst, uLimit));
+
+      /* Just above the low key leaves it out. */
+      strcat(acLow, "\x01");
+      if (uLimit < uKept)
+      {
+         strcpy(acHigh, apcSorted[uLimit]);
+         strcat(acHigh, "\x01");
+      }
+      sCollected.uCount = 0;
+      SymTable_mapRange(oSymTable, acLow,
+         uLimit < uKept ? acHigh : NULL, collectKey, &sCollected);
+      ASSURE(sameKeys(&sCollected, apcSorted, uFirst + 1,
+         uLimit < uKept ? uLimit + 1 : uLimit));
+   }
+
+   /* Every key that begins with "k1" is in one run. */
+   for (uFirst = 0; uFirst < uKept
+      && strncmp(apcSorted[uFirst], "k1", 2) < 0; uFirst++)
+      ;
+   for (uLimit = uFirst; uLimit < uKept
+      && strncmp(apcSorted[uLimit], "k1", 2) == 0; uLimit++)
+      ;
+   sCollected.uCount = 0;
+   SymTable_mapPrefix(oSymTable, "k1", collectKey, &sCollected);
+   ASSURE(sameKeys(&sCollected, apcSorted, uFirst, uLimit));
+
+   /* Empty the table, then use it again. */
+   for (u = 0; u < uKept; u++)
+      ASSURE(SymTable_remove(oSymTable, apcSorted[u]) == apcSorted[u]);
+   ASSURE(SymTable_getLength(oSymTable) == 0);
+   sCollected.uCount = 0;
+   SymTable_map(oSymTable, collectKey, &sCollected);
+   ASSURE(sCollected.uCount == 0);
+   for (u = 0; u < uCount; u++)
+   {
+      iSuccessful = SymTable_put(oSymTable, aacKeys[u], aacKeys[u]);
+      ASSURE(iSuccessful);
+   }
+   ASSURE(SymTable_getLength(oSymTable) == uCount);
+
+   SymTable_free(oSymTable);
+   free(aacKeys);
+   free((void*)apcSorted);
+
+   /* Note the current time, and print the time consumed to stdout. */
+   iFinalClock = clock();
+   printf("CPU time (%d bindings):  %f seconds\n", iBindingCount,
+      ((double)(iFinalClock - iInitialClock)) / CLOCKS_PER_SEC);
+   fflush(stdout);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Test the ordered SymTable functions.  Write the output of the tests
+   to stdout.  argv[1] is the number of bindings to put into a
+   potentially large SymTable object.  Exit with EXIT_FAILURE if
+   argv[1] is missing or not numeric.  Otherwise return 0. */
+
+int main(int argc, char *argv[])
+{
+   int iBindingCount;
+
+   if (argc != 2)
+   {
+      fprintf(stderr, "Usage: %s bindingcount\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+
+   if (sscanf(argv[1], "%d", &iBindingCount) != 1)
+   {
+      fprintf(stderr, "bindingcount must be numeric\n");
+      exit(EXIT_FAILURE);
+   }
+   if (iBindingCount < 0)
+   {
+      fprintf(stderr, "bindingcount cannot be negative\n");
+      exit(EXIT_FAILURE);
+   }
+
+   testOrder();
+   testRangeAndPrefix();
+   testLargeTable(iBindingCount);
+
+   printf("------------------------------------------------------\n");
+   printf("End of %s.\n", argv[0]);
+   return 0;
+}
@@ -0,0 +1,284 @@
+/*--------------------------------------------------------------------*/
+/* zipfsymtable.c                                                     */
+/*--------------------------------------------------------------------*/
+
+/* Looks up keys drawn from a Zipf distribution in tables of several
+   sizes, once with each reordering option of symtable.h, and reports
+   the average number of keys compared per lookup and the time per
+   lookup. Built with symtablelist.c, it shows how much of the list
+   skewed lookups scan with and without SYMTABLE_MOVE_TO_FRONT and
+   SYMTABLE_TRANSPOSE. */
+
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include "symtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*--------------------------------------------------------------------*/
+
+/* The number of keys in each table measured, in turn. */
+static const size_t auTableSizes[] = {16, 64, 256, 1024};
+enum {TABLE_SIZE_COUNT = sizeof(auTableSizes) / sizeof(auTableSizes[0])};
+enum {MAX_TABLE_SIZE = 1024};
+
+/* The options measured, and their names. */
+static const int aiOptions[] = {
+   0, SYMTABLE_MOVE_TO_FRONT, SYMTABLE_TRANSPOSE
+};
+static const char *apcOptionNames[] = {
+   "none", "move-to-front", "transpose"
+};
+enum {OPTION_COUNT = sizeof(aiOptions) / sizeof(aiOptions[0])};
+
+/* One lookup in every SAMPLE_INTERVAL has its comparisons counted.
+   Counting walks the table with an iterator, so it is done in a run
+   of its own, apart from the timed one. */
+enum {SAMPLE_INTERVAL = 16};
+
+enum {MAX_KEY_LENGTH = 16};
+
+/*--------------------------------------------------------------------*/
+
+/* Return the next number from the xorshift generator whose state is
+   *pulSeed, a number in [0, 2^32). */
+
+static unsigned long nextRandom(unsigned long *pulSeed)
+{
+   unsigned long ul = *pulSeed;
+   ul ^= (ul << 13) & 0xffffffffUL;
+   ul ^= ul >> 17;
+   ul ^= (ul << 5) & 0xffffffffUL;
+   *pulSeed = ul;
+   return ul;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the number of seconds on a monotonic clock. */
+
+static double getSeconds(void)
+{
+   struct timespec sTime;
+   clock_gettime(CLOCK_MONOTONIC, &sTime);
+   return (double)sTime.tv_sec + (double)sTime.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Fill auKeys[0] to auKeys[lLookups - 1] with key numbers from 0 to
+   uKeyCount - 1, drawn so that the key of rank r, in the random order
+   auKeyOfRank gives, is drawn in proportion to 1 / (r + 1). */
+
+static void drawZipf(size_t auKeys[], long lLookups, size_t uKeyCount,
+   const size_t auKeyOfRank[], unsigned long *pulSeed)
+{
+   double adCumulative[MAX_TABLE_SIZE];
+   double dTotal = 0.0;
+   double dTarget;
+   size_t uLow;
+   size_t uHigh;
+   size_t uMid;
+   size_t u;
+   long l;
+
+   for (u = 0; u < uKeyCount; u++)
+   {
+      dTotal += 1.0 / (double)(u + 1);
+      adCumulative[u] = dTotal;
+   }
+
+   for (l = 0; l < lLookups; l++)
+   {
+      dTarget = (double)nextRandom(pulSeed) / 4294967296.0 * dTotal;
+      uLow = 0;
+      uHigh = uKeyCount - 1;
+      while (uLow < uHigh)
+      {
+         uMid = uLow + (uHigh - uLow) / 2;
+         if (adCumulative[uMid] <= dTarget)
+            uLow = uMid + 1;
+         else
+            uHigh = uMid;
+      }
+      auKeys[l] = auKeyOfRank[uLow];
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return a new SymTable_T with options iOptions that binds each of
+   the uKeyCount keys aacKeys to itself, put in order. Exit if
+   insufficient memory is available. */
+
+static SymTable_T newTable(int iOptions, char aacKeys[][MAX_KEY_LENGTH],
+   size_t uKeyCount)
+{
+   SymTable_T oSymTable;
+   size_t u;
+
+   oSymTable = SymTable_newWithOptions(iOptions);
+   if (oSymTable == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+   for (u = 0; u < uKeyCount; u++)
+      if (! SymTable_put(oSymTable, aacKeys[u], aacKeys[u]))
+      {
+         fprintf(stderr, "Insufficient memory\n");
+         exit(EXIT_FAILURE);
+      }
+   return oSymTable;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the number of keys that a lookup of pcKey compares in
+   oSymTable: one more than the number of bindings before it. */
+
+static size_t countComparisons(SymTable_T oSymTable, const char *pcKey)
+{
+   struct SymTableIter sIter;
+   size_t uCount = 0;
+
+   SymTable_iterBegin(oSymTable, &sIter);
+   while (SymTable_iterNext(&sIter))
+   {
+      uCount++;
+      if (strcmp(SymTable_iterKey(&sIter), pcKey) == 0)
+         break;
+   }
+   return uCount;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Look up the keys that auKeys numbers, in tables of each size with
+   each option, and print the comparisons and time per lookup. Return
+   0 (FALSE) if a lookup gave the wrong value, or 1 (TRUE) otherwise. */
+
+static int runLookups(char aacKeys[][MAX_KEY_LENGTH], size_t auKeys[],
+   long lLookups)
+{
+   size_t auKeyOfRank[MAX_TABLE_SIZE];
+   SymTable_T oSymTable;
+   unsigned long ulSeed;
+   size_t uKeyCount;
+   size_t uComparisons;
+   size_t uSamples;
+   size_t uOther;
+   size_t uSwap;
+   size_t u;
+   long l;
+   int iSize;
+   int iOption;
+   int iSuccessful = 1;
+   double dStart;
+   double dSeconds;
+
+   printf("   keys  option          comparisons  ns/lookup\n");
+   for (iSize = 0; iSize < TABLE_SIZE_COUNT; iSize++)
+   {
+      uKeyCount = auTableSizes[iSize];
+
+      /* The hot keys are scattered through the order of putting */
+      ulSeed = 2463534242UL;
+      for (u = 0; u < uKeyCount; u++)
+         auKeyOfRank[u] = u;
+      for (u = uKeyCount - 1; u > 0; u--)
+      {
+         uOther = (size_t)(nextRandom(&ulSeed) % (u + 1));
+         uSwap = auKeyOfRank[u];
+         auKeyOfRank[u] = auKeyOfRank[uOther];
+         auKeyOfRank[uOther] = uSwap;
+      }
+      drawZipf(auKeys, lLookups, uKeyCount, auKeyOfRank, &ulSeed);
+
+      for (iOption = 0; iOption < OPTION_COUNT; iOption++)
+      {
+         /* Count the comparisons of a sample of lookups */
+         oSymTable = newTable(aiOptions[iOption], aacKeys, uKeyCount);
+         uComparisons = 0;
+         uSamples = 0;
+         for (l = 0; l < lLookups; l++)
+         {
+            if (l % SAMPLE_INTERVAL == 0)
+            {
+               uComparisons += countComparisons(oSymTable,
+                                                aacKeys[auKeys[l]]);
+               uSamples++;
+            }
+            if (SymTable_get(oSymTable, aacKeys[auKeys[l]])
+                != aacKeys[auKeys[l]])
+               iSuccessful = 0;
+         }
+         SymTable_free(oSymTable);
+
+         /* Then time all of them, starting again from a new table */
+         oSymTable = newTable(aiOptions[iOption], aacKeys, uKeyCount);
+         dStart = getSeconds();
+         for (l = 0; l < lLookups; l++)
+            if (SymTable_get(oSymTable, aacKeys[auKeys[l]])
+                != aacKeys[auKeys[l]])
+               iSuccessful = 0;
+         dSeconds = getSeconds() - dStart;
+         SymTable_free(oSymTable);
+
+         printf("%7lu  %-14s %12.2f %10.1f\n", (unsigned long)uKeyCount,
+                apcOptionNames[iOption],
+                (double)uComparisons / (double)uSamples,
+                dSeconds * 1e9 / (double)lLookups);
+         fflush(stdout);
+      }
+   }
+   return iSuccessful;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Run the benchmark with argv[1] lookups per table, which defaults to
+   1000000. Return 0 if every lookup gave the right value, or
+   EXIT_FAILURE otherwise. */
+
+int main(int argc, char *argv[])
+{
+   static char aacKeys[MAX_TABLE_SIZE][MAX_KEY_LENGTH];
+   size_t *auKeys;
+   long lLookups = 1000000;
+   size_t u;
+   int iSuccessful;
+
+   if (argc > 2 ||
+       (argc > 1 && sscanf(argv[1], "%ld", &lLookups) != 1))
+   {
+      fprintf(stderr, "Usage: %s [lookups]\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   if (lLookups < 1)
+   {
+      fprintf(stderr, "lookups must be positive\n");
+      exit(EXIT_FAILURE);
+   }
+
+   auKeys = (size_t*)malloc((size_t)lLookups * sizeof(size_t));
+   if (auKeys == NULL)
+   {
+      fprintf(stderr, "Insufficient memory\n");
+      exit(EXIT_FAILURE);
+   }
+   for (u = 0; u < MAX_TABLE_SIZE; u++)
+      sprintf(aacKeys[u], "symbol%lu", (unsigned long)u);
+
+   iSuccessful = runLookups(aacKeys, auKeys, lLookups);
+   free(auKeys);
+   if (! iSuccessful)
+   {
+      printf("Some lookups gave the wrong value.\n");
+      return EXIT_FAILURE;
+   }
+   return 0;
+}